@@ -43,6 +43,19 @@ public:
    Test if a key is an element of the set.
    */
   virtual bool Contains( const key_T& key ) const = 0;
+  /**
+   Test many keys at once. Containers that can do better than one Contains() call per key will override this.
+   \param[in] keys Keys to test.
+   \param[in] count Number of keys.
+   \param[out] out Receives, for each key, true if it is an element of the set.
+   */
+  virtual void ContainsMany( const key_T* keys, int count, bool* out ) const
+  {
+    for( int i = 0; i < count; ++i )
+    {
+      out[ i ] = Contains( keys[ i ] );
+    }
+  }
   /**
    Push all keys into the collector object.
    */
@@ -24,7 +24,13 @@
  */
 /* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
 // Standard Libs
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#if defined( _WIN32 )
+#include <malloc.h>
+#endif
 
 #include "MojoAlloc.h"
 
@@ -41,8 +47,118 @@ class DefaultAlloc final : public MojoAlloc
   {
     free( p );
   }
+  virtual void* Reallocate( void* p, size_t, size_t byte_count, const char* ) override
+  {
+    return realloc( p, byte_count );
+  }
+  virtual void FreeSized( void* p, size_t ) override
+  {
+    free( p );
+  }
+#if defined( _WIN32 )
+  virtual void* AllocateAligned( size_t byte_count, size_t alignment, const char* ) override
+  {
+    return _aligned_malloc( byte_count, alignment );
+  }
+  virtual void* ReallocateAligned( void* p, size_t, size_t byte_count, size_t alignment, const char* ) override
+  {
+    return _aligned_realloc( p, byte_count, alignment );
+  }
+  virtual void FreeAligned( void* p, size_t, size_t ) override
+  {
+    _aligned_free( p );
+  }
+#else
+  virtual void* AllocateAligned( size_t byte_count, size_t alignment, const char* ) override
+  {
+    void* p = NULL;
+    return posix_memalign( &p, alignment < sizeof( void* ) ? sizeof( void* ) : alignment, byte_count ) == 0 ? p : NULL;
+  }
+  virtual void* ReallocateAligned( void* p, size_t old_byte_count, size_t byte_count, size_t alignment,
+                                   const char* name ) override
+  {
+    // realloc() only keeps malloc() alignment, and a block it moved could not be aligned without losing the old one
+    // when that fails. Copy into a new block for stricter alignment, so that on failure the old block is intact.
+    if( alignment <= alignof( max_align_t ) )
+    {
+      return realloc( p, byte_count );
+    }
+    void* new_p = AllocateAligned( byte_count, alignment, name );
+    if( new_p && p )
+    {
+      memcpy( new_p, p, old_byte_count < byte_count ? old_byte_count : byte_count );
+      free( p );
+    }
+    return new_p;
+  }
+  virtual void FreeAligned( void* p, size_t, size_t ) override
+  {
+    free( p );
+  }
+#endif
 };
 
+void* MojoAlloc::Reallocate( void* p, size_t old_byte_count, size_t byte_count, const char* name )
+{
+  void* new_p = Allocate( byte_count, name );
+  if( new_p && p )
+  {
+    memcpy( new_p, p, old_byte_count < byte_count ? old_byte_count : byte_count );
+    FreeSized( p, old_byte_count );
+  }
+  return new_p;
+}
+
+void MojoAlloc::FreeSized( void* p, size_t )
+{
+  Free( p );
+}
+
+// The default AllocateAligned() keeps the pointer from Allocate() just before the block, so align at least for that
+static size_t GetStashAlignment( size_t alignment )
+{
+  return alignment < sizeof( void* ) ? sizeof( void* ) : alignment;
+}
+
+// Size of the block that the default AllocateAligned() gets from Allocate()
+static size_t GetAlignedPaddedSize( size_t byte_count, size_t alignment )
+{
+  return byte_count + GetStashAlignment( alignment ) - 1 + sizeof( void* );
+}
+
+void* MojoAlloc::AllocateAligned( size_t byte_count, size_t alignment, const char* name )
+{
+  void* base = Allocate( GetAlignedPaddedSize( byte_count, alignment ), name );
+  alignment = GetStashAlignment( alignment );
+  if( !base )
+  {
+    return NULL;
+  }
+  void** p = ( void** )( ( ( uintptr_t )base + sizeof( void* ) + alignment - 1 ) & ~( uintptr_t )( alignment - 1 ) );
+  p[ -1 ] = base;
+  return p;
+}
+
+void* MojoAlloc::ReallocateAligned( void* p, size_t old_byte_count, size_t byte_count, size_t alignment,
+                                    const char* name )
+{
+  void* new_p = AllocateAligned( byte_count, alignment, name );
+  if( new_p && p )
+  {
+    memcpy( new_p, p, old_byte_count < byte_count ? old_byte_count : byte_count );
+    FreeAligned( p, old_byte_count, alignment );
+  }
+  return new_p;
+}
+
+void MojoAlloc::FreeAligned( void* p, size_t byte_count, size_t alignment )
+{
+  if( p )
+  {
+    FreeSized( ( ( void** )p )[ -1 ], GetAlignedPaddedSize( byte_count, alignment ) );
+  }
+}
+
 MojoAlloc* MojoAlloc::GetDefault()
 {
   static DefaultAlloc default_alloc;
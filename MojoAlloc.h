@@ -52,6 +52,54 @@ public:
    \param[in] p Pointer to the memory block
    */
   virtual void  Free( void* p ) = 0;
+  /**
+   Implement realloc() equivalent. Grow or shrink a block, keeping its contents up to the smaller of the two sizes.
+   The default implementation allocates a new block, copies and frees the old one. Override it if your memory manager
+   can resize a block in place.
+   \param[in] p Pointer to the memory block. If NULL, this is the same as Allocate().
+   \param[in] old_byte_count Size that was requested for p.
+   \param[in] byte_count Number of bytes needed.
+   \param[in] name Name of the object requesting memory.
+   \return Pointer to the resized block, which may or may not be p. NULL if memory could not be allocated, in which case
+   p is still valid.
+   */
+  virtual void* Reallocate( void* p, size_t old_byte_count, size_t byte_count, const char* name );
+  /**
+   Free a block whose size is known. The default implementation calls Free( p ). Override it if your memory manager
+   can use the size to avoid a lookup.
+   \param[in] p Pointer to the memory block
+   \param[in] byte_count Size that was requested for p.
+   */
+  virtual void  FreeSized( void* p, size_t byte_count );
+  /**
+   Allocate a block with a given alignment, for example a cache line. The default implementation allocates enough to
+   align the block itself, and keeps the original pointer just before it. Override this together with
+   ReallocateAligned() and FreeAligned() if your memory manager can align blocks directly.
+   \param[in] byte_count Number of bytes needed.
+   \param[in] alignment Alignment in bytes. Must be a power of two.
+   \param[in] name Name of the object requesting memory.
+   \return Pointer to memory block. NULL if memory could not be allocated.
+   */
+  virtual void* AllocateAligned( size_t byte_count, size_t alignment, const char* name );
+  /**
+   Reallocate() equivalent for blocks from AllocateAligned(). The default implementation allocates a new block, copies
+   and frees the old one.
+   \param[in] p Pointer to the memory block. If NULL, this is the same as AllocateAligned().
+   \param[in] old_byte_count Size that was requested for p.
+   \param[in] byte_count Number of bytes needed.
+   \param[in] alignment Alignment that was requested for p.
+   \param[in] name Name of the object requesting memory.
+   \return Pointer to the resized block. NULL if memory could not be allocated, in which case p is still valid.
+   */
+  virtual void* ReallocateAligned( void* p, size_t old_byte_count, size_t byte_count, size_t alignment,
+                                   const char* name );
+  /**
+   Free a block from AllocateAligned() or ReallocateAligned().
+   \param[in] p Pointer to the memory block
+   \param[in] byte_count Size that was requested for p.
+   \param[in] alignment Alignment that was requested for p.
+   */
+  virtual void  FreeAligned( void* p, size_t byte_count, size_t alignment );
 
   /**
    Get global default allocator.
@@ -0,0 +1,194 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+// -- Self
+#include "MojoArenaAlloc.h"
+
+// -- Standard Libs
+#include <stdint.h>
+
+// -- Mojo
+#include "MojoUtil.h"
+
+static const size_t kArenaAlign = 16;
+
+MojoArenaAlloc::MojoArenaAlloc( size_t block_size, bool can_grow, MojoAlloc* alloc )
+: m_Block( NULL )
+, m_BlockSize( block_size )
+, m_UsedSize( 0 )
+, m_CanGrow( can_grow )
+, m_Alloc( alloc ? alloc : MojoAlloc::GetDefault() )
+{
+}
+
+MojoArenaAlloc::~MojoArenaAlloc()
+{
+  while( m_Block )
+  {
+    Block* prev = m_Block->m_Prev;
+    m_Alloc->FreeSized( m_Block, sizeof( Block ) + m_Block->m_Size );
+    m_Block = prev;
+  }
+}
+
+void* MojoArenaAlloc::Allocate( size_t byte_count, const char* name )
+{
+  return AllocateAligned( byte_count, kArenaAlign, name );
+}
+
+void* MojoArenaAlloc::AllocateAligned( size_t byte_count, size_t alignment, const char* )
+{
+  alignment = MojoMax( alignment, kArenaAlign );
+  byte_count = ( byte_count + kArenaAlign - 1 ) & ~( kArenaAlign - 1 );
+  if( !m_Block || GetAlignedOffset( alignment ) + byte_count > m_Block->m_Size )
+  {
+    if( m_Block && !m_CanGrow )
+    {
+      return NULL;
+    }
+    // Blocks are only aligned to kArenaAlign, so leave room to align the first allocation
+    size_t size = m_Block ? m_Block->m_Size * 2 : m_BlockSize;
+    Block* block = NewBlock( MojoMax( size, byte_count + alignment - kArenaAlign ) );
+    if( !block )
+    {
+      return NULL;
+    }
+    if( m_Block )
+    {
+      m_UsedSize += m_Block->m_UsedSize;
+    }
+    block->m_Prev = m_Block;
+    m_Block = block;
+  }
+  size_t offset = GetAlignedOffset( alignment );
+  m_Block->m_UsedSize = offset + byte_count;
+  return ( char* )( m_Block + 1 ) + offset;
+}
+
+void MojoArenaAlloc::Free( void* )
+{
+}
+
+void* MojoArenaAlloc::Reallocate( void* p, size_t old_byte_count, size_t byte_count, const char* name )
+{
+  if( ResizeTop( p, old_byte_count, byte_count ) )
+  {
+    return p;
+  }
+  return MojoAlloc::Reallocate( p, old_byte_count, byte_count, name );
+}
+
+void* MojoArenaAlloc::ReallocateAligned( void* p, size_t old_byte_count, size_t byte_count, size_t alignment,
+                                         const char* name )
+{
+  if( ResizeTop( p, old_byte_count, byte_count ) )
+  {
+    return p;
+  }
+  return MojoAlloc::ReallocateAligned( p, old_byte_count, byte_count, alignment, name );
+}
+
+void MojoArenaAlloc::FreeAligned( void* p, size_t byte_count, size_t )
+{
+  FreeSized( p, byte_count );
+}
+
+void MojoArenaAlloc::FreeSized( void* p, size_t byte_count )
+{
+  if( IsTop( p, byte_count ) )
+  {
+    m_Block->m_UsedSize -= ( byte_count + kArenaAlign - 1 ) & ~( kArenaAlign - 1 );
+  }
+}
+
+void MojoArenaAlloc::Reset()
+{
+  if( m_Block )
+  {
+    while( m_Block->m_Prev )
+    {
+      Block* prev = m_Block->m_Prev;
+      m_Block->m_Prev = prev->m_Prev;
+      m_Alloc->FreeSized( prev, sizeof( Block ) + prev->m_Size );
+    }
+    m_Block->m_UsedSize = 0;
+  }
+  m_UsedSize = 0;
+}
+
+size_t MojoArenaAlloc::GetUsedSize() const
+{
+  return m_UsedSize + ( m_Block ? m_Block->m_UsedSize : 0 );
+}
+
+size_t MojoArenaAlloc::GetCapacity() const
+{
+  size_t capacity = 0;
+  for( const Block* block = m_Block; block; block = block->m_Prev )
+  {
+    capacity += block->m_Size;
+  }
+  return capacity;
+}
+
+bool MojoArenaAlloc::IsTop( const void* p, size_t byte_count ) const
+{
+  byte_count = ( byte_count + kArenaAlign - 1 ) & ~( kArenaAlign - 1 );
+  return p && m_Block && ( const char* )p + byte_count == ( const char* )( m_Block + 1 ) + m_Block->m_UsedSize;
+}
+
+bool MojoArenaAlloc::ResizeTop( void* p, size_t old_byte_count, size_t byte_count )
+{
+  if( IsTop( p, old_byte_count ) )
+  {
+    size_t used_size = m_Block->m_UsedSize - ( ( old_byte_count + kArenaAlign - 1 ) & ~( kArenaAlign - 1 ) );
+    byte_count = ( byte_count + kArenaAlign - 1 ) & ~( kArenaAlign - 1 );
+    if( used_size + byte_count <= m_Block->m_Size )
+    {
+      m_Block->m_UsedSize = used_size + byte_count;
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t MojoArenaAlloc::GetAlignedOffset( size_t alignment ) const
+{
+  uintptr_t data = ( uintptr_t )( m_Block + 1 );
+  return ( ( data + m_Block->m_UsedSize + alignment - 1 ) & ~( uintptr_t )( alignment - 1 ) ) - data;
+}
+
+MojoArenaAlloc::Block* MojoArenaAlloc::NewBlock( size_t size )
+{
+  size = ( size + kArenaAlign - 1 ) & ~( kArenaAlign - 1 );
+  Block* block = ( Block* )m_Alloc->Allocate( sizeof( Block ) + size, "MojoArenaAlloc" );
+  if( block )
+  {
+    block->m_Prev = NULL;
+    block->m_Size = size;
+    block->m_UsedSize = 0;
+  }
+  return block;
+}
@@ -0,0 +1,125 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+#pragma once
+
+// -- Standard Libs
+#include <stddef.h>
+
+// -- Mojo
+#include "MojoAlloc.h"
+
+/**
+ \class MojoArenaAlloc
+ \ingroup group_config
+ Bump allocator for temporary containers, such as the scratch sets of a frame or of a set expression. Allocate() only
+ advances a pointer, Free() does nothing, and Reset() releases everything at once. The exception is the most recent
+ allocation: FreeSized() gives it back, and Reallocate() grows or shrinks it in place, so an array that is the last
+ thing allocated grows without copying.
+ \code
+ MojoArenaAlloc frame_alloc( 256 * 1024 );
+ ...
+ MojoSet< MojoId > visible( "visible", NULL, &frame_alloc );
+ ...
+ visible.Destroy();
+ frame_alloc.Reset();   // At frame end
+ \endcode
+ Memory comes from another allocator in blocks. If a block is full, the arena chains a new one that is at least twice
+ as big, or fails if growth is off. Reset() keeps the newest block, which is the biggest, so an arena soon settles on
+ a single block that holds a whole frame. AllocateAligned() pads within the block, so aligned requests cost no more
+than the padding.
+ Not thread safe. Give each thread its own arena.
+ */
+class MojoArenaAlloc final : public MojoAlloc
+{
+public:
+  /**
+   Construct. The first block is allocated by the first call to Allocate().
+   \param[in] block_size Size in bytes of the first block.
+   \param[in] can_grow If false, Allocate() fails when the first block is full, instead of chaining another one.
+   \param[in] alloc Allocator for the blocks. If omitted, the global default will be used.
+   */
+  MojoArenaAlloc( size_t block_size, bool can_grow = true, MojoAlloc* alloc = NULL );
+  /**
+   Destructor. Releases all blocks.
+   */
+  virtual ~MojoArenaAlloc();
+
+  virtual void* Allocate( size_t byte_count, const char* name ) override;
+  /**
+   Does nothing. Memory is released by Reset().
+   */
+  virtual void  Free( void* p ) override;
+  /**
+   Resizes the most recent allocation in place, if it still fits in its block. Otherwise allocates and copies.
+   */
+  virtual void* Reallocate( void* p, size_t old_byte_count, size_t byte_count, const char* name ) override;
+  /**
+   Gives back the most recent allocation. Does nothing for any other block.
+   */
+  virtual void  FreeSized( void* p, size_t byte_count ) override;
+  virtual void* AllocateAligned( size_t byte_count, size_t alignment, const char* name ) override;
+  virtual void* ReallocateAligned( void* p, size_t old_byte_count, size_t byte_count, size_t alignment,
+                                   const char* name ) override;
+  virtual void  FreeAligned( void* p, size_t byte_count, size_t alignment ) override;
+
+  /**
+   Release everything that was allocated. Every pointer returned by Allocate() becomes invalid, so every container
+   that uses this arena must have been destroyed.
+   */
+  void Reset();
+
+  /**
+   Get the number of bytes handed out since the last Reset(), including alignment padding.
+   \return Bytes used.
+   */
+  size_t GetUsedSize() const;
+
+  /**
+   Get the number of bytes in all blocks.
+   \return Bytes held.
+   */
+  size_t GetCapacity() const;
+
+private:
+  struct Block
+  {
+    Block*      m_Prev;
+    size_t      m_Size;       // Bytes that follow the header
+    size_t      m_UsedSize;
+    size_t      m_Padding;    // Keep the header a multiple of the alignment
+  };
+
+  bool IsTop( const void* p, size_t byte_count ) const;
+  bool ResizeTop( void* p, size_t old_byte_count, size_t byte_count );
+  size_t GetAlignedOffset( size_t alignment ) const;
+  Block* NewBlock( size_t size );
+  
+  Block*      m_Block;          // Newest block. Older ones are chained through m_Prev
+  size_t      m_BlockSize;
+  size_t      m_UsedSize;       // In blocks before m_Block
+  bool        m_CanGrow;
+  MojoAlloc*  m_Alloc;
+};
@@ -27,9 +27,11 @@
 
 // Standard Libs
 #include <limits.h>
+#include <type_traits>
 
 // -- Mojo
 #include "MojoStatus.h"
+#include "MojoConstants.h"
 #include "MojoConfig.h"
 #include "MojoAlloc.h"
 #include "MojoAbstractSet.h"
@@ -554,7 +556,7 @@ void MojoArray< value_T >::Resize( int new_capacity )
       DestructValues();
       if( m_Values )
       {
-        m_Alloc->Free( m_Values );
+        m_Alloc->FreeAligned( m_Values, m_AllocCount * sizeof( value_T ), kMojoCacheLineSize );
         m_Values = NULL;
       }
       m_StartIndex = 0;
@@ -564,8 +566,33 @@ void MojoArray< value_T >::Resize( int new_capacity )
   }
   else if( new_capacity > m_AllocCount )
   {
+    if( m_Values && std::is_trivially_copyable< value_T >::value && m_StartIndex + m_ActiveCount <= m_AllocCount )
+    {
+      // Values may be moved as plain bytes and do not wrap around, so the allocator may grow the block in place
+      value_T* new_values = ( value_T* )m_Alloc->ReallocateAligned( m_Values, m_AllocCount * sizeof( value_T ),
+                                                                    new_capacity * sizeof( value_T ),
+                                                                    kMojoCacheLineSize, m_Name );
+      if( new_values )
+      {
+        m_Values = new_values;
+        m_AllocCount = new_capacity;
+      }
+      else
+      {
+        m_Status = kMojoStatus_CouldNotAlloc;
+      }
+      return;
+    }
+    
     // Allocate some new memory
-    value_T* new_values = ( value_T* )m_Alloc->Allocate( new_capacity * sizeof( value_T ), m_Name );
+    value_T* new_values = ( value_T* )m_Alloc->AllocateAligned( new_capacity * sizeof( value_T ), kMojoCacheLineSize,
+                                                                m_Name );
+    if( !new_values )
+    {
+      // Keep the old values
+      m_Status = kMojoStatus_CouldNotAlloc;
+      return;
+    }
     
     // Copy used portion from old to new array
     for( int i = 0; i < m_ActiveCount; ++i )
@@ -577,7 +604,7 @@ void MojoArray< value_T >::Resize( int new_capacity )
     {
       // Free old memory
       DestructValues();
-      m_Alloc->Free( m_Values );
+      m_Alloc->FreeAligned( m_Values, m_AllocCount * sizeof( value_T ), kMojoCacheLineSize );
     }
     
     m_Values = new_values;
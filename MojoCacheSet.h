@@ -180,7 +180,7 @@ void MojoCacheSet< key_T >::Update()
   {
     m_ChangeCount = change_count;
     m_CachedSet.Reset();
-    m_SetToCache->Enumerate( MojoSetCollector< key_T >( &m_CachedSet ) );
+    m_CachedSet.InsertFrom( *m_SetToCache );
   }
 }
 
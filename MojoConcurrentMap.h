@@ -0,0 +1,392 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+#include <mutex>
+
+// -- Mojo
+#include "MojoStatus.h"
+#include "MojoConstants.h"
+#include "MojoAlloc.h"
+#include "MojoConfig.h"
+#include "MojoAbstractSet.h"
+#include "MojoCollector.h"
+#include "MojoArray.h"
+#include "MojoMap.h"
+
+/**
+ \class MojoConcurrentMap
+ \ingroup group_container
+ A one-to-one hash table that may be used from several threads at once.
+ The keys are divided over kMojoConcurrentShardCount shards. Each shard is a MojoMap with its own lock. The shard is
+ picked from the high bits of the (scrambled) hash code, so the tables inside the shards, which use the low bits, still
+ see well-distributed keys. Threads that work on different shards do not wait for each other.
+ Also implements the MojoAbstractSet interface. As a MojoAbstractSet, the map work more like a set. That is, only the
+ presence of keys is used.
+ \note There is no MojoForEachKey support, because iteration by index cannot be made safe while other threads write. Use
+ Enumerate() instead. It copies the keys of each shard out before it calls the collector, so the collector and the limit
+ may use the map.
+ \tparam key_T Key type. Must be hashable.
+ \tparam value_T Value type.
+ */
+template< typename key_T, typename value_T >
+class MojoConcurrentMap final : public MojoAbstractSet< key_T >
+{
+public:
+  
+  /**
+   Default constructor. You must call Create() before the map is ready for use.
+   */
+  MojoConcurrentMap()
+  {
+    Init();
+  }
+  
+  /**
+   Initializing constructor. No need to call Create().
+   \param[in] name The name of the map. Will also be used for internal memory allocation.
+   \param[in] not_found_value The value to return if nothing was found.
+   \param[in] config Config to use for each shard. If omitted, the global default will be used. See documentation for
+   MojoConfig for details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global defualt will be used. See documentation for MojoAlloc for
+   details on how to set the global default. The allocator will be called from several threads.
+   */
+  MojoConcurrentMap( const char* name, const value_T& not_found_value = value_T(), const MojoConfig* config = NULL,
+                    MojoAlloc* alloc = NULL )
+  {
+    Init();
+    Create( name, not_found_value, config, alloc );
+  }
+  
+  /**
+   Create after default constructor or Destroy(). Not thread-safe.
+   \param[in] name The name of the map. Will also be used for internal memory allocation.
+   \param[in] not_found_value The value to return if nothing was found.
+   \param[in] config Config to use for each shard. If omitted, the global default will be used. See documentation for
+   MojoConfig for details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global defualt will be used. See documentation for MojoAlloc for
+   details on how to set the global default. The allocator will be called from several threads.
+   \return Status code.
+   */
+  MojoStatus Create( const char* name, const value_T& not_found_value = value_T(), const MojoConfig* config = NULL,
+                   MojoAlloc* alloc = NULL );
+  
+  /**
+   Remove all key-value pairs and free all allocated buffers. Not thread-safe.
+   */
+  void Destroy();
+  
+  /**
+   Remove all key-value pairs.
+   */
+  void Reset();
+  
+  /**
+   Insert key-value pair into the map. If key already exists in map, the value is overwritten.
+   \param[in] key Key of the key-value pair to insert.
+   \param[in] value Value of the key-value pair to insert.
+   \return Status code.
+   */
+  MojoStatus Insert( const key_T& key, const value_T& value );
+  
+  /**
+   Remove key-value pair from the map.
+   \param[in] key Key of the key-value pair to remove.
+   \return The removed value. If key was not found, the not_found_value is returned.
+   */
+  value_T Remove( const key_T& key );
+  
+  /**
+   Find value that is associated with the key.
+   \param[in] key Key to seach for.
+   \return The value. If key was not found, the not_found_value is returned.
+   */
+  value_T Find( const key_T& key ) const;
+  
+  /**
+   Test presence of a key.
+   \param[in] key Key to seach for.
+   \return true if key is in the map.
+   */
+  virtual bool Contains( const key_T& key ) const override;
+  
+  /**
+   Square bracket operator is an alias for Find()
+   */
+  value_T operator[]( const key_T& key ) const { return Find( key ); }
+  
+  /**
+   Update table sizes, if needed. See MojoMap::Update().
+   \return Status code.
+   */
+  MojoStatus Update();
+  
+  /**
+   Return table status state. This is the only way to find out if something went wrong in the default constructor.
+   If Create() was used, the returned status code will be the same.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const;
+  
+  /**
+   Get number of key-value pairs in the map. While other threads write, the count is only a snapshot.
+   \return Number of pairs.
+   */
+  int GetCount() const;
+  
+  /**
+   Return name of the map.
+   \return Given name.
+   */
+  const char* GetName() const { return m_Name; }
+  
+  virtual void Enumerate( const MojoCollector< key_T >& collector,
+                         const MojoAbstractSet< key_T >* limit = NULL ) const override;
+  /** \private */
+  virtual int _GetEnumerationCost() const override;
+  /** \private */
+  virtual int _GetChangeCount() const override;
+  
+  virtual ~MojoConcurrentMap();
+  
+private:
+  
+  struct Shard
+  {
+    mutable std::mutex          m_Lock;
+    MojoMap< key_T, value_T >   m_Map;
+    char                        m_Padding[ 64 ];  // Keep the locks of neighboring shards out of each other's cache line
+  };
+  
+  const char*         m_Name;
+  value_T             m_NotFoundValue;
+  MojoStatus           m_Status;
+  Shard               m_Shards[ kMojoConcurrentShardCount ];
+  
+  void Init();
+  Shard& GetShard( const key_T& key );
+  const Shard& GetShard( const key_T& key ) const;
+};
+// ---------------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename key_T, typename value_T >
+void MojoConcurrentMap< key_T, value_T >::Init()
+{
+  m_Name = NULL;
+  m_Status = kMojoStatus_NotInitialized;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoConcurrentMap< key_T, value_T >::GetStatus() const
+{
+  return m_Status;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoConcurrentMap< key_T, value_T >::Create( const char* name, const value_T& not_found_value,
+                                                        const MojoConfig* config, MojoAlloc* alloc )
+{
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    m_Status = kMojoStatus_DoubleInitialized;
+  }
+  else
+  {
+    m_Name = name;
+    m_NotFoundValue = not_found_value;
+    m_Status = kMojoStatus_Ok;
+    for( int i = 0; i < kMojoConcurrentShardCount && !m_Status; ++i )
+    {
+      m_Status = m_Shards[ i ].m_Map.Create( name, not_found_value, config, alloc );
+    }
+  }
+  return m_Status;
+}
+
+template< typename key_T, typename value_T >
+MojoConcurrentMap< key_T, value_T >::~MojoConcurrentMap()
+{
+  Destroy();
+}
+
+template< typename key_T, typename value_T >
+void MojoConcurrentMap< key_T, value_T >::Destroy()
+{
+  for( int i = 0; i < kMojoConcurrentShardCount; ++i )
+  {
+    m_Shards[ i ].m_Map.Destroy();
+  }
+  Init();
+}
+
+template< typename key_T, typename value_T >
+void MojoConcurrentMap< key_T, value_T >::Reset()
+{
+  for( int i = 0; i < kMojoConcurrentShardCount; ++i )
+  {
+    std::lock_guard< std::mutex > lock( m_Shards[ i ].m_Lock );
+    m_Shards[ i ].m_Map.Reset();
+  }
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoConcurrentMap< key_T, value_T >::Insert( const key_T& key, const value_T& value )
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  if( key.IsHashNull() )
+  {
+    return kMojoStatus_InvalidArguments;
+  }
+  Shard& shard = GetShard( key );
+  std::lock_guard< std::mutex > lock( shard.m_Lock );
+  return shard.m_Map.Insert( key, value );
+}
+
+template< typename key_T, typename value_T >
+value_T MojoConcurrentMap< key_T, value_T >::Remove( const key_T& key )
+{
+  if( m_Status || key.IsHashNull() )
+  {
+    return m_NotFoundValue;
+  }
+  Shard& shard = GetShard( key );
+  std::lock_guard< std::mutex > lock( shard.m_Lock );
+  return shard.m_Map.Remove( key );
+}
+
+template< typename key_T, typename value_T >
+value_T MojoConcurrentMap< key_T, value_T >::Find( const key_T& key ) const
+{
+  if( m_Status || key.IsHashNull() )
+  {
+    return m_NotFoundValue;
+  }
+  const Shard& shard = GetShard( key );
+  std::lock_guard< std::mutex > lock( shard.m_Lock );
+  return shard.m_Map.Find( key );
+}
+
+template< typename key_T, typename value_T >
+bool MojoConcurrentMap< key_T, value_T >::Contains( const key_T& key ) const
+{
+  if( m_Status || key.IsHashNull() )
+  {
+    return false;
+  }
+  const Shard& shard = GetShard( key );
+  std::lock_guard< std::mutex > lock( shard.m_Lock );
+  return shard.m_Map.Contains( key );
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoConcurrentMap< key_T, value_T >::Update()
+{
+  MojoStatus status = m_Status;
+  for( int i = 0; i < kMojoConcurrentShardCount && !status; ++i )
+  {
+    std::lock_guard< std::mutex > lock( m_Shards[ i ].m_Lock );
+    status = m_Shards[ i ].m_Map.Update();
+  }
+  return status;
+}
+
+template< typename key_T, typename value_T >
+int MojoConcurrentMap< key_T, value_T >::GetCount() const
+{
+  int count = 0;
+  for( int i = 0; i < kMojoConcurrentShardCount; ++i )
+  {
+    std::lock_guard< std::mutex > lock( m_Shards[ i ].m_Lock );
+    count += m_Shards[ i ].m_Map.GetCount();
+  }
+  return count;
+}
+
+template< typename key_T, typename value_T >
+void MojoConcurrentMap< key_T, value_T >::Enumerate( const MojoCollector< key_T >& collector,
+                                                    const MojoAbstractSet< key_T >* limit ) const
+{
+  // One shard at a time. Each shard is consistent in itself, but others may change in the meantime. The keys are copied
+  // out under the lock, and filtered and pushed after it is released, so that a limit that refers to this map again
+  // does not wait for a lock that this thread holds.
+  MojoArray< key_T > keys( m_Name );
+  MojoArrayCollector< key_T > keys_collector( &keys );
+  for( int i = 0; i < kMojoConcurrentShardCount; ++i )
+  {
+    {
+      std::lock_guard< std::mutex > lock( m_Shards[ i ].m_Lock );
+      m_Shards[ i ].m_Map.Enumerate( keys_collector );
+    }
+    for( int j = 0; j < keys.GetCount(); ++j )
+    {
+      key_T key = keys[ j ];
+      if( !limit || limit->Contains( key ) )
+      {
+        collector.Push( key );
+      }
+    }
+    keys.Reset();
+  }
+}
+
+template< typename key_T, typename value_T >
+int MojoConcurrentMap< key_T, value_T >::_GetEnumerationCost() const
+{
+  return GetCount();
+}
+
+template< typename key_T, typename value_T >
+int MojoConcurrentMap< key_T, value_T >::_GetChangeCount() const
+{
+  int count = 0;
+  for( int i = 0; i < kMojoConcurrentShardCount; ++i )
+  {
+    std::lock_guard< std::mutex > lock( m_Shards[ i ].m_Lock );
+    count += m_Shards[ i ].m_Map._GetChangeCount();
+  }
+  return count;
+}
+
+template< typename key_T, typename value_T >
+typename MojoConcurrentMap< key_T, value_T >::Shard& MojoConcurrentMap< key_T, value_T >::GetShard( const key_T& key )
+{
+  // Scramble the hash code, then scale its top 32 bits to the shard count
+  uint64_t hash = key.GetHash() * 0x9E3779B97F4A7C15ull;
+  return m_Shards[ ( ( hash >> 32 ) * kMojoConcurrentShardCount ) >> 32 ];
+}
+
+template< typename key_T, typename value_T >
+const typename MojoConcurrentMap< key_T, value_T >::Shard&
+MojoConcurrentMap< key_T, value_T >::GetShard( const key_T& key ) const
+{
+  return const_cast< MojoConcurrentMap* >( this )->GetShard( key );
+}
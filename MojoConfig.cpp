@@ -43,6 +43,9 @@ MojoConfig::MojoConfig( bool )
   m_AutoGrow          = true;
   m_AutoShrink        = true;
   m_DynamicAlloc      = true;
+  m_RobinHood         = false;
+  m_ResizeStepCount   = 0;
+  m_CacheHash         = false;
 }
 
 const MojoConfig* MojoConfig::s_Default = NULL;
@@ -90,6 +90,34 @@ struct MojoConfig
    allowed.
    */
   bool        m_DynamicAlloc;
+  /**
+   Use Robin Hood displacement in the hash tables.
+   On insertion, a key may take the slot of a key that is closer to its own home slot, and that key moves forward.
+   This keeps the probe lengths of all keys close to each other. On removal, the keys that follow the removed key
+   are shifted back by one slot, instead of being rehashed one by one.
+   Probe distances are computed from stored hash codes, so this turns on m_CacheHash as well. Has no effect when using
+   a fixed array.
+   <br>Default is false.
+   */
+  bool        m_RobinHood;
+  /**
+   Number of slots to migrate per operation during an incremental resize.
+   When this is 0, a resize that needs new memory rehashes the whole table at once, inside the Insert(), Remove() or
+   Update() call that triggered it. Otherwise the old table is kept next to the new one, and every Insert(), Remove()
+   and Update() call moves up to this many slots of the old table into the new one. Look-ups check both tables while
+   a resize is in progress.
+   <br>Resizes that fit in the memory already allocated are always done at once.
+   <br>Default is 0.
+   */
+  int         m_ResizeStepCount;
+  /**
+   Store the full hash code of each key next to it in the hash tables, at a cost of 8 bytes per slot.
+   Resizing and removal then never call GetHash() on a key that is already in the table, and look-ups compare the
+   stored hash codes before comparing keys. Worthwhile when keys are expensive to hash or to compare.
+   Has no effect when using a fixed array.
+   <br>Default is false.
+   */
+  bool        m_CacheHash;
   
   /**
    Get the current default config.
@@ -30,3 +30,129 @@
  Maximum number of sets that can be combined in a single MojoUnion, MojoIntersection, MojoDifference etc.
  */
 static const int kMojoInputSetMax = 20;
+
+/**
+ \ingroup group_config
+ When 1 (the default), MojoId is reference counted: the string of a MojoId is removed from the dictionary as soon as
+ the last MojoId that refers to it is destroyed.
+ When 0, MojoId is a trivially copyable 64-bit value. Copying, assigning and destroying it costs nothing, so containers
+ of MojoIds copy at memcpy speed. Strings stay in the dictionary until MojoIdManager::Sweep() removes them. Define this
+ the same way for every translation unit.
+ */
+#ifndef MOJO_ID_REFCOUNT
+#define MOJO_ID_REFCOUNT 1
+#endif
+
+/**
+ \ingroup group_config
+ Selects the string hash that MojoStringHash64() uses, and with it MojoId, MojoHashable and MojoHashableCString.
+ When 0 (the default), it is MojoFnv64(), which is stable across versions and suitable for persisted hash codes.
+ When 1, it is MojoWideHash64(), which reads 16 bytes per step and is much faster on long strings. Define this the
+ same way for every translation unit.
+ */
+#ifndef MOJO_WIDE_STRING_HASH
+#define MOJO_WIDE_STRING_HASH 0
+#endif
+
+/**
+ \ingroup group_config
+ Number of keys that MojoSet::ContainsMany() and MojoMap::FindMany() hash and prefetch before resolving the probes.
+ */
+static const int kMojoLookupBatchCount = 16;
+
+/**
+ \ingroup group_config
+ Alignment in bytes of the storage of MojoArray, MojoSet, MojoMap and MojoMultiMap. Their storage starts on a cache
+ line, and so do the control bytes of the hash tables, so that a group of control bytes rarely spans two lines.
+ */
+static const int kMojoCacheLineSize = 64;
+
+/**
+ \ingroup group_config
+ Number of shards in a MojoConcurrentMap. Each shard has its own lock, so this is the number of threads that can write
+ to the map at the same time without waiting for each other.
+ */
+static const int kMojoConcurrentShardCount = 16;
+
+/**
+ \ingroup group_config
+ Maximum number of reader threads that can be registered with a MojoQsbr at the same time.
+ */
+static const int kMojoQsbrReaderMax = 64;
+
+/**
+ \ingroup group_config
+ Number of shards in the MojoIdManager. Each shard has its own lock, which is taken when a string is added to or removed
+ from the dictionary.
+ */
+static const int kMojoIdManagerShardCount = 16;
+
+/**
+ \ingroup group_config
+ Size in bytes of the blocks that the MojoIdManager packs its strings into. A string that does not fit gets a block of
+ its own.
+ */
+static const int kMojoIdStringBlockSize = 16384;
+
+/**
+ \ingroup group_config
+ When 1, the MojoIdManager also counts IncRefCount() and DecRefCount() calls. See MojoIdManager::GetStats(). Those
+ counts are atomic operations on a counter that all ids of a shard share, so this is 0 (off) by default. The other
+ statistics are always kept.
+ */
+#ifndef MOJO_ID_STATS
+#define MOJO_ID_STATS 0
+#endif
+
+/**
+ \ingroup group_config
+ Number of strings that the MojoIdManager tracks for its hot id report. See MojoIdManager::SetHotSampleRate().
+ */
+static const int kMojoIdHotCount = 32;
+
+/**
+ \ingroup group_config
+ Longest string, including the terminator, that the hot id report keeps. Longer strings are truncated.
+ */
+static const int kMojoIdHotStringMax = 64;
+
+/**
+ \ingroup group_config
+ Largest request that MojoPoolAlloc serves from its size classes is 2 to the power of this. Bigger requests go to the
+ backing allocator.
+ */
+static const int kMojoPoolClassShiftMax = 20;
+
+/**
+ \ingroup group_config
+ Number of free list caches in a MojoPoolAlloc. Threads are spread over them, so up to this many threads allocate
+ without ever waiting for each other.
+ */
+static const int kMojoPoolCacheCount = 16;
+
+/**
+ \ingroup group_config
+ Bytes per size class that a MojoPoolAlloc cache holds on to before it returns half of its blocks to the shared lists.
+ A cache always holds at least two blocks.
+ */
+static const int kMojoPoolCacheBytes = 256 * 1024;
+
+/**
+ \ingroup group_config
+ Size in bytes of the chunks that a MojoPoolAlloc carves its blocks from. Classes with bigger blocks get one block per
+ chunk.
+ */
+static const int kMojoPoolChunkSize = 64 * 1024;
+
+/**
+ \ingroup group_config
+ Size in bytes of a huge page. MojoHugePageAlloc aligns its mappings to this, and rounds their size up to a multiple
+ of it. 2 MB is the huge page size of x86-64 and of most ARM64 kernels.
+ */
+static const int kMojoHugePageSize = 2 * 1024 * 1024;
+
+/**
+ \ingroup group_config
+ Smallest request that MojoHugePageAlloc maps with huge pages. Smaller requests go to its other allocator.
+ */
+static const int kMojoHugePageThreshold = 2 * 1024 * 1024;
@@ -0,0 +1,171 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define MOJO_CTRL_SSE2 1
+#include <emmintrin.h>
+#else
+#define MOJO_CTRL_SSE2 0
+#endif
+
+#if _MSC_VER
+#include <intrin.h>
+#endif
+
+/**
+ \file MojoCtrl.h
+ Control bytes for the hash tables.
+ Next to its slots, a hash table keeps one control byte per slot. A control byte holds either a 7-bit fragment of the
+ hash code of the key in that slot, or one of the special values below. Probing tests the control bytes of 16 slots at
+ once, and only touches the keys where the fragment matches.
+ */
+
+/**
+ \ingroup group_util
+ Number of control bytes tested in one probe step.
+ */
+static const int kMojoCtrlGroupSize = 16;
+
+/**
+ \ingroup group_util
+ Control byte of an unoccupied slot. Probing stops here.
+ */
+static const uint8_t kMojoCtrl_Empty = 0x80;
+
+/**
+ \ingroup group_util
+ Control byte of a slot that has been vacated, but that probing must step over.
+ */
+static const uint8_t kMojoCtrl_Deleted = 0xFE;
+
+/**
+ \ingroup group_util
+ Control byte of a slot past the end of the table. It is neither empty nor occupied.
+ */
+static const uint8_t kMojoCtrl_End = 0xFF;
+
+/**
+ \ingroup group_util
+ Compute the control byte for an occupied slot.
+ The table index is computed from the low bits of the hash code, so the fragment is taken from the high bits. Both
+ halves of the hash code contribute, so that 32-bit hash codes also produce useful fragments.
+ \param[in] hash Hash code of the key.
+ \return Control byte in range 0..127.
+ */
+inline uint8_t MojoCtrlFromHash( uint64_t hash )
+{
+  return ( uint8_t )( ( ( hash >> 57 ) ^ ( hash >> 25 ) ) & 0x7F );
+}
+
+/**
+ \ingroup group_util
+ Test if a control byte marks an occupied slot.
+ */
+inline bool MojoCtrlIsFull( uint8_t ctrl )
+{
+  return ctrl < 0x80;
+}
+
+/**
+ \ingroup group_util
+ Compare a group of control bytes with a value.
+ \param[in] group Pointer to kMojoCtrlGroupSize control bytes. No alignment required.
+ \param[in] ctrl Value to compare with.
+ \return Bit mask. Bit i is set if group[ i ] equals ctrl.
+ */
+inline uint32_t MojoCtrlMatch( const uint8_t* group, uint8_t ctrl )
+{
+#if MOJO_CTRL_SSE2
+  __m128i bytes = _mm_loadu_si128( ( const __m128i* )group );
+  return ( uint32_t )_mm_movemask_epi8( _mm_cmpeq_epi8( bytes, _mm_set1_epi8( ( char )ctrl ) ) );
+#else
+  uint32_t mask = 0;
+  for( int i = 0; i < kMojoCtrlGroupSize; ++i )
+  {
+    if( group[ i ] == ctrl )
+    {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/**
+ \ingroup group_util
+ Find the empty slots in a group of control bytes.
+ \param[in] group Pointer to kMojoCtrlGroupSize control bytes. No alignment required.
+ \return Bit mask. Bit i is set if group[ i ] is kMojoCtrl_Empty.
+ */
+inline uint32_t MojoCtrlMatchEmpty( const uint8_t* group )
+{
+  return MojoCtrlMatch( group, kMojoCtrl_Empty );
+}
+
+/**
+ \ingroup group_util
+ Find the occupied slots in a group of control bytes.
+ \param[in] group Pointer to kMojoCtrlGroupSize control bytes. No alignment required.
+ \return Bit mask. Bit i is set if group[ i ] is an occupied slot.
+ */
+inline uint32_t MojoCtrlMatchFull( const uint8_t* group )
+{
+#if MOJO_CTRL_SSE2
+  __m128i bytes = _mm_loadu_si128( ( const __m128i* )group );
+  return ( uint32_t )_mm_movemask_epi8( bytes ) ^ 0xFFFF;
+#else
+  uint32_t mask = 0;
+  for( int i = 0; i < kMojoCtrlGroupSize; ++i )
+  {
+    if( MojoCtrlIsFull( group[ i ] ) )
+    {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/**
+ \ingroup group_util
+ Return the position of the lowest set bit.
+ \param[in] mask Bit mask. Must not be 0.
+ \return Bit position.
+ */
+inline int MojoCtrlFirst( uint32_t mask )
+{
+#if _MSC_VER
+  unsigned long index;
+  _BitScanForward( &index, mask );
+  return ( int )index;
+#else
+  return __builtin_ctz( mask );
+#endif
+}
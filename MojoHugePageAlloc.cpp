@@ -0,0 +1,204 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+// -- Self
+#include "MojoHugePageAlloc.h"
+
+// -- Standard Libs
+#if defined( __linux__ )
+#include <sys/mman.h>
+#endif
+
+// Mapped blocks start this far into their mapping, with the header just before them
+static const size_t kMappedOffset = kMojoCacheLineSize;
+
+MojoHugePageAlloc::MojoHugePageAlloc( bool use_hugetlb, MojoAlloc* alloc )
+: m_MappedSize( 0 )
+, m_HugeTlbSize( 0 )
+, m_UseHugeTlb( use_hugetlb )
+, m_Alloc( alloc ? alloc : MojoAlloc::GetDefault() )
+{
+}
+
+void* MojoHugePageAlloc::Allocate( size_t byte_count, const char* name )
+{
+  if( byte_count >= ( size_t )kMojoHugePageThreshold )
+  {
+    void* p = AllocateMapped( byte_count );
+    if( p )
+    {
+      return p;
+    }
+  }
+  Header* header = ( Header* )m_Alloc->Allocate( sizeof( Header ) + byte_count, name );
+  if( !header )
+  {
+    return NULL;
+  }
+  header->m_MapSize = 0;
+  header->m_HugeTlb = 0;
+  return header + 1;
+}
+
+void MojoHugePageAlloc::Free( void* p )
+{
+  if( !p )
+  {
+    return;
+  }
+  Header* header = ( Header* )p - 1;
+  if( !header->m_MapSize )
+  {
+    m_Alloc->Free( header );
+    return;
+  }
+#if defined( __linux__ )
+  size_t size = header->m_MapSize;
+  if( header->m_HugeTlb )
+  {
+    m_HugeTlbSize -= size;
+  }
+  m_MappedSize -= size;
+  munmap( ( char* )p - kMappedOffset, size );
+#endif
+}
+
+// Blocks from m_Alloc->AllocateAligned() start this far in, so that the header fits before them and they stay aligned
+static size_t GetHeaderOffset( size_t header_size, size_t alignment )
+{
+  alignment = alignment ? alignment : 1;
+  return ( header_size + alignment - 1 ) & ~( alignment - 1 );
+}
+
+void* MojoHugePageAlloc::AllocateAligned( size_t byte_count, size_t alignment, const char* name )
+{
+  if( byte_count >= ( size_t )kMojoHugePageThreshold && alignment <= kMappedOffset )
+  {
+    void* p = AllocateMapped( byte_count );
+    if( p )
+    {
+      return p;
+    }
+  }
+  size_t offset = GetHeaderOffset( sizeof( Header ), alignment );
+  char* base = ( char* )m_Alloc->AllocateAligned( offset + byte_count, alignment, name );
+  if( !base )
+  {
+    return NULL;
+  }
+  Header* header = ( Header* )( base + offset ) - 1;
+  header->m_MapSize = 0;
+  header->m_HugeTlb = 0;
+  return header + 1;
+}
+
+void MojoHugePageAlloc::FreeAligned( void* p, size_t byte_count, size_t alignment )
+{
+  if( !p )
+  {
+    return;
+  }
+  if( ( ( Header* )p - 1 )->m_MapSize )
+  {
+    Free( p );
+    return;
+  }
+  size_t offset = GetHeaderOffset( sizeof( Header ), alignment );
+  m_Alloc->FreeAligned( ( char* )p - offset, offset + byte_count, alignment );
+}
+
+size_t MojoHugePageAlloc::GetMappedSize() const
+{
+  return m_MappedSize.load( std::memory_order_relaxed );
+}
+
+size_t MojoHugePageAlloc::GetHugeTlbSize() const
+{
+  return m_HugeTlbSize.load( std::memory_order_relaxed );
+}
+
+void* MojoHugePageAlloc::AllocateMapped( size_t byte_count )
+{
+  size_t size = ( byte_count + kMappedOffset + kMojoHugePageSize - 1 ) & ~( ( size_t )kMojoHugePageSize - 1 );
+  bool hugetlb = false;
+  char* base = ( char* )Map( size, &hugetlb );
+  if( !base )
+  {
+    return NULL;
+  }
+  m_MappedSize += size;
+  if( hugetlb )
+  {
+    m_HugeTlbSize += size;
+  }
+  Header* header = ( Header* )( base + kMappedOffset ) - 1;
+  header->m_MapSize = size;
+  header->m_HugeTlb = hugetlb ? 1 : 0;
+  return header + 1;
+}
+
+void* MojoHugePageAlloc::Map( size_t size, bool* hugetlb )
+{
+#if defined( __linux__ )
+#if defined( MAP_HUGETLB )
+  if( m_UseHugeTlb )
+  {
+    void* p = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+    if( p != MAP_FAILED )
+    {
+      *hugetlb = true;
+      return p;
+    }
+  }
+#endif
+  
+  // Transparent huge pages only back whole, aligned huge pages. Map an extra huge page and trim to a boundary.
+  size_t map_size = size + kMojoHugePageSize;
+  char* raw = ( char* )mmap( NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if( raw == ( char* )MAP_FAILED )
+  {
+    return NULL;
+  }
+  char* p = ( char* )( ( ( uintptr_t )raw + kMojoHugePageSize - 1 ) & ~( ( uintptr_t )kMojoHugePageSize - 1 ) );
+  size_t head = p - raw;
+  if( head )
+  {
+    munmap( raw, head );
+  }
+  if( map_size - head > size )
+  {
+    munmap( p + size, map_size - head - size );
+  }
+#if defined( MADV_HUGEPAGE )
+  // If transparent huge pages are off, this fails and the mapping simply uses normal pages
+  madvise( p, size, MADV_HUGEPAGE );
+#endif
+  return p;
+#else
+  ( void )size;
+  ( void )hugetlb;
+  return NULL;
+#endif
+}
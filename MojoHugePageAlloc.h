@@ -0,0 +1,103 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+#pragma once
+
+// -- Standard Libs
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// -- Mojo
+#include "MojoAlloc.h"
+#include "MojoConstants.h"
+
+/**
+ \class MojoHugePageAlloc
+ \ingroup group_config
+ Allocator for very large tables, such as big MojoMaps and the id dictionary, whose lookups suffer from TLB misses.
+ Requests of at least kMojoHugePageThreshold bytes are mapped directly with mmap() and backed by huge pages. Smaller
+ requests go to another allocator.
+ \code
+ MojoHugePageAlloc huge_alloc;
+ g_MojoIdManager.Create( NULL, &huge_alloc );
+ MojoMap< MojoId, Entity* > entities( "entities", NULL, NULL, &huge_alloc );
+ \endcode
+ - By default, a mapping is aligned to kMojoHugePageSize and advised with madvise( MADV_HUGEPAGE ), so that transparent
+ huge pages back it. That requires /sys/kernel/mm/transparent_hugepage/enabled to be "always" or "madvise".
+ - With use_hugetlb, mappings are first tried with MAP_HUGETLB, which needs huge pages reserved through
+ /proc/sys/vm/nr_hugepages. If none are free, the mapping falls back to transparent huge pages.
+ - Mapped sizes are rounded up to a multiple of kMojoHugePageSize.
+ - On platforms other than Linux, or if a mapping fails, every request goes to the other allocator.
+ Thread safe, if the other allocator is.
+ */
+class MojoHugePageAlloc final : public MojoAlloc
+{
+public:
+  /**
+   Construct.
+   \param[in] use_hugetlb If true, try reserved huge pages (MAP_HUGETLB) before transparent huge pages.
+   \param[in] alloc Allocator for small requests. If omitted, the global default will be used.
+   */
+  MojoHugePageAlloc( bool use_hugetlb = false, MojoAlloc* alloc = NULL );
+
+  virtual void* Allocate( size_t byte_count, const char* name ) override;
+  virtual void  Free( void* p ) override;
+  /**
+   Large blocks are mapped with at least kMojoCacheLineSize alignment, so those are served directly. Other blocks, and
+   large ones whose mapping failed, come from the other allocator's AllocateAligned().
+   */
+  virtual void* AllocateAligned( size_t byte_count, size_t alignment, const char* name ) override;
+  virtual void  FreeAligned( void* p, size_t byte_count, size_t alignment ) override;
+
+  /**
+   Get the number of bytes currently mapped for large requests.
+   \return Bytes mapped.
+   */
+  size_t GetMappedSize() const;
+
+  /**
+   Get the number of bytes currently mapped with MAP_HUGETLB. The rest of GetMappedSize() relies on transparent huge
+   pages.
+   \return Bytes mapped with reserved huge pages.
+   */
+  size_t GetHugeTlbSize() const;
+
+private:
+  struct Header
+  {
+    size_t      m_MapSize;    // Size of the mapping, or 0 for blocks from m_Alloc
+    uint32_t    m_HugeTlb;
+    uint32_t    m_Padding;    // Keep the block 16-byte aligned
+  };
+
+  void* AllocateMapped( size_t byte_count );
+  void* Map( size_t size, bool* hugetlb );
+
+  std::atomic< size_t > m_MappedSize;
+  std::atomic< size_t > m_HugeTlbSize;
+  bool                  m_UseHugeTlb;
+  MojoAlloc*            m_Alloc;
+};
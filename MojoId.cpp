@@ -29,8 +29,12 @@
 // -- Mojo
 #include "MojoIdManager.h"
 
+// -- Standard Libs
+#include <string.h>
+
 const MojoId MojoId::s_Null = MojoId();
 
+#if MOJO_ID_REFCOUNT
 // copy constructor
 MojoId::MojoId( const MojoId& other )
 {
@@ -40,12 +44,26 @@ MojoId::MojoId( const MojoId& other )
     IncRefCount( m_HashValue );
   }
 }
+#endif
 
 MojoId::MojoId( const char* c_string )
 {
   m_HashValue = g_MojoIdManager.Insert( c_string );
 }
 
+MojoId::MojoId( const char* chars, int length )
+{
+  m_HashValue = length > 0 ? g_MojoIdManager.Insert( chars, length, MojoStringHash64( chars, length ) ) : 0;
+}
+
+MojoId::MojoId( const MojoStaticId& static_id )
+{
+  // Taken under the shard lock. Without a reference, a lock-free lookup could see the entry freed and its memory reused.
+  const char* c_string = static_id.AsCString();
+  m_HashValue = g_MojoIdManager.Insert( c_string, c_string ? ( int )strlen( c_string ) : 0, static_id.AsUint64() );
+}
+
+#if MOJO_ID_REFCOUNT
 MojoId& MojoId::operator= ( const MojoId& other )
 {
   if( m_HashValue != other.m_HashValue )
@@ -56,6 +74,7 @@ MojoId& MojoId::operator= ( const MojoId& other )
   }
   return *this;
 }
+#endif
 
 MojoId& MojoId::operator= ( const char* c_string )
 {
@@ -65,6 +84,47 @@ MojoId& MojoId::operator= ( const char* c_string )
   return *this;
 }
 
+MojoStatus MojoId::Set( const char* c_string )
+{
+  MojoStatus status = kMojoStatus_Ok;
+  uint64_t old_hash_value = m_HashValue;
+  int length = c_string ? ( int )strlen( c_string ) : 0;
+  m_HashValue = g_MojoIdManager.Insert( c_string, length, MojoStringHash64( c_string ), &status );
+  DecRefCount( old_hash_value );
+  return status;
+}
+
+MojoStatus MojoId::Set( const char* chars, int length )
+{
+  MojoStatus status = kMojoStatus_Ok;
+  uint64_t old_hash_value = m_HashValue;
+  m_HashValue = length > 0 ? g_MojoIdManager.Insert( chars, length, MojoStringHash64( chars, length ), &status ) : 0;
+  DecRefCount( old_hash_value );
+  return status;
+}
+
+MojoStatus MojoId::InternMany( const MojoStringView* strings, int count, MojoId* ids )
+{
+  if( count <= 0 )
+  {
+    return kMojoStatus_Ok;
+  }
+  uint64_t* hash_codes = ( uint64_t* )g_MojoIdManager.m_Alloc->Allocate( count * sizeof( uint64_t ), "MojoId" );
+  if( !hash_codes )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+  MojoStatus status = g_MojoIdManager.InsertMany( strings, count, hash_codes );
+  for( int i = 0; i < count; ++i )
+  {
+    // The new references are already counted, so release the old ones and take over the hash codes
+    DecRefCount( ids[ i ].m_HashValue );
+    ids[ i ].m_HashValue = hash_codes[ i ];
+  }
+  g_MojoIdManager.m_Alloc->FreeSized( hash_codes, count * sizeof( uint64_t ) );
+  return status;
+}
+
 void MojoId::SetNull()
 {
   if( m_HashValue )
@@ -74,6 +134,11 @@ void MojoId::SetNull()
   m_HashValue = 0;
 }
 
+void MojoId::Mark() const
+{
+  g_MojoIdManager.Mark( m_HashValue );
+}
+
 const char* MojoId::AsCString() const
 {
   return FindCString( m_HashValue );
@@ -94,3 +159,19 @@ void MojoId::DecRefCount( uint64_t hash_value )
   g_MojoIdManager.DecRefCount( hash_value );
 }
 
+MojoIndexId::MojoIndexId( const MojoId& id )
+{
+  m_Index = g_MojoIdManager.FindDenseIndex( id.AsUint64() );
+}
+
+MojoId MojoIndexId::AsId() const
+{
+  MojoId id;
+  id.m_HashValue = m_Index ? g_MojoIdManager.FindDenseHash( m_Index ) : 0;
+  if( id.m_HashValue )
+  {
+    MojoId::IncRefCount( id.m_HashValue );
+  }
+  return id;
+}
+
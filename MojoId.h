@@ -30,6 +30,72 @@
 
 // -- Mojo
 #include "MojoUtil.h"
+#include "MojoConstants.h"
+#include "MojoStatus.h"
+
+// -- Standard Libs
+#include <stddef.h>
+
+/**
+ \class MojoStaticId
+ \ingroup group_id
+ A string literal with a hash code that is computed at compile time. It converts to a MojoId without hashing the
+ string, and compares to a MojoId without touching the dictionary at all. The string is only added to the dictionary
+ when a MojoId is made from it.
+ \code
+ if( id == "Transform"_id )            // Compares hash codes only
+   ...
+ static const MojoId kTransform = "Transform"_id;  // Registered once, the first time this line runs
+ map.Find( kTransform );
+ \endcode
+ */
+class MojoStaticId
+{
+public:
+  /**
+   Construct from a string literal.
+   \param[in] c_string The string. Must outlive the MojoStaticId.
+   */
+  constexpr explicit MojoStaticId( const char* c_string )
+  : m_CString( c_string )
+  , m_HashValue( MojoConstStringHash64( c_string ) )
+  {}
+
+  /**
+   Construct from a string and its hash code, as computed by a tool ahead of time.
+   \param[in] c_string The string. Must outlive the MojoStaticId.
+   \param[in] hash_code MojoStringHash64() of the string.
+   */
+  constexpr MojoStaticId( const char* c_string, uint64_t hash_code )
+  : m_CString( c_string )
+  , m_HashValue( hash_code )
+  {}
+
+  /**
+   Get the string.
+   \return The string literal.
+   */
+  constexpr const char* AsCString() const { return m_CString; }
+
+  /**
+   Get the hash code. The same as MojoId::AsUint64() of a MojoId made from the same string.
+   \return The hash code.
+   */
+  constexpr uint64_t AsUint64() const { return m_HashValue; }
+
+private:
+  const char* m_CString;
+  uint64_t    m_HashValue;
+};
+
+/**
+ \ingroup group_id
+ Make a MojoStaticId from a string literal, as in <tt>"Transform"_id</tt>.
+ */
+constexpr MojoStaticId operator"" _id( const char* c_string, size_t )
+{
+  return MojoStaticId( c_string );
+}
 
 /**
  \class MojoId
@@ -39,6 +105,11 @@
  A MojoId is a string-like identifier. A MojoId is stored as a 64-bit integer, and backed by a reference counted string
  dictionary. A MojoId very suitable for indexing a hash table.
 
+ MojoIds may be created, copied and destroyed on any thread. See MojoIdManager.
+
+ If MOJO_ID_REFCOUNT is defined as 0, MojoId is trivially copyable, and strings are reclaimed in bulk by
+ MojoIdManager::Sweep() instead of by reference counting. Use Mark() to keep the strings of ids that are still in use.
+
  MojoId is used throughout MojoLib for several purposes.
 
  A MojoId object can be implicitly constructed from a C-string. Therefore, whenever an API calls for a MojoId
@@ -61,11 +132,13 @@ public:
    Default constructor initializes MojoId to Null.
    */
   MojoId();
+#if MOJO_ID_REFCOUNT
   /**
    Copy constructor. Needed to update internal reference counting.
    \param[in] other The other MojoId to copy.
    */
   MojoId( const MojoId& other );
+#endif
   /**
    Construct from C-string.
    \param[in] c_string The C-string to store.
@@ -73,12 +146,27 @@ public:
    fine.
    */
   MojoId( const char* c_string );
+  /**
+   Construct from a string that is given by pointer and length, and need not be NUL-terminated.
+   \param[in] chars First character of the string.
+   \param[in] length Number of characters. A length of 0 gives a Null MojoId.
+   \note The characters are *copied* into the dictionary (unless they are already there), so tokens that point into a
+   larger buffer are fine.
+   */
+  MojoId( const char* chars, int length );
+  /**
+   Construct from a MojoStaticId. The hash code is already known, so the string is not hashed again.
+   \param[in] static_id The MojoStaticId to store.
+   */
+  MojoId( const MojoStaticId& static_id );
+#if MOJO_ID_REFCOUNT
   /**
    Assignment operator. Needed to update internal reference counting.
    \param[in] other The other MojoId to copy.
    \return Standard `*this` for this type of operator.
    */
   MojoId& operator= ( const MojoId& other );
+#endif
   /**
    Assignment from a C-string.
    \param[in] c_string The C-string to store.
@@ -87,6 +175,20 @@ public:
    fine.
    */
   MojoId& operator= ( const char* c_string );
+  /**
+   Assign from a C-string, and report whether that worked.
+   \param[in] c_string The C-string to store.
+   \return Status code. kMojoStatus_HashCollision if a different string with the same hash code is already in the
+   dictionary. The MojoId is Null if the status is not kMojoStatus_Ok.
+   */
+  MojoStatus Set( const char* c_string );
+  /**
+   Assign from a string that is given by pointer and length, and report whether that worked.
+   \param[in] chars First character of the string. Need not be NUL-terminated.
+   \param[in] length Number of characters. A length of 0 makes the MojoId Null.
+   \return Status code, as for Set( const char* ).
+   */
+  MojoStatus Set( const char* chars, int length );
   /**
    Test equality.
    \param[in] other Other MojoId to compare
@@ -100,6 +202,12 @@ public:
    \return true if equal.
    */
   bool operator== ( const char* c_string ) const;
+  /**
+   Test equality. Does not hash anything at run time.
+   \param[in] static_id MojoStaticId to compare
+   \return true if equal.
+   */
+  bool operator== ( const MojoStaticId& static_id ) const;
   /**
    Test inequality.
    \param[in] other Other MojoId to compare
@@ -112,6 +220,12 @@ public:
    \return true if different.
    */
   bool operator!= ( const char* c_string ) const;
+  /**
+   Test inequality. Does not hash anything at run time.
+   \param[in] static_id MojoStaticId to compare
+   \return true if different.
+   */
+  bool operator!= ( const MojoStaticId& static_id ) const;
   /**
    Test Null. A MojoId is considered Null if:
    - it has been constructed with the default constructor, and never assigned;
@@ -125,7 +239,14 @@ public:
    */
   void SetNull();
 
+#if MOJO_ID_REFCOUNT
   ~MojoId();
+#endif
+
+  /**
+   Stamp the string of this id with the current epoch, so that MojoIdManager::Sweep() keeps it.
+   */
+  void Mark() const;
 
   /**
    Convert to C-string.
@@ -133,7 +254,7 @@ public:
    */
   const char* AsCString() const;
   /**
-   Convert to 64-bit integer. This is the MojoFnv64() of the string this id this MojoId is currently associated with.
+   Convert to 64-bit integer. This is the MojoStringHash64() of the string this MojoId is currently associated with.
    \return The internal hash code.
    */
   uint64_t AsUint64() const;
@@ -146,6 +267,16 @@ public:
    */
   static const char* FindCString( uint64_t hash_code );
 
+  /**
+   Assign many strings at once. All strings are hashed before the dictionary is touched, each dictionary table is grown
+   at most once, and each lock is taken once for the whole batch.
+   \param[in] strings Strings to intern, by pointer and length.
+   \param[in] count Number of strings.
+   \param[out] ids Array of `count` MojoIds to assign. An id whose string could not be interned becomes Null.
+   \return Status code. The first error that occurred, or kMojoStatus_Ok.
+   */
+  static MojoStatus InternMany( const MojoStringView* strings, int count, MojoId* ids );
+
   /**
    A MojoId that is Null. This is essentially the same as MojoId(), the default constructor.
    \return A Null MojoId.
@@ -184,6 +315,67 @@ public:
 private:
   uint64_t  m_HashValue;
   static const MojoId s_Null;
+
+  friend class MojoIdManager;
+  friend class MojoIndexId;
+};
+
+/**
+ \class MojoIndexId
+ \ingroup group_id
+ A dense, 32-bit companion to MojoId. The id manager numbers strings sequentially from 1, the first time a MojoIndexId
+ is made from them, so a MojoIndexId can index a flat array or a bitmap directly, instead of being looked up in a hash
+ table. MojoIdManager::GetIndexIdLimit() gives the size such an array needs.
+ \code
+ MojoIndexId index( id );
+ bool is_visible = visible_bits[ index.AsUint32() / 32 ] & ( 1u << ( index.AsUint32() % 32 ) );
+ \endcode
+ A MojoIndexId is a plain value. It does not keep its string in the dictionary, so it is only valid as long as a MojoId
+ of the same string is. After the string is removed, its index may be given to another string.
+ */
+class MojoIndexId
+{
+public:
+  /**
+   Default constructor initializes MojoIndexId to Null.
+   */
+  MojoIndexId() : m_Index( 0 ) {}
+  /**
+   Construct from a MojoId. Assigns the string an index if it does not have one yet.
+   \param[in] id The MojoId.
+   \note The index is 0 (Null) if the id is Null, or if memory for the index table could not be allocated.
+   */
+  explicit MojoIndexId( const MojoId& id );
+  /**
+   Convert to MojoId.
+   \return The MojoId of the same string, or a Null MojoId if this is Null.
+   */
+  MojoId AsId() const;
+  /**
+   Get the dense index.
+   \return Index. 0 if Null, and less than MojoIdManager::GetIndexIdLimit() otherwise.
+   */
+  uint32_t AsUint32() const { return m_Index; }
+  /**
+   Test Null.
+   \return true if Null.
+   */
+  bool IsNull() const { return !m_Index; }
+  /**
+   Test equality.
+   \param[in] other Other MojoIndexId to compare
+   \return true if equal.
+   */
+  bool operator== ( const MojoIndexId& other ) const { return m_Index == other.m_Index; }
+  /**
+   Test inequality.
+   \param[in] other Other MojoIndexId to compare
+   \return true if different.
+   */
+  bool operator!= ( const MojoIndexId& other ) const { return m_Index != other.m_Index; }
+
+private:
+  uint32_t  m_Index;
 };
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -215,10 +407,20 @@ inline bool MojoId::operator== ( const MojoId& other ) const
   return m_HashValue == other.m_HashValue;
 }
 
+inline bool MojoId::operator!= ( const MojoStaticId& static_id ) const
+{
+  return m_HashValue != static_id.AsUint64();
+}
+
+inline bool MojoId::operator== ( const MojoStaticId& static_id ) const
+{
+  return m_HashValue == static_id.AsUint64();
+}
+
 inline bool MojoId::operator== ( const char* c_string ) const
 {
   if( c_string )
-    return m_HashValue == MojoFnv64( c_string );
+    return m_HashValue == MojoStringHash64( c_string );
   else
     return IsNull();
 }
@@ -228,8 +430,10 @@ inline uint64_t MojoId::AsUint64() const
   return m_HashValue;
 }
 
+#if MOJO_ID_REFCOUNT
 // destructor
 inline MojoId::~MojoId()
 {
   SetNull();
 }
+#endif
@@ -26,16 +26,79 @@
 // -- Self
 #include "MojoIdManager.h"
 
+// -- Standard Libs
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#if defined( _WIN32 )
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 // -- Mojo
-#include "MojoMap.h"
 #include "MojoUtil.h"
 #include "MojoConfig.h"
+#include "MojoId.h"
 
 MojoIdManager g_MojoIdManager;
 
+static const char kSnapshotMagic[ 8 ] = { 'M', 'o', 'j', 'o', 'I', 'd', 's', 0 };
+static const uint32_t kSnapshotVersion = 1;
+static const uint32_t kDenseTableMin = 1024;
+
 MojoIdManager::MojoIdManager()
-: m_Status( kMojoStatus_NotInitialized )
-{}
+: m_Snapshot( NULL )
+, m_SnapshotSize( 0 )
+, m_IndexStatus( kMojoStatus_Ok )
+, m_DenseFree( NULL )
+, m_DenseFreeCount( 0 )
+, m_DenseFreeCapacity( 0 )
+, m_DenseLiveCount( 0 )
+, m_HotCount( 0 )
+, m_Alloc( NULL )
+, m_Status( kMojoStatus_NotInitialized )
+{
+  m_Epoch.store( 1 );
+  m_CollisionCount.store( 0 );
+  m_Indexed.store( false );
+  m_IndexChangeCount.store( 0 );
+  m_Index.m_Entries = NULL;
+  m_Index.m_Count = 0;
+  m_Index.m_Capacity = 0;
+  m_IndexLog = m_Index;
+  m_DenseTable.store( NULL );
+  m_DenseCount.store( 1 );
+  m_SnapshotDense.store( NULL );
+  m_HotSampleRate.store( 0 );
+  m_ReclaimBatch.store( 0 );
+  for( int i = 0; i < kMojoIdManagerShardCount; ++i )
+  {
+    m_Shards[ i ].m_Table.store( NULL );
+    m_Shards[ i ].m_Count.store( 0 );
+    m_Shards[ i ].m_Blocks = NULL;
+    m_Shards[ i ].m_CurrentBlock = NULL;
+    m_Shards[ i ].m_SpareBlock = NULL;
+    m_Shards[ i ].m_StringBytes = 0;
+    m_Shards[ i ].m_InsertCount = 0;
+    m_Shards[ i ].m_NewCount = 0;
+    m_Shards[ i ].m_FreeCount = 0;
+    m_Shards[ i ].m_ReviveCount = 0;
+    m_Shards[ i ].m_Retired = NULL;
+    m_Shards[ i ].m_RetiredCount = 0;
+    m_Shards[ i ].m_RetiredCapacity = 0;
+    m_Shards[ i ].m_RetiredOlderCount = 0;
+    m_Shards[ i ].m_RetiredBatch = 1;
+#if MOJO_ID_STATS
+    m_Shards[ i ].m_IncRefCount.store( 0 );
+    m_Shards[ i ].m_DecRefCount.store( 0 );
+#endif
+  }
+}
 
 void MojoIdManager::Create( const MojoConfig* config, MojoAlloc* alloc )
 {
@@ -48,73 +111,1613 @@ void MojoIdManager::Create( const MojoConfig* config, MojoAlloc* alloc )
     alloc = MojoAlloc::GetDefault();
   }
 
+  // Shard tables are allocated when the first string goes in
+  m_Config = *config;
   m_Alloc = alloc;
-  m_HashMap.Create( "MojoIdManager", Entry(), config );
   m_Status = kMojoStatus_Ok;
 }
 
 void MojoIdManager::Destroy()
 {
-  m_HashMap.Destroy();
+  DestroyIndex();
+  for( int i = 0; i < kMojoIdManagerShardCount; ++i )
+  {
+    FreeBlocks( m_Shards[ i ] );
+    FreeRetired( m_Shards[ i ] );
+    FreeTables( m_Shards[ i ].m_Table.load() );
+    m_Shards[ i ].m_Table.store( NULL );
+    m_Shards[ i ].m_Count.store( 0 );
+    m_Shards[ i ].m_StringBytes = 0;
+  }
+  FreeDense();
+  UnmapSnapshot();
+  ResetCounters();
   m_Status = kMojoStatus_NotInitialized;
 }
 
-uint64_t MojoIdManager::Insert( const char* c_string )
+int MojoIdManager::GetCount() const
 {
-  uint64_t hash_code = MojoFnv64( c_string );
-  if( hash_code && !m_Status )
+  int count = 0;
+  for( int i = 0; i < kMojoIdManagerShardCount; ++i )
+  {
+    count += m_Shards[ i ].m_Count.load( std::memory_order_relaxed );
+  }
+  return count + ( m_Snapshot ? ( int )m_Snapshot->m_Count : 0 );
+}
+
+MojoStatus MojoIdManager::SaveSnapshot( const char* path ) const
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  
+  // Gather the strings first, so the index can be sized. The lists are only touched under the shard locks.
+  int count = GetCount();
+  int slot_count = 16;
+  while( slot_count < count * 2 )
+  {
+    slot_count *= 2;
+  }
+  SnapshotSlot* slots = ( SnapshotSlot* )m_Alloc->Allocate( slot_count * sizeof( SnapshotSlot ), "MojoId snapshot" );
+  if( !slots )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+  memset( slots, 0, slot_count * sizeof( SnapshotSlot ) );
+  
+  // Write to a temporary file, and rename it when complete. The file at path may be the one that is mapped right now.
+  size_t path_length = strlen( path );
+  char* temp_path = ( char* )m_Alloc->Allocate( path_length + 5, "MojoId snapshot" );
+  if( !temp_path )
+  {
+    m_Alloc->Free( slots );
+    return kMojoStatus_CouldNotAlloc;
+  }
+  memcpy( temp_path, path, path_length );
+  memcpy( temp_path + path_length, ".tmp", 5 );
+  FILE* file = fopen( temp_path, "wb" );
+  if( !file )
+  {
+    m_Alloc->Free( temp_path );
+    m_Alloc->Free( slots );
+    return kMojoStatus_InvalidFile;
+  }
+  
+  // Strings are written right away, after room for the header and the slots. The index is written last.
+  uint64_t strings_size = 0;
+  int written_count = 0;
+  bool ok = fseek( file, ( long )( sizeof( SnapshotHeader ) + slot_count * sizeof( SnapshotSlot ) ), SEEK_SET ) == 0;
+  int mask = slot_count - 1;
+  for( int i = -1; i < kMojoIdManagerShardCount && ok; ++i )
   {
-    Entry entry = m_HashMap.Find( hash_code );
-    if( !entry.m_CString )
+    // i == -1 is the snapshot that is already loaded, if any
+    std::unique_lock< std::mutex > lock;
+    const Table* table = NULL;
+    int capacity = 0;
+    if( i < 0 )
+    {
+      capacity = m_Snapshot ? m_Snapshot->m_SlotCount : 0;
+    }
+    else
+    {
+      lock = std::unique_lock< std::mutex >( const_cast< Shard& >( m_Shards[ i ] ).m_Lock );
+      table = m_Shards[ i ].m_Table.load( std::memory_order_relaxed );
+      capacity = table ? table->m_Capacity : 0;
+    }
+    for( int j = 0; j < capacity && ok; ++j )
     {
+      uint64_t hash_code = 0;
+      const char* c_string = NULL;
+      if( i < 0 )
+      {
+        const SnapshotSlot* snapshot_slots = ( const SnapshotSlot* )( m_Snapshot + 1 );
+        hash_code = snapshot_slots[ j ].m_Hash;
+        c_string = ( const char* )( snapshot_slots + m_Snapshot->m_SlotCount ) + snapshot_slots[ j ].m_Offset;
+      }
+      else
+      {
+        Entry* entry = table->m_Slots[ j ].m_Entry.load( std::memory_order_relaxed );
+        hash_code = entry ? table->m_Slots[ j ].m_Hash.load( std::memory_order_relaxed ) : 0;
+        c_string = entry ? entry->m_CString : NULL;
+      }
+      if( !hash_code || written_count == count )
+      {
+        continue;
+      }
+      
       size_t length = strlen( c_string );
-      char* string_mem = ( char * )m_Alloc->Allocate( length + 1, "MojoId string" );
-      memcpy( string_mem, c_string, length );
-      string_mem[ length ] = 0;
-      entry.m_RefCount = 0;
-      entry.m_CString = string_mem;
-      m_HashMap.Insert( hash_code, entry );
+      int k = ( int )( hash_code & mask );
+      while( slots[ k ].m_Hash )
+      {
+        k = ( k + 1 ) & mask;
+      }
+      slots[ k ].m_Hash = hash_code;
+      slots[ k ].m_Offset = ( uint32_t )strings_size;
+      slots[ k ].m_Length = ( uint32_t )length;
+      ok = fwrite( c_string, 1, length + 1, file ) == length + 1 && strings_size + length + 1 < 0xFFFFFFFFull;
+      strings_size += length + 1;
+      written_count += 1;
+    }
+  }
+  
+  SnapshotHeader header;
+  memcpy( header.m_Magic, kSnapshotMagic, sizeof( header.m_Magic ) );
+  header.m_Version = kSnapshotVersion;
+  header.m_HashFunction = MOJO_WIDE_STRING_HASH;
+  header.m_Count = written_count;
+  header.m_SlotCount = slot_count;
+  header.m_StringsSize = strings_size;
+  ok = ok && fseek( file, 0, SEEK_SET ) == 0;
+  ok = ok && fwrite( &header, sizeof( header ), 1, file ) == 1;
+  ok = ok && fwrite( slots, sizeof( SnapshotSlot ), slot_count, file ) == ( size_t )slot_count;
+  ok = ( fclose( file ) == 0 ) && ok;
+#if defined( _WIN32 )
+  ok = ok && MoveFileExA( temp_path, path, MOVEFILE_REPLACE_EXISTING );
+#else
+  ok = ok && rename( temp_path, path ) == 0;
+#endif
+  if( !ok )
+  {
+    remove( temp_path );
+  }
+  m_Alloc->Free( temp_path );
+  m_Alloc->Free( slots );
+  return ok ? kMojoStatus_Ok : kMojoStatus_InvalidFile;
+}
+
+MojoStatus MojoIdManager::LoadSnapshot( const char* path )
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  if( m_Snapshot || GetCount() )
+  {
+    return kMojoStatus_InvalidArguments;
+  }
+  
+  const void* data = NULL;
+  size_t size = 0;
+#if defined( _WIN32 )
+  HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+  if( file != INVALID_HANDLE_VALUE )
+  {
+    LARGE_INTEGER file_size;
+    HANDLE mapping = NULL;
+    if( GetFileSizeEx( file, &file_size ) && file_size.QuadPart > 0 )
+    {
+      mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+    }
+    if( mapping )
+    {
+      data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+      size = ( size_t )file_size.QuadPart;
+      CloseHandle( mapping );
+    }
+    CloseHandle( file );
+  }
+#else
+  int file = open( path, O_RDONLY );
+  if( file >= 0 )
+  {
+    struct stat file_stat;
+    if( fstat( file, &file_stat ) == 0 && file_stat.st_size > 0 )
+    {
+      data = mmap( NULL, ( size_t )file_stat.st_size, PROT_READ, MAP_SHARED, file, 0 );
+      if( data == MAP_FAILED )
+      {
+        data = NULL;
+      }
+      size = ( size_t )file_stat.st_size;
+    }
+    close( file );
+  }
+#endif
+  if( !data )
+  {
+    return kMojoStatus_InvalidFile;
+  }
+  m_Snapshot = ( const SnapshotHeader* )data;
+  m_SnapshotSize = size;
+  
+  // Validate everything that lookups rely on, so that a damaged file can not send them out of bounds
+  const SnapshotHeader* header = m_Snapshot;
+  bool ok = size >= sizeof( SnapshotHeader ) &&
+            memcmp( header->m_Magic, kSnapshotMagic, sizeof( kSnapshotMagic ) ) == 0 &&
+            header->m_Version == kSnapshotVersion &&
+            header->m_HashFunction == MOJO_WIDE_STRING_HASH &&
+            header->m_SlotCount && ( header->m_SlotCount & ( header->m_SlotCount - 1 ) ) == 0 &&
+            header->m_Count < header->m_SlotCount &&
+            size == sizeof( SnapshotHeader ) + header->m_SlotCount * sizeof( SnapshotSlot ) + header->m_StringsSize;
+  if( ok )
+  {
+    const SnapshotSlot* slots = ( const SnapshotSlot* )( header + 1 );
+    const char* strings = ( const char* )( slots + header->m_SlotCount );
+    uint32_t used_count = 0;
+    for( uint32_t i = 0; i < header->m_SlotCount && ok; ++i )
+    {
+      used_count += slots[ i ].m_Hash ? 1 : 0;
+      ok = !slots[ i ].m_Hash ||
+           ( ( uint64_t )slots[ i ].m_Offset + slots[ i ].m_Length < header->m_StringsSize &&
+             strings[ slots[ i ].m_Offset + slots[ i ].m_Length ] == 0 );
+    }
+    // Lookups stop at an empty slot. With the count checked above, this leaves at least one.
+    ok = ok && used_count == header->m_Count;
+  }
+  if( !ok )
+  {
+    UnmapSnapshot();
+    return kMojoStatus_InvalidFile;
+  }
+  return kMojoStatus_Ok;
+}
+
+uint64_t MojoIdManager::Insert( const char* c_string )
+{
+  int length = c_string ? ( int )strlen( c_string ) : 0;
+  return Insert( c_string, length, MojoStringHash64( c_string ) );
+}
+
+uint64_t MojoIdManager::Insert( const char* chars, int length, uint64_t hash_code, MojoStatus* status )
+{
+  MojoStatus dummy_status;
+  status = status ? status : &dummy_status;
+  *status = m_Status;
+  if( !hash_code || m_Status )
+  {
+    return 0;
+  }
+  if( FindInSnapshot( chars, length, hash_code, status ) )
+  {
+    return *status ? 0 : hash_code;
+  }
+  Shard& shard = GetShard( hash_code );
+  std::lock_guard< std::mutex > lock( shard.m_Lock );
+  return InsertLocked( shard, chars, length, hash_code, status );
+}
+
+static void HashStrings( const MojoStringView* strings, int count, uint64_t* hash_codes )
+{
+  // Four at a time, so that the hash chains of neighboring strings overlap
+  int i = 0;
+  for( ; i + 4 <= count; i += 4 )
+  {
+    const char* chars[ 4 ] = { strings[ i ].m_Chars, strings[ i + 1 ].m_Chars, strings[ i + 2 ].m_Chars,
+                               strings[ i + 3 ].m_Chars };
+    int lengths[ 4 ] = { strings[ i ].m_Length, strings[ i + 1 ].m_Length, strings[ i + 2 ].m_Length,
+                         strings[ i + 3 ].m_Length };
+    MojoStringHash64x4( chars, lengths, hash_codes + i );
+    for( int k = 0; k < 4; ++k )
+    {
+      hash_codes[ i + k ] = lengths[ k ] > 0 ? hash_codes[ i + k ] : 0;
+    }
+  }
+  for( ; i < count; ++i )
+  {
+    hash_codes[ i ] = strings[ i ].m_Length > 0 ? MojoStringHash64( strings[ i ].m_Chars, strings[ i ].m_Length ) : 0;
+  }
+}
+
+MojoStatus MojoIdManager::InsertMany( const MojoStringView* strings, int count, uint64_t* hash_codes )
+{
+  if( m_Status )
+  {
+    memset( hash_codes, 0, count * sizeof( uint64_t ) );
+    return m_Status;
+  }
+  
+  if( count <= 0 )
+  {
+    return kMojoStatus_Ok;
+  }
+  
+  // Hash everything before taking any lock
+  HashStrings( strings, count, hash_codes );
+  
+  // Count per shard, so that each table grows at most once
+  MojoStatus status = kMojoStatus_Ok;
+  int shard_counts[ kMojoIdManagerShardCount ] = { 0 };
+  for( int i = 0; i < count; ++i )
+  {
+    shard_counts[ GetShardIndex( hash_codes[ i ] ) ] += hash_codes[ i ] ? 1 : 0;
+  }
+  
+  // Sort the strings by shard in one pass, so that each shard only visits its own
+  int* order = ( int* )m_Alloc->Allocate( count * sizeof( int ), "MojoIdManager" );
+  if( !order )
+  {
+    memset( hash_codes, 0, count * sizeof( uint64_t ) );
+    return kMojoStatus_CouldNotAlloc;
+  }
+  int shard_starts[ kMojoIdManagerShardCount + 1 ];
+  int shard_ends[ kMojoIdManagerShardCount ];
+  shard_starts[ 0 ] = 0;
+  for( int s = 0; s < kMojoIdManagerShardCount; ++s )
+  {
+    shard_starts[ s + 1 ] = shard_starts[ s ] + shard_counts[ s ];
+    shard_ends[ s ] = shard_starts[ s ];
+  }
+  for( int i = 0; i < count; ++i )
+  {
+    if( hash_codes[ i ] )
+    {
+      order[ shard_ends[ GetShardIndex( hash_codes[ i ] ) ]++ ] = i;
+    }
+  }
+  
+  // One lock per shard for the whole batch
+  for( int s = 0; s < kMojoIdManagerShardCount; ++s )
+  {
+    if( !shard_counts[ s ] )
+    {
+      continue;
+    }
+    Shard& shard = m_Shards[ s ];
+    std::lock_guard< std::mutex > lock( shard.m_Lock );
+    Table* table = shard.m_Table.load( std::memory_order_relaxed );
+    if( !table )
+    {
+      // If this fails, InsertLocked() tries again with the minimum size and reports the status
+      table = NewTable( GetTableCapacity( 1, shard_counts[ s ] ) );
+      shard.m_Table.store( table, std::memory_order_release );
+    }
+    else if( IsTableFull( table, shard_counts[ s ] ) )
+    {
+      Grow( shard, shard_counts[ s ] );
+    }
+    for( int j = shard_starts[ s ]; j < shard_starts[ s + 1 ]; ++j )
+    {
+      int i = order[ j ];
+      MojoStatus string_status;
+      if( FindInSnapshot( strings[ i ].m_Chars, strings[ i ].m_Length, hash_codes[ i ], &string_status ) )
+      {
+        hash_codes[ i ] = string_status ? 0 : hash_codes[ i ];
+      }
+      else
+      {
+        hash_codes[ i ] = InsertLocked( shard, strings[ i ].m_Chars, strings[ i ].m_Length, hash_codes[ i ],
+                                        &string_status );
+      }
+      status = string_status ? string_status : status;
+    }
+  }
+  m_Alloc->FreeSized( order, count * sizeof( int ) );
+  return status;
+}
+
+uint64_t MojoIdManager::InsertLocked( Shard& shard, const char* chars, int length, uint64_t hash_code,
+                                      MojoStatus* status )
+{
+  *status = kMojoStatus_Ok;
+  shard.m_InsertCount += 1;
+  Table* table = shard.m_Table.load( std::memory_order_relaxed );
+  if( !table )
+  {
+    table = NewTable( GetTableCapacity( 1, 0 ) );
+    if( !table )
+    {
+      *status = kMojoStatus_CouldNotAlloc;
+      return 0;
+    }
+    shard.m_Table.store( table, std::memory_order_release );
+  }
+  Slot* slot = FindSlot( table, hash_code );
+  Entry* entry = slot->m_Entry.load( std::memory_order_relaxed );
+  if( entry )
+  {
+    // Two strings with one hash code would be one id. Refuse the second string rather than alias it.
+    if( strncmp( entry->m_CString, chars, length ) != 0 || entry->m_CString[ length ] != 0 )
+    {
+      m_CollisionCount.fetch_add( 1, std::memory_order_relaxed );
+      *status = kMojoStatus_HashCollision;
+      return 0;
     }
-    IncRefCount( hash_code );
+#if MOJO_ID_REFCOUNT
+    // This may revive an entry whose count dropped to zero. DecRefCount() and reclaiming check again under the lock.
+    if( entry->m_RefCount.fetch_add( 1, std::memory_order_relaxed ) == 0 )
+    {
+      shard.m_ReviveCount += 1;
+    }
+#endif
+    entry->m_Epoch.store( GetEpoch(), std::memory_order_relaxed );
+    return hash_code;
+  }
+
+  bool is_new_slot = slot->m_Hash.load( std::memory_order_relaxed ) == 0;
+  if( is_new_slot && IsTableFull( table, 1 ) )
+  {
+    // Keep using the current table if there is no memory for a bigger one, as long as there is room at all
+    if( Grow( shard, 1 ) )
+    {
+      table = shard.m_Table.load( std::memory_order_relaxed );
+      slot = FindSlot( table, hash_code );
+      is_new_slot = slot->m_Hash.load( std::memory_order_relaxed ) == 0;
+    }
+    else if( table->m_UsedCount + 1 >= table->m_Capacity )
+    {
+      *status = kMojoStatus_CouldNotAlloc;
+      return 0;
+    }
+  }
+
+  entry = NewEntry( shard, chars, length );
+  if( !entry )
+  {
+    *status = kMojoStatus_CouldNotAlloc;
+    return 0;
   }
+  // The entry is complete before the slot points at it. Lookups that find the hash code see all of it.
+  slot->m_Entry.store( entry, std::memory_order_release );
+  if( is_new_slot )
+  {
+    slot->m_Hash.store( hash_code, std::memory_order_release );
+    table->m_UsedCount += 1;
+  }
+  shard.m_Count.fetch_add( 1, std::memory_order_relaxed );
+  shard.m_NewCount += 1;
+  shard.m_StringBytes += length + 1;
+  LogIndex( hash_code, entry->m_CString );
   return hash_code;
 }
 
+bool MojoIdManager::FindInSnapshot( const char* chars, int length, uint64_t hash_code, MojoStatus* status )
+{
+  // Strings in the snapshot are permanent. No lock and no reference count needed.
+  *status = kMojoStatus_Ok;
+  const char* snapshot_string = FindInSnapshot( hash_code );
+  if( !snapshot_string )
+  {
+    return false;
+  }
+  if( strncmp( snapshot_string, chars, length ) != 0 || snapshot_string[ length ] != 0 )
+  {
+    m_CollisionCount.fetch_add( 1, std::memory_order_relaxed );
+    *status = kMojoStatus_HashCollision;
+  }
+  return true;
+}
+
 void MojoIdManager::DecRefCount( uint64_t hash_code )
 {
+#if MOJO_ID_REFCOUNT
   if( hash_code && !m_Status )
   {
-    Entry* entry_ptr = m_HashMap.FindForImmediateChange( hash_code );
-    if( entry_ptr )
+    Shard& shard = GetShard( hash_code );
+#if MOJO_ID_STATS
+    shard.m_DecRefCount.fetch_add( 1, std::memory_order_relaxed );
+#endif
+    Entry* entry = FindEntry( shard, hash_code );
+    if( entry && entry->m_RefCount.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
     {
-      entry_ptr->m_RefCount -= 1;
-      if( entry_ptr->m_RefCount == 0 )
+      // Insert() may have revived the entry, or another thread may have removed it already, since the count dropped
+      std::lock_guard< std::mutex > lock( shard.m_Lock );
+      Slot* slot = FindSlot( shard.m_Table.load( std::memory_order_relaxed ), hash_code );
+      if( slot->m_Entry.load( std::memory_order_relaxed ) == entry &&
+          entry->m_RefCount.load( std::memory_order_acquire ) == 0 )
       {
-        m_Alloc->Free( ( void* )entry_ptr->m_CString );
-        m_HashMap.Remove( hash_code );
+        if( m_ReclaimBatch.load( std::memory_order_relaxed ) > 0 )
+        {
+          RetireEntry( shard, slot, entry );
+        }
+        else
+        {
+          RemoveEntry( shard, slot, entry );
+        }
       }
     }
   }
+#else
+  ( void )hash_code;
+#endif
 }
 
 void MojoIdManager::IncRefCount( uint64_t hash_code )
+{
+#if MOJO_ID_REFCOUNT
+  if( hash_code && !m_Status )
+  {
+    // The caller holds a reference, so the entry can not go away
+    Shard& shard = GetShard( hash_code );
+#if MOJO_ID_STATS
+    shard.m_IncRefCount.fetch_add( 1, std::memory_order_relaxed );
+#endif
+    Entry* entry = FindEntry( shard, hash_code );
+    if( entry )
+    {
+      entry->m_RefCount.fetch_add( 1, std::memory_order_relaxed );
+    }
+  }
+#else
+  ( void )hash_code;
+#endif
+}
+
+uint32_t MojoIdManager::AdvanceEpoch()
+{
+  return m_Epoch.fetch_add( 1, std::memory_order_relaxed ) + 1;
+}
+
+void MojoIdManager::Mark( uint64_t hash_code )
 {
   if( hash_code && !m_Status )
   {
-    Entry* entry_ptr = m_HashMap.FindForImmediateChange( hash_code );
-    if( entry_ptr )
+    Entry* entry = FindEntry( GetShard( hash_code ), hash_code );
+    if( entry )
     {
-      entry_ptr->m_RefCount += 1;
+      entry->m_Epoch.store( GetEpoch(), std::memory_order_relaxed );
     }
   }
 }
 
+int MojoIdManager::Sweep( uint32_t epoch )
+{
+  int removed_count = 0;
+  for( int i = 0; i < kMojoIdManagerShardCount && !m_Status; ++i )
+  {
+    Shard& shard = m_Shards[ i ];
+    std::lock_guard< std::mutex > lock( shard.m_Lock );
+    Table* table = shard.m_Table.load( std::memory_order_relaxed );
+    for( int j = 0; table && j < table->m_Capacity; ++j )
+    {
+      Slot* slot = &table->m_Slots[ j ];
+      Entry* entry = slot->m_Entry.load( std::memory_order_relaxed );
+      // Epochs wrap around, so compare the difference
+      if( entry && entry->m_RefCount.load( std::memory_order_acquire ) == 0 &&
+          ( int32_t )( entry->m_Epoch.load( std::memory_order_relaxed ) - epoch ) < 0 )
+      {
+        RemoveEntry( shard, slot, entry );
+        removed_count += 1;
+      }
+    }
+  }
+  return removed_count;
+}
+
 const char* MojoIdManager::Find( uint64_t hash_code ) const
 {
   if( hash_code && !m_Status )
   {
-    Entry entry = m_HashMap.Find( hash_code );
-    return entry.m_CString;
+    const char* snapshot_string = FindInSnapshot( hash_code );
+    if( snapshot_string )
+    {
+      return snapshot_string;
+    }
+    Entry* entry = FindEntry( GetShard( hash_code ), hash_code );
+    return entry ? entry->m_CString : NULL;
+  }
+  return NULL;
+}
+
+const char* MojoIdManager::FindInSnapshot( uint64_t hash_code ) const
+{
+  int i = FindSnapshotSlot( hash_code );
+  if( i >= 0 )
+  {
+    const SnapshotSlot* slots = ( const SnapshotSlot* )( m_Snapshot + 1 );
+    return ( const char* )( slots + m_Snapshot->m_SlotCount ) + slots[ i ].m_Offset;
   }
   return NULL;
 }
+
+int MojoIdManager::FindSnapshotSlot( uint64_t hash_code ) const
+{
+  if( m_Snapshot )
+  {
+    const SnapshotSlot* slots = ( const SnapshotSlot* )( m_Snapshot + 1 );
+    uint32_t mask = m_Snapshot->m_SlotCount - 1;
+    for( uint32_t i = ( uint32_t )hash_code & mask; slots[ i ].m_Hash; i = ( i + 1 ) & mask )
+    {
+      if( slots[ i ].m_Hash == hash_code )
+      {
+        return ( int )i;
+      }
+    }
+  }
+  return -1;
+}
+
+void MojoIdManager::UnmapSnapshot()
+{
+  if( m_Snapshot )
+  {
+#if defined( _WIN32 )
+    UnmapViewOfFile( m_Snapshot );
+#else
+    munmap( ( void* )m_Snapshot, m_SnapshotSize );
+#endif
+  }
+  m_Snapshot = NULL;
+  m_SnapshotSize = 0;
+}
+
+MojoStatus MojoIdManager::CreateIndex()
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  {
+    std::lock_guard< std::mutex > index_lock( m_IndexLock );
+    if( m_Indexed.load( std::memory_order_relaxed ) )
+    {
+      return kMojoStatus_DoubleInitialized;
+    }
+    // From here on, strings are logged as they come and go
+    m_Indexed.store( true, std::memory_order_relaxed );
+    m_IndexStatus = kMojoStatus_Ok;
+    const SnapshotSlot* snapshot_slots = ( const SnapshotSlot* )( m_Snapshot + 1 );
+    for( uint32_t i = 0; m_Snapshot && i < m_Snapshot->m_SlotCount; ++i )
+    {
+      if( snapshot_slots[ i ].m_Hash )
+      {
+        AppendIndexLog( snapshot_slots[ i ].m_Hash,
+                        ( const char* )( snapshot_slots + m_Snapshot->m_SlotCount ) + snapshot_slots[ i ].m_Offset );
+      }
+    }
+  }
+  
+  // Strings that were added before a shard is scanned are found by the scan, and later ones are logged
+  for( int i = 0; i < kMojoIdManagerShardCount; ++i )
+  {
+    std::lock_guard< std::mutex > lock( m_Shards[ i ].m_Lock );
+    std::lock_guard< std::mutex > index_lock( m_IndexLock );
+    Table* table = m_Shards[ i ].m_Table.load( std::memory_order_relaxed );
+    for( int j = 0; table && j < table->m_Capacity; ++j )
+    {
+      Entry* entry = table->m_Slots[ j ].m_Entry.load( std::memory_order_relaxed );
+      if( entry )
+      {
+        AppendIndexLog( table->m_Slots[ j ].m_Hash.load( std::memory_order_relaxed ), entry->m_CString );
+      }
+    }
+  }
+  
+  std::lock_guard< std::mutex > index_lock( m_IndexLock );
+  return UpdateIndex();
+}
+
+void MojoIdManager::DestroyIndex()
+{
+  std::lock_guard< std::mutex > index_lock( m_IndexLock );
+  m_Indexed.store( false, std::memory_order_relaxed );
+  if( m_Index.m_Entries )
+  {
+    m_Alloc->FreeSized( m_Index.m_Entries, m_Index.m_Capacity * sizeof( IndexEntry ) );
+  }
+  if( m_IndexLog.m_Entries )
+  {
+    m_Alloc->FreeSized( m_IndexLog.m_Entries, m_IndexLog.m_Capacity * sizeof( IndexEntry ) );
+  }
+  m_Index.m_Entries = NULL;
+  m_Index.m_Count = 0;
+  m_Index.m_Capacity = 0;
+  m_IndexLog = m_Index;
+  m_IndexStatus = kMojoStatus_Ok;
+}
+
+MojoStatus MojoIdManager::EnumeratePrefix( const char* prefix, const MojoCollector< MojoId >& collector,
+                                           const MojoAbstractSet< MojoId >* limit )
+{
+  uint64_t* hash_codes = NULL;
+  int count = 0;
+  {
+    std::lock_guard< std::mutex > index_lock( m_IndexLock );
+    if( !m_Indexed.load( std::memory_order_relaxed ) )
+    {
+      return kMojoStatus_NotInitialized;
+    }
+    MojoStatus status = UpdateIndex();
+    if( status )
+    {
+      return status;
+    }
+    int first;
+    int end;
+    FindIndexRange( prefix, &first, &end );
+    if( first == end )
+    {
+      return kMojoStatus_Ok;
+    }
+    hash_codes = ( uint64_t* )m_Alloc->Allocate( ( end - first ) * sizeof( uint64_t ), "MojoIdManager index" );
+    if( !hash_codes )
+    {
+      return kMojoStatus_CouldNotAlloc;
+    }
+    for( int i = first; i < end; ++i )
+    {
+      if( AcquireIndexed( m_Index.m_Entries[ i ].m_Hash ) )
+      {
+        hash_codes[ count++ ] = m_Index.m_Entries[ i ].m_Hash;
+      }
+    }
+  }
+  
+  // Each id takes over the reference that AcquireIndexed() took
+  for( int i = 0; i < count; ++i )
+  {
+    MojoId id;
+    id.m_HashValue = hash_codes[ i ];
+    if( !limit || limit->Contains( id ) )
+    {
+      collector.Push( id );
+    }
+  }
+  m_Alloc->Free( hash_codes );
+  return kMojoStatus_Ok;
+}
+
+int MojoIdManager::CountPrefix( const char* prefix )
+{
+  std::lock_guard< std::mutex > index_lock( m_IndexLock );
+  if( !m_Indexed.load( std::memory_order_relaxed ) || UpdateIndex() )
+  {
+    return 0;
+  }
+  int first;
+  int end;
+  FindIndexRange( prefix, &first, &end );
+  return end - first;
+}
+
+void MojoIdManager::LogIndex( uint64_t hash_code, const char* c_string )
+{
+  if( m_Indexed.load( std::memory_order_relaxed ) )
+  {
+    std::lock_guard< std::mutex > index_lock( m_IndexLock );
+    if( m_Indexed.load( std::memory_order_relaxed ) )
+    {
+      AppendIndexLog( hash_code, c_string );
+    }
+  }
+}
+
+void MojoIdManager::AppendIndexLog( uint64_t hash_code, const char* c_string )
+{
+  // If the log can not grow, the index is no longer complete. Queries report that until the index is created again.
+  if( !ReserveIndexList( m_IndexLog, m_IndexLog.m_Count + 1 ) )
+  {
+    m_IndexStatus = kMojoStatus_CouldNotAlloc;
+    return;
+  }
+  IndexEntry* log_entry = &m_IndexLog.m_Entries[ m_IndexLog.m_Count ];
+  log_entry->m_Hash = hash_code;
+  log_entry->m_CString = c_string;
+  log_entry->m_Order = m_IndexLog.m_Count;
+  m_IndexLog.m_Count += 1;
+  m_IndexChangeCount.fetch_add( 1, std::memory_order_relaxed );
+}
+
+MojoStatus MojoIdManager::UpdateIndex()
+{
+  if( m_IndexStatus || !m_IndexLog.m_Count )
+  {
+    return m_IndexStatus;
+  }
+  if( !ReserveIndexList( m_Index, m_Index.m_Count + m_IndexLog.m_Count ) )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+  
+  // Drop every indexed string that was logged since. Its entry may have been freed, so it is not looked at.
+  IndexEntry* log = m_IndexLog.m_Entries;
+  int log_count = m_IndexLog.m_Count;
+  qsort( log, log_count, sizeof( IndexEntry ), CompareIndexLog );
+  int kept_count = 0;
+  for( int i = 0; i < m_Index.m_Count; ++i )
+  {
+    uint64_t hash_code = m_Index.m_Entries[ i ].m_Hash;
+    int low = 0;
+    int high = log_count;
+    while( low < high )
+    {
+      int middle = ( low + high ) / 2;
+      if( log[ middle ].m_Hash < hash_code )
+      {
+        low = middle + 1;
+      }
+      else
+      {
+        high = middle;
+      }
+    }
+    if( low == log_count || log[ low ].m_Hash != hash_code )
+    {
+      m_Index.m_Entries[ kept_count++ ] = m_Index.m_Entries[ i ];
+    }
+  }
+  
+  // The last log entry of each string says whether it is still there
+  int add_count = 0;
+  for( int i = 0; i < log_count; ++i )
+  {
+    if( ( i + 1 == log_count || log[ i + 1 ].m_Hash != log[ i ].m_Hash ) && log[ i ].m_CString )
+    {
+      log[ add_count++ ] = log[ i ];
+    }
+  }
+  qsort( log, add_count, sizeof( IndexEntry ), CompareIndexString );
+  
+  // Merge from the back, so the index can be merged in place
+  IndexEntry* entries = m_Index.m_Entries;
+  int i = kept_count - 1;
+  int j = add_count - 1;
+  for( int k = kept_count + add_count - 1; j >= 0; --k )
+  {
+    if( i >= 0 && strcmp( entries[ i ].m_CString, log[ j ].m_CString ) > 0 )
+    {
+      entries[ k ] = entries[ i-- ];
+    }
+    else
+    {
+      entries[ k ] = log[ j-- ];
+    }
+  }
+  m_Index.m_Count = kept_count + add_count;
+  m_IndexLog.m_Count = 0;
+  return kMojoStatus_Ok;
+}
+
+void MojoIdManager::FindIndexRange( const char* prefix, int* first, int* end ) const
+{
+  // The strings that start with prefix are adjacent in the index
+  size_t length = strlen( prefix );
+  int low = 0;
+  int high = m_Index.m_Count;
+  while( low < high )
+  {
+    int middle = ( low + high ) / 2;
+    if( strncmp( m_Index.m_Entries[ middle ].m_CString, prefix, length ) < 0 )
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  *first = low;
+  high = m_Index.m_Count;
+  while( low < high )
+  {
+    int middle = ( low + high ) / 2;
+    if( strncmp( m_Index.m_Entries[ middle ].m_CString, prefix, length ) == 0 )
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  *end = low;
+}
+
+bool MojoIdManager::AcquireIndexed( uint64_t hash_code )
+{
+  if( FindInSnapshot( hash_code ) )
+  {
+    return true;
+  }
+  Entry* entry = FindEntry( GetShard( hash_code ), hash_code );
+  if( !entry )
+  {
+    return false;
+  }
+#if MOJO_ID_REFCOUNT
+  // Never revive an entry whose count dropped to zero. DecRefCount() is about to remove it.
+  int ref_count = entry->m_RefCount.load( std::memory_order_relaxed );
+  while( ref_count && !entry->m_RefCount.compare_exchange_weak( ref_count, ref_count + 1, std::memory_order_relaxed ) )
+  {
+  }
+  return ref_count != 0;
+#else
+  return true;
+#endif
+}
+
+bool MojoIdManager::ReserveIndexList( IndexList& list, int count )
+{
+  if( count <= list.m_Capacity )
+  {
+    return true;
+  }
+  int capacity = MojoMax( MojoMax( count, list.m_Capacity * 2 ), 64 );
+  IndexEntry* entries = ( IndexEntry* )m_Alloc->Reallocate( list.m_Entries, list.m_Capacity * sizeof( IndexEntry ),
+                                                            capacity * sizeof( IndexEntry ), "MojoIdManager index" );
+  if( !entries )
+  {
+    return false;
+  }
+  list.m_Entries = entries;
+  list.m_Capacity = capacity;
+  return true;
+}
+
+int MojoIdManager::CompareIndexLog( const void* a, const void* b )
+{
+  const IndexEntry* entry_a = ( const IndexEntry* )a;
+  const IndexEntry* entry_b = ( const IndexEntry* )b;
+  if( entry_a->m_Hash != entry_b->m_Hash )
+  {
+    return entry_a->m_Hash < entry_b->m_Hash ? -1 : 1;
+  }
+  return entry_a->m_Order - entry_b->m_Order;
+}
+
+int MojoIdManager::CompareIndexString( const void* a, const void* b )
+{
+  return strcmp( ( ( const IndexEntry* )a )->m_CString, ( ( const IndexEntry* )b )->m_CString );
+}
+
+uint32_t MojoIdManager::FindDenseIndex( uint64_t hash_code )
+{
+  if( !hash_code || m_Status )
+  {
+    return 0;
+  }
+  
+  // Strings get their index the first time one is asked for. Interning stays free of the dense lock, and loading a
+  // snapshot allocates nothing.
+  std::atomic< uint32_t >* dense_index = NULL;
+  int snapshot_slot = FindSnapshotSlot( hash_code );
+  if( snapshot_slot < 0 )
+  {
+    Entry* entry = FindEntry( GetShard( hash_code ), hash_code );
+    if( !entry )
+    {
+      return 0;
+    }
+    dense_index = &entry->m_DenseIndex;
+  }
+  else
+  {
+    std::atomic< uint32_t >* snapshot_dense = m_SnapshotDense.load( std::memory_order_acquire );
+    if( !snapshot_dense )
+    {
+      std::lock_guard< std::mutex > lock( m_DenseLock );
+      snapshot_dense = m_SnapshotDense.load( std::memory_order_relaxed );
+      if( !snapshot_dense )
+      {
+        size_t size = m_Snapshot->m_SlotCount * sizeof( std::atomic< uint32_t > );
+        snapshot_dense = ( std::atomic< uint32_t >* )m_Alloc->Allocate( size, "MojoIdManager dense" );
+        if( !snapshot_dense )
+        {
+          return 0;
+        }
+        for( uint32_t i = 0; i < m_Snapshot->m_SlotCount; ++i )
+        {
+          new( &snapshot_dense[ i ] ) std::atomic< uint32_t >( 0 );
+        }
+        m_SnapshotDense.store( snapshot_dense, std::memory_order_release );
+      }
+    }
+    dense_index = &snapshot_dense[ snapshot_slot ];
+  }
+  
+  uint32_t index = dense_index->load( std::memory_order_acquire );
+  if( !index )
+  {
+    // Another thread may be assigning one at the same time. The first one stored is kept.
+    index = AcquireDenseIndex( hash_code );
+    uint32_t expected = 0;
+    if( index && !dense_index->compare_exchange_strong( expected, index ) )
+    {
+      ReleaseDenseIndex( index );
+      index = expected;
+    }
+  }
+  return index;
+}
+
+uint64_t MojoIdManager::FindDenseHash( uint32_t index ) const
+{
+  const DenseTable* table = m_DenseTable.load( std::memory_order_acquire );
+  return table && index < table->m_Capacity ? table->m_Hashes[ index ].load( std::memory_order_acquire ) : 0;
+}
+
+uint32_t MojoIdManager::AcquireDenseIndex( uint64_t hash_code )
+{
+  std::lock_guard< std::mutex > lock( m_DenseLock );
+  DenseTable* table = m_DenseTable.load( std::memory_order_relaxed );
+  uint32_t index = 0;
+  if( m_DenseFreeCount )
+  {
+    index = m_DenseFree[ --m_DenseFreeCount ];
+  }
+  else
+  {
+    index = m_DenseCount.load( std::memory_order_relaxed );
+    if( !table || index == table->m_Capacity )
+    {
+      // Lookups that already loaded the old table finish there. It is freed by Destroy().
+      uint32_t capacity = table ? table->m_Capacity * 2 : kDenseTableMin;
+      size_t size = sizeof( DenseTable ) + capacity * sizeof( std::atomic< uint64_t > );
+      DenseTable* new_table = ( DenseTable* )m_Alloc->Allocate( size, "MojoIdManager dense" );
+      if( !new_table )
+      {
+        return 0;
+      }
+      new_table->m_Capacity = capacity;
+      new_table->m_Retired = table;
+      new_table->m_Hashes = ( std::atomic< uint64_t >* )( new_table + 1 );
+      for( uint32_t i = 0; i < capacity; ++i )
+      {
+        uint64_t old_hash = table && i < table->m_Capacity ? table->m_Hashes[ i ].load( std::memory_order_relaxed ) : 0;
+        new( &new_table->m_Hashes[ i ] ) std::atomic< uint64_t >( old_hash );
+      }
+      m_DenseTable.store( new_table, std::memory_order_release );
+      table = new_table;
+    }
+    m_DenseCount.store( index + 1, std::memory_order_relaxed );
+  }
+  table->m_Hashes[ index ].store( hash_code, std::memory_order_release );
+  m_DenseLiveCount += 1;
+  return index;
+}
+
+void MojoIdManager::ReleaseDenseIndex( uint32_t index )
+{
+  std::lock_guard< std::mutex > lock( m_DenseLock );
+  m_DenseTable.load( std::memory_order_relaxed )->m_Hashes[ index ].store( 0, std::memory_order_release );
+  m_DenseLiveCount -= 1;
+  if( !m_DenseLiveCount )
+  {
+    // No string has an index. Start over from index 1, but keep the tables: FindDenseHash() may still be reading them.
+    m_DenseCount.store( 1, std::memory_order_relaxed );
+    m_DenseFreeCount = 0;
+    return;
+  }
+  if( m_DenseFreeCount == m_DenseFreeCapacity )
+  {
+    // If the list can not grow, the index is simply never reused
+    int capacity = MojoMax( m_DenseFreeCapacity * 2, 256 );
+    uint32_t* free_indices = ( uint32_t* )m_Alloc->Reallocate( m_DenseFree, m_DenseFreeCapacity * sizeof( uint32_t ),
+                                                               capacity * sizeof( uint32_t ), "MojoIdManager dense" );
+    if( !free_indices )
+    {
+      return;
+    }
+    m_DenseFree = free_indices;
+    m_DenseFreeCapacity = capacity;
+  }
+  m_DenseFree[ m_DenseFreeCount++ ] = index;
+}
+
+void MojoIdManager::FreeDense()
+{
+  FreeDenseTables();
+  std::atomic< uint32_t >* snapshot_dense = m_SnapshotDense.load( std::memory_order_relaxed );
+  if( snapshot_dense )
+  {
+    m_Alloc->Free( snapshot_dense );
+  }
+  m_SnapshotDense.store( NULL );
+}
+
+void MojoIdManager::FreeDenseTables()
+{
+  DenseTable* table = m_DenseTable.load( std::memory_order_relaxed );
+  while( table )
+  {
+    DenseTable* retired = table->m_Retired;
+    m_Alloc->Free( table );
+    table = retired;
+  }
+  if( m_DenseFree )
+  {
+    m_Alloc->FreeSized( m_DenseFree, m_DenseFreeCapacity * sizeof( uint32_t ) );
+  }
+  m_DenseTable.store( NULL );
+  m_DenseCount.store( 1 );
+  m_DenseFree = NULL;
+  m_DenseFreeCount = 0;
+  m_DenseFreeCapacity = 0;
+  m_DenseLiveCount = 0;
+}
+
+int MojoIdManager::Reclaim()
+{
+  int removed_count = 0;
+  for( int i = 0; i < kMojoIdManagerShardCount && !m_Status; ++i )
+  {
+    std::lock_guard< std::mutex > lock( m_Shards[ i ].m_Lock );
+    removed_count += ReclaimRetired( m_Shards[ i ], true );
+  }
+  return removed_count;
+}
+
+void MojoIdManager::Trim()
+{
+  for( int i = 0; i < kMojoIdManagerShardCount && !m_Status; ++i )
+  {
+    Shard& shard = m_Shards[ i ];
+    std::lock_guard< std::mutex > lock( shard.m_Lock );
+    Table* table = shard.m_Table.load( std::memory_order_relaxed );
+    if( !table )
+    {
+      continue;
+    }
+    if( shard.m_Count.load( std::memory_order_relaxed ) )
+    {
+      FreeTables( table->m_Retired );
+      table->m_Retired = NULL;
+    }
+    else
+    {
+      FreeBlocks( shard );
+      FreeRetired( shard );
+      FreeTables( table );
+      shard.m_Table.store( NULL, std::memory_order_release );
+    }
+  }
+  
+  std::lock_guard< std::mutex > lock( m_DenseLock );
+  DenseTable* dense_table = m_DenseTable.load( std::memory_order_relaxed );
+  if( !m_DenseLiveCount )
+  {
+    FreeDenseTables();
+  }
+  else if( dense_table )
+  {
+    DenseTable* retired = dense_table->m_Retired;
+    dense_table->m_Retired = NULL;
+    while( retired )
+    {
+      DenseTable* next = retired->m_Retired;
+      m_Alloc->Free( retired );
+      retired = next;
+    }
+  }
+}
+
+void MojoIdManager::RetireEntry( Shard& shard, Slot* slot, Entry* entry )
+{
+  if( entry->m_RetiredBatch == shard.m_RetiredBatch )
+  {
+    return;  // Already listed in this batch
+  }
+  if( shard.m_RetiredCount == shard.m_RetiredCapacity )
+  {
+    int capacity = MojoMax( shard.m_RetiredCapacity * 2, 64 );
+    uint64_t* retired = ( uint64_t* )m_Alloc->Reallocate( shard.m_Retired, shard.m_RetiredCapacity * sizeof( uint64_t ),
+                                                          capacity * sizeof( uint64_t ), "MojoIdManager retired" );
+    if( !retired )
+    {
+      RemoveEntry( shard, slot, entry );
+      return;
+    }
+    shard.m_Retired = retired;
+    shard.m_RetiredCapacity = capacity;
+  }
+  shard.m_Retired[ shard.m_RetiredCount++ ] = slot->m_Hash.load( std::memory_order_relaxed );
+  entry->m_RetiredBatch = shard.m_RetiredBatch;
+  if( shard.m_RetiredCount - shard.m_RetiredOlderCount >= m_ReclaimBatch.load( std::memory_order_relaxed ) )
+  {
+    ReclaimRetired( shard, false );
+  }
+}
+
+int MojoIdManager::ReclaimRetired( Shard& shard, bool all )
+{
+  // Unless all are reclaimed, only the older batch goes. Strings in the current batch get one more batch of grace.
+  if( !shard.m_RetiredCount )
+  {
+    return 0;
+  }
+  uint32_t older_batch = shard.m_RetiredBatch - 1;
+  int end = all ? shard.m_RetiredCount : shard.m_RetiredOlderCount;
+  int removed_count = 0;
+  for( int i = 0; i < end; ++i )
+  {
+    // An entry may have been revived, retired again later, or removed by Sweep() since it was listed
+    Slot* slot = FindSlot( shard.m_Table.load( std::memory_order_relaxed ), shard.m_Retired[ i ] );
+    Entry* entry = slot->m_Entry.load( std::memory_order_relaxed );
+    if( entry && entry->m_RefCount.load( std::memory_order_acquire ) == 0 &&
+        ( all || entry->m_RetiredBatch == older_batch ) )
+    {
+      RemoveEntry( shard, slot, entry );
+      removed_count += 1;
+    }
+  }
+  memmove( shard.m_Retired, shard.m_Retired + end, ( shard.m_RetiredCount - end ) * sizeof( uint64_t ) );
+  shard.m_RetiredCount -= end;
+  shard.m_RetiredOlderCount = shard.m_RetiredCount;
+  shard.m_RetiredBatch += 1;
+  return removed_count;
+}
+
+void MojoIdManager::FreeRetired( Shard& shard )
+{
+  if( shard.m_Retired )
+  {
+    m_Alloc->FreeSized( shard.m_Retired, shard.m_RetiredCapacity * sizeof( uint64_t ) );
+  }
+  shard.m_Retired = NULL;
+  shard.m_RetiredCount = 0;
+  shard.m_RetiredCapacity = 0;
+  shard.m_RetiredOlderCount = 0;
+}
+
+void MojoIdManager::GetStats( MojoIdStats* stats ) const
+{
+  memset( stats, 0, sizeof( MojoIdStats ) );
+  for( int i = 0; i < kMojoIdManagerShardCount; ++i )
+  {
+    Shard& shard = const_cast< Shard& >( m_Shards[ i ] );
+    std::lock_guard< std::mutex > lock( shard.m_Lock );
+    stats->m_LiveCount += shard.m_Count.load( std::memory_order_relaxed );
+    stats->m_StringBytes += shard.m_StringBytes;
+    for( const Block* block = shard.m_Blocks; block; block = block->m_Next )
+    {
+      stats->m_BlockBytes += sizeof( Block ) + block->m_Size;
+    }
+    stats->m_BlockBytes += shard.m_SpareBlock ? sizeof( Block ) + shard.m_SpareBlock->m_Size : 0;
+    const Table* table = shard.m_Table.load( std::memory_order_relaxed );
+    stats->m_TableCapacity += table ? table->m_Capacity : 0;
+    stats->m_TableUsedCount += table ? table->m_UsedCount : 0;
+    stats->m_InsertCount += shard.m_InsertCount;
+    stats->m_NewCount += shard.m_NewCount;
+    stats->m_FreeCount += shard.m_FreeCount;
+    stats->m_ReviveCount += shard.m_ReviveCount;
+    stats->m_RetiredCount += shard.m_RetiredCount;
+#if MOJO_ID_STATS
+    stats->m_IncRefCount += shard.m_IncRefCount.load( std::memory_order_relaxed );
+    stats->m_DecRefCount += shard.m_DecRefCount.load( std::memory_order_relaxed );
+#endif
+  }
+  stats->m_SnapshotCount = m_Snapshot ? ( int )m_Snapshot->m_Count : 0;
+  stats->m_SnapshotBytes = m_SnapshotSize;
+  stats->m_LiveCount += stats->m_SnapshotCount;
+  stats->m_TableLoad = stats->m_TableCapacity ? ( float )stats->m_TableUsedCount / stats->m_TableCapacity : 0.0f;
+}
+
+void MojoIdManager::ResetCounters()
+{
+  for( int i = 0; i < kMojoIdManagerShardCount; ++i )
+  {
+    Shard& shard = m_Shards[ i ];
+    std::lock_guard< std::mutex > lock( shard.m_Lock );
+    shard.m_InsertCount = 0;
+    shard.m_NewCount = 0;
+    shard.m_FreeCount = 0;
+    shard.m_ReviveCount = 0;
+#if MOJO_ID_STATS
+    shard.m_IncRefCount.store( 0, std::memory_order_relaxed );
+    shard.m_DecRefCount.store( 0, std::memory_order_relaxed );
+#endif
+  }
+  std::lock_guard< std::mutex > lock( m_HotLock );
+  m_HotCount = 0;
+}
+
+int MojoIdManager::GetHotIds( MojoIdHotEntry* entries, int max_count ) const
+{
+  std::lock_guard< std::mutex > lock( m_HotLock );
+  bool taken[ kMojoIdHotCount ] = { false };
+  int count = MojoMin( max_count, m_HotCount );
+  for( int i = 0; i < count; ++i )
+  {
+    // Selection sort. The report is small.
+    int best = -1;
+    for( int j = 0; j < m_HotCount; ++j )
+    {
+      if( !taken[ j ] && ( best < 0 || m_Hot[ j ].m_Count > m_Hot[ best ].m_Count ) )
+      {
+        best = j;
+      }
+    }
+    taken[ best ] = true;
+    entries[ i ] = m_Hot[ best ];
+  }
+  return count;
+}
+
+void MojoIdManager::SampleHot( uint64_t hash_code, const char* c_string )
+{
+  // Space-saving count: a string that is not in a full report replaces the one with the lowest count, and inherits it
+  std::lock_guard< std::mutex > lock( m_HotLock );
+  int lowest = 0;
+  for( int i = 0; i < m_HotCount; ++i )
+  {
+    if( m_Hot[ i ].m_Hash == hash_code )
+    {
+      m_Hot[ i ].m_Count += 1;
+      return;
+    }
+    lowest = m_Hot[ i ].m_Count < m_Hot[ lowest ].m_Count ? i : lowest;
+  }
+  MojoIdHotEntry* hot = NULL;
+  if( m_HotCount < kMojoIdHotCount )
+  {
+    hot = &m_Hot[ m_HotCount++ ];
+    hot->m_Count = 1;
+  }
+  else
+  {
+    hot = &m_Hot[ lowest ];
+    hot->m_Count += 1;
+  }
+  hot->m_Hash = hash_code;
+  strncpy( hot->m_CString, c_string, kMojoIdHotStringMax - 1 );
+  hot->m_CString[ kMojoIdHotStringMax - 1 ] = 0;
+}
+
+int MojoIdManager::GetShardIndex( uint64_t hash_code )
+{
+  // The low bits select the slot within a shard's table, so use high bits here
+  return ( int )( ( hash_code >> 32 ) % kMojoIdManagerShardCount );
+}
+
+MojoIdManager::Shard& MojoIdManager::GetShard( uint64_t hash_code )
+{
+  return m_Shards[ GetShardIndex( hash_code ) ];
+}
+
+const MojoIdManager::Shard& MojoIdManager::GetShard( uint64_t hash_code ) const
+{
+  return m_Shards[ GetShardIndex( hash_code ) ];
+}
+
+MojoIdManager::Entry* MojoIdManager::FindEntry( const Shard& shard, uint64_t hash_code ) const
+{
+  const Table* table = shard.m_Table.load( std::memory_order_acquire );
+  if( !table )
+  {
+    return NULL;
+  }
+  int mask = table->m_Capacity - 1;
+  for( int i = ( int )( hash_code & mask ); ; i = ( i + 1 ) & mask )
+  {
+    uint64_t slot_hash = table->m_Slots[ i ].m_Hash.load( std::memory_order_acquire );
+    if( slot_hash == hash_code )
+    {
+      return table->m_Slots[ i ].m_Entry.load( std::memory_order_acquire );
+    }
+    if( !slot_hash )
+    {
+      return NULL;
+    }
+  }
+}
+
+void MojoIdManager::RemoveEntry( Shard& shard, Slot* slot, Entry* entry )
+{
+  // Logged before the string is freed, so that a query holding the index lock never sees a freed string
+  uint64_t hash_code = slot->m_Hash.load( std::memory_order_relaxed );
+  LogIndex( hash_code, NULL );
+  shard.m_FreeCount += 1;
+  shard.m_StringBytes -= strlen( entry->m_CString ) + 1;
+  int sample_rate = m_HotSampleRate.load( std::memory_order_relaxed );
+  if( sample_rate > 0 && shard.m_FreeCount % sample_rate == 0 )
+  {
+    SampleHot( hash_code, entry->m_CString );
+  }
+  if( entry->m_DenseIndex.load( std::memory_order_relaxed ) )
+  {
+    ReleaseDenseIndex( entry->m_DenseIndex.load( std::memory_order_relaxed ) );
+  }
+  slot->m_Entry.store( NULL, std::memory_order_release );
+  FreeEntry( shard, entry );
+  // An empty shard keeps its tables and blocks. Find() and friends may still be probing them without a lock, with hash
+  // codes that they hold no reference to. Destroy() frees them.
+  shard.m_Count.fetch_sub( 1, std::memory_order_relaxed );
+}
+
+MojoIdManager::Slot* MojoIdManager::FindSlot( Table* table, uint64_t hash_code ) const
+{
+  // Returns the slot that holds, or last held, hash_code. If there is none, the empty slot where it would go.
+  int mask = table->m_Capacity - 1;
+  for( int i = ( int )( hash_code & mask ); ; i = ( i + 1 ) & mask )
+  {
+    uint64_t slot_hash = table->m_Slots[ i ].m_Hash.load( std::memory_order_relaxed );
+    if( slot_hash == hash_code || !slot_hash )
+    {
+      return &table->m_Slots[ i ];
+    }
+  }
+}
+
+MojoIdManager::Table* MojoIdManager::NewTable( int capacity )
+{
+  Table* table = ( Table* )m_Alloc->Allocate( sizeof( Table ) + capacity * sizeof( Slot ), "MojoIdManager" );
+  if( table )
+  {
+    table->m_Capacity = capacity;
+    table->m_UsedCount = 0;
+    table->m_Retired = NULL;
+    table->m_Slots = ( Slot* )( table + 1 );
+    for( int i = 0; i < capacity; ++i )
+    {
+      Slot* slot = new( &table->m_Slots[ i ] ) Slot();
+      slot->m_Hash.store( 0, std::memory_order_relaxed );
+      slot->m_Entry.store( NULL, std::memory_order_relaxed );
+    }
+  }
+  return table;
+}
+
+bool MojoIdManager::IsTableFull( const Table* table, int add_count ) const
+{
+  return ( table->m_UsedCount + add_count ) * 100 > table->m_Capacity * m_Config.m_GrowThreshold;
+}
+
+int MojoIdManager::GetTableCapacity( int capacity, int count ) const
+{
+  // Leave room for as many strings again before the table is full
+  while( capacity < m_Config.m_TableCountMin || count * 200 > capacity * m_Config.m_GrowThreshold )
+  {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+bool MojoIdManager::Grow( Shard& shard, int add_count )
+{
+  // Removed entries are left behind, so the new table may be no bigger than the old one
+  Table* table = shard.m_Table.load( std::memory_order_relaxed );
+  int live_count = shard.m_Count.load( std::memory_order_relaxed );
+  Table* new_table = NewTable( GetTableCapacity( table->m_Capacity, live_count + add_count ) );
+  if( !new_table )
+  {
+    return false;
+  }
+  for( int i = 0; i < table->m_Capacity; ++i )
+  {
+    Entry* entry = table->m_Slots[ i ].m_Entry.load( std::memory_order_relaxed );
+    if( entry )
+    {
+      uint64_t hash_code = table->m_Slots[ i ].m_Hash.load( std::memory_order_relaxed );
+      Slot* slot = FindSlot( new_table, hash_code );
+      slot->m_Entry.store( entry, std::memory_order_relaxed );
+      slot->m_Hash.store( hash_code, std::memory_order_relaxed );
+      new_table->m_UsedCount += 1;
+    }
+  }
+  // Lookups that already loaded the old table finish there. It is freed by Destroy().
+  new_table->m_Retired = table;
+  shard.m_Table.store( new_table, std::memory_order_release );
+  return true;
+}
+
+void MojoIdManager::FreeTables( Table* table )
+{
+  while( table )
+  {
+    Table* retired = table->m_Retired;
+    m_Alloc->Free( table );
+    table = retired;
+  }
+}
+
+MojoIdManager::Entry* MojoIdManager::NewEntry( Shard& shard, const char* chars, int length )
+{
+  // Entries are packed into the shard's current block, aligned for the next entry
+  int size = ( int )( ( sizeof( Entry ) + length + 1 + sizeof( void* ) - 1 ) & ~( sizeof( void* ) - 1 ) );
+  Block* block = shard.m_CurrentBlock;
+  if( !block || block->m_UsedSize + size > block->m_Size )
+  {
+    if( size > kMojoIdStringBlockSize )
+    {
+      block = NewBlock( shard, size );
+    }
+    else
+    {
+      block = NewBlock( shard, kMojoIdStringBlockSize );
+      if( block )
+      {
+        Block* old_block = shard.m_CurrentBlock;
+        shard.m_CurrentBlock = block;
+        if( old_block && !old_block->m_LiveCount )
+        {
+          FreeBlock( shard, old_block );
+        }
+      }
+    }
+    if( !block )
+    {
+      return NULL;
+    }
+  }
+  
+  Entry* entry = ( Entry* )( ( char* )( block + 1 ) + block->m_UsedSize );
+  block->m_UsedSize += size;
+  block->m_LiveCount += 1;
+  char* string_mem = ( char* )( entry + 1 );
+  memcpy( string_mem, chars, length );
+  string_mem[ length ] = 0;
+  new( &entry->m_RefCount ) std::atomic< int >( MOJO_ID_REFCOUNT );
+  new( &entry->m_Epoch ) std::atomic< uint32_t >( GetEpoch() );
+  new( &entry->m_DenseIndex ) std::atomic< uint32_t >( 0 );
+  entry->m_RetiredBatch = 0;
+  entry->m_Block = block;
+  entry->m_CString = string_mem;
+  return entry;
+}
+
+void MojoIdManager::FreeEntry( Shard& shard, Entry* entry )
+{
+  // Space is not reused entry by entry. The block is recycled once all of its entries are gone.
+  Block* block = entry->m_Block;
+  block->m_LiveCount -= 1;
+  if( !block->m_LiveCount )
+  {
+    if( block == shard.m_CurrentBlock )
+    {
+      block->m_UsedSize = 0;
+    }
+    else
+    {
+      FreeBlock( shard, block );
+    }
+  }
+}
+
+MojoIdManager::Block* MojoIdManager::NewBlock( Shard& shard, int size )
+{
+  Block* block = NULL;
+  if( shard.m_SpareBlock && size == kMojoIdStringBlockSize )
+  {
+    block = shard.m_SpareBlock;
+    shard.m_SpareBlock = NULL;
+  }
+  else
+  {
+    block = ( Block* )m_Alloc->Allocate( sizeof( Block ) + size, "MojoId string" );
+    if( !block )
+    {
+      return NULL;
+    }
+    block->m_Size = size;
+  }
+  block->m_UsedSize = 0;
+  block->m_LiveCount = 0;
+  block->m_Prev = NULL;
+  block->m_Next = shard.m_Blocks;
+  if( shard.m_Blocks )
+  {
+    shard.m_Blocks->m_Prev = block;
+  }
+  shard.m_Blocks = block;
+  return block;
+}
+
+void MojoIdManager::FreeBlock( Shard& shard, Block* block )
+{
+  if( block->m_Prev )
+  {
+    block->m_Prev->m_Next = block->m_Next;
+  }
+  else
+  {
+    shard.m_Blocks = block->m_Next;
+  }
+  if( block->m_Next )
+  {
+    block->m_Next->m_Prev = block->m_Prev;
+  }
+  if( !shard.m_SpareBlock && block->m_Size == kMojoIdStringBlockSize )
+  {
+    shard.m_SpareBlock = block;
+  }
+  else
+  {
+    m_Alloc->Free( block );
+  }
+}
+
+void MojoIdManager::FreeBlocks( Shard& shard )
+{
+  while( shard.m_Blocks )
+  {
+    Block* block = shard.m_Blocks;
+    shard.m_Blocks = block->m_Next;
+    m_Alloc->Free( block );
+  }
+  if( shard.m_SpareBlock )
+  {
+    m_Alloc->Free( shard.m_SpareBlock );
+  }
+  shard.m_CurrentBlock = NULL;
+  shard.m_SpareBlock = NULL;
+}
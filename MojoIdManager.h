@@ -25,16 +25,82 @@
 /* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
 #pragma once
 
+// -- Standard Libs
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
 // -- Mojo
-#include "MojoMap.h"
 #include "MojoUtil.h"
 #include "MojoConfig.h"
+#include "MojoAlloc.h"
+#include "MojoStatus.h"
+#include "MojoConstants.h"
+#include "MojoCollector.h"
+#include "MojoAbstractSet.h"
+
+/** \cond HIDE_FORWARD_REFERENCE */
+class MojoId;
+/** \endcond */
+
+/**
+ \ingroup group_id
+ Statistics of the MojoIdManager. See MojoIdManager::GetStats().
+ */
+struct MojoIdStats
+{
+  int       m_LiveCount;        ///< Strings in the dictionary, including those in a loaded snapshot
+  int       m_SnapshotCount;    ///< Strings in a loaded snapshot
+  size_t    m_StringBytes;      ///< Characters in strings outside the snapshot, including terminators
+  size_t    m_BlockBytes;       ///< Memory held by string blocks, including entry headers and unused space
+  size_t    m_SnapshotBytes;    ///< Size of the mapped snapshot file
+  int       m_TableCapacity;    ///< Slots in all shard tables
+  int       m_TableUsedCount;   ///< Slots that are probed past, including those of removed strings
+  float     m_TableLoad;        ///< m_TableUsedCount / m_TableCapacity
+  uint64_t  m_InsertCount;      ///< Strings interned outside the snapshot, whether they were new or not
+  uint64_t  m_NewCount;         ///< Strings added to the dictionary
+  uint64_t  m_FreeCount;        ///< Strings removed from the dictionary
+  uint64_t  m_ReviveCount;      ///< Strings interned again while they had no references. See SetReclaimBatch()
+  int       m_RetiredCount;     ///< Strings without references that are waiting to be reclaimed
+  uint64_t  m_IncRefCount;      ///< IncRefCount() calls. Only counted if MOJO_ID_STATS is 1
+  uint64_t  m_DecRefCount;      ///< DecRefCount() calls. Only counted if MOJO_ID_STATS is 1
+};
+
+/**
+ \ingroup group_id
+ An entry of the hot id report. See MojoIdManager::GetHotIds().
+ */
+struct MojoIdHotEntry
+{
+  uint64_t  m_Hash;                           ///< Hash code of the string
+  int       m_Count;                          ///< Estimated number of sampled removals
+  char      m_CString[ kMojoIdHotStringMax ]; ///< The string, truncated if needed
+};
 
 /**
  \class MojoIdManager
  \ingroup group_id
  Dictionary that is the backing for MojoId. You must access this class through its singleton instance g_MojoIdManager.
  All that is needed is a call to Create() at program initialization, and Destroy() before exit.
+
+ MojoIds may be created, copied and destroyed from any number of threads at once:
+ - The dictionary is divided over kMojoIdManagerShardCount shards by hash code. Each shard has its own lock, which is
+ only taken to add a string, or to remove one whose reference count has dropped to zero.
+ - Copying and destroying a MojoId updates the reference count with an atomic operation, without locking.
+ - FindCString() never locks. A shard's table is replaced when it grows, but the old table stays readable until no
+ id from the shard is left, so a lookup that is in progress is never affected.
+
+ Strings are not allocated one by one. Each shard packs them into blocks of kMojoIdStringBlockSize bytes, which are
+ only returned once every string in them has been removed. An empty block is kept for reuse.
+
+ A dictionary can be saved to a file with SaveSnapshot(), and mapped back into memory at the next launch with
+ LoadSnapshot(). Strings in the snapshot are found in the mapped file directly, without hashing or allocating anything
+ on startup. Strings that are not in the snapshot go into the regular, mutable tables.
+
+ CreateIndex() adds an index of the strings in sorted order, for prefix queries and sorted listings. See also
+ MojoIdPrefixSet.
+
+ The allocator must be safe to call from every thread that creates MojoIds.
  */
 class MojoIdManager
 {
@@ -54,38 +120,348 @@ public:
 
   /**
    Shut down and release memory.
-   Call g_MojoIdManager.Destroy() before program exit. Will deallocate internal buffers.
+   Call g_MojoIdManager.Destroy() before program exit. Will deallocate internal buffers. No other thread may be using
+   MojoIds at this time.
    */
   void Destroy();
 
   /**
-   Get number of entries in the table.
+   Get number of entries in the table, including those in a loaded snapshot.
    \return Number of entries in the table.
    */
-  int GetCount() const { return m_HashMap.GetCount(); }
+  int GetCount() const;
+
+  /**
+   Write every string in the dictionary to a file, with a hash index, so that LoadSnapshot() can map it. The file is
+   in native byte order, and is only valid for the same MOJO_WIDE_STRING_HASH setting.
+   \param[in] path File to write.
+   \return Status code.
+   */
+  MojoStatus SaveSnapshot( const char* path ) const;
+
+  /**
+   Map a file written by SaveSnapshot() read-only. Its strings are never removed, and need no reference counting.
+   Must be called before any MojoIds are created, and before other threads use MojoIds. The file stays mapped until
+   Destroy().
+   \param[in] path File to map.
+   \return Status code. kMojoStatus_InvalidArguments if the dictionary is not empty, or a snapshot is already loaded.
+   kMojoStatus_InvalidFile if the file can not be mapped or was not written by SaveSnapshot() with the same settings.
+   */
+  MojoStatus LoadSnapshot( const char* path );
+
+  /**
+   Get the current epoch. Every string that is interned or marked is stamped with the current epoch.
+   \return The current epoch.
+   */
+  uint32_t GetEpoch() const { return m_Epoch.load( std::memory_order_relaxed ); }
+
+  /**
+   Start a new epoch.
+   \return The new epoch. Pass it to Sweep() to remove every string that was not interned or marked since this call.
+   */
+  uint32_t AdvanceEpoch();
+
+  /**
+   Stamp the string of an id with the current epoch, so that Sweep() of this epoch or older keeps it.
+   \param[in] hash_code Hash code of the id. See MojoId::AsUint64().
+   */
+  void Mark( uint64_t hash_code );
+
+  /**
+   Remove every string that has no references, and that was last interned or marked before epoch. With
+   MOJO_ID_REFCOUNT set to 0 no string has references, and this is the only way strings are removed. MojoIds of removed
+   strings must not be used anymore, and no other thread may be using them during the sweep.
+   \param[in] epoch Epoch returned by AdvanceEpoch().
+   \return Number of strings removed.
+   */
+  int Sweep( uint32_t epoch );
+
+  /**
+   Get the number of times a string could not be added because a different string with the same hash code was already
+   in the dictionary. Each time, the MojoId was set to Null. See also MojoId::Set().
+   \return Number of hash collisions detected.
+   */
+  int GetCollisionCount() const { return m_CollisionCount.load( std::memory_order_relaxed ); }
+
+  /**
+   Build an index of every string in the dictionary in strcmp() order, and keep it up to date from now on. Strings that
+   are added or removed later are logged, and merged into the index by the next query that needs it. Until then, the
+   index costs one extra lock per string that is added or removed.
+   \return Status code. kMojoStatus_DoubleInitialized if the index exists already.
+   */
+  MojoStatus CreateIndex();
+
+  /**
+   Stop maintaining the ordered index, and release it.
+   */
+  void DestroyIndex();
+
+  /**
+   Test if CreateIndex() was called.
+   \return true if the dictionary is indexed.
+   */
+  bool IsIndexed() const { return m_Indexed.load( std::memory_order_relaxed ); }
+
+  /**
+   Push every id whose string starts with prefix into the collector, in strcmp() order of the strings. The ids are
+   collected under the index lock, and pushed after it is released, so the collector may create and drop ids freely.
+   \param[in] prefix Prefix to match. An empty prefix matches every string.
+   \param[in] collector Receives the ids.
+   \param[in] limit Optional. If given, only ids that are also in this set are pushed.
+   \return Status code. kMojoStatus_NotInitialized if there is no index.
+   */
+  MojoStatus EnumeratePrefix( const char* prefix, const MojoCollector< MojoId >& collector,
+                              const MojoAbstractSet< MojoId >* limit = NULL );
+
+  /**
+   Count the strings that start with prefix.
+   \param[in] prefix Prefix to match. An empty prefix matches every string.
+   \return Number of strings. 0 if there is no index.
+   */
+  int CountPrefix( const char* prefix );
+
+  /**
+   Get a number that changes whenever a string is added to or removed from the index. See
+   MojoAbstractSet::_GetChangeCount().
+   \return Change count.
+   */
+  int GetIndexChangeCount() const { return m_IndexChangeCount.load( std::memory_order_relaxed ); }
+
+  /**
+   Get one more than the highest MojoIndexId that was issued. Arrays and bitmaps of this size can be indexed by any
+   MojoIndexId. A string gets its index when the first MojoIndexId is made from it, and indices of removed strings are
+   reused before new ones are issued, so this stays close to the number of strings that had a MojoIndexId at the same
+   time.
+   \return Index limit.
+   */
+  uint32_t GetIndexIdLimit() const { return m_DenseCount.load( std::memory_order_relaxed ); }
+
+  /**
+   Gather statistics. Takes each shard lock in turn.
+   \param[out] stats Receives the statistics.
+   */
+  void GetStats( MojoIdStats* stats ) const;
+
+  /**
+   Set the counters of GetStats() to zero, and clear the hot id report.
+   */
+  void ResetCounters();
+
+  /**
+   Sample removals of strings for the hot id report. A string that is removed and interned again over and over is
+   usually a temporary MojoId made from a C-string in a loop, which pays for hashing, allocation and locking each time.
+   \param[in] rate Sample one in this many removals per shard. 0 (the default) turns sampling off.
+   */
+  void SetHotSampleRate( int rate ) { m_HotSampleRate.store( rate, std::memory_order_relaxed ); }
+
+  /**
+   Get the strings that were removed most often while sampling, most frequent first. Counts are estimates: a string
+   that enters a full report takes over the lowest count.
+   \param[out] entries Receives up to max_count entries.
+   \param[in] max_count Size of entries.
+   \return Number of entries written.
+   */
+  int GetHotIds( MojoIdHotEntry* entries, int max_count ) const;
+
+  /**
+   Defer the removal of strings whose reference count drops to zero. Such a string is retired instead: it stays in
+   the dictionary, and interning it again only revives its count. Each shard removes its retired strings in batches,
+   once batch_count more strings have been retired, and only those that were retired one batch earlier and are still
+   unreferenced. A MojoId that is made and dropped over and over then costs no allocation and no table update at all.
+   \param[in] batch_count Strings retired per shard before a batch is reclaimed. 0 (the default) removes strings as
+   soon as their count drops to zero. Strings that are retired already stay until Reclaim().
+   \note GetCount() includes retired strings. MojoIdPrefixSet does not enumerate them.
+   */
+  void SetReclaimBatch( int batch_count ) { m_ReclaimBatch.store( batch_count, std::memory_order_relaxed ); }
+
+  /**
+   Remove every retired string that is still unreferenced now, for instance at the end of a level.
+   \return Number of strings removed.
+   */
+  int Reclaim();
+
+  /**
+   Free the tables and string blocks of shards that have no strings left, the MojoIndexId tables once no string has an
+   index, and the tables that growing replaced. Lookups do not lock, so the dictionary otherwise keeps these until
+   Destroy(). No other thread may be using MojoIds
+   at this time.
+   */
+  void Trim();
 
 private:
+  struct Block
+  {
+    Block*              m_Prev;
+    Block*              m_Next;
+    int                 m_Size;         // Bytes of entry space that follow this header
+    int                 m_UsedSize;
+    int                 m_LiveCount;    // Entries in this block that have not been removed
+  };
+
   struct Entry
   {
-    Entry()
-      : m_CString( NULL )
-      , m_RefCount( 0 )
-    {}
+    std::atomic< int >      m_RefCount;     // Always 0 if MOJO_ID_REFCOUNT is 0
+    std::atomic< uint32_t > m_Epoch;        // Last interned or marked
+    std::atomic< uint32_t > m_DenseIndex;   // 0 until a MojoIndexId is made. See MojoIndexId
+    uint32_t            m_RetiredBatch; // Shard's m_RetiredBatch when last retired. 0 if never
+    Block*              m_Block;
+    const char*         m_CString;      // Follows the entry in the same block
+  };
+
+  struct Slot
+  {
+    std::atomic< uint64_t > m_Hash;     // 0 if never used. Stays set after removal, so lookups keep probing past it
+    std::atomic< Entry* >   m_Entry;    // NULL if the entry was removed
+  };
+
+  struct Table
+  {
+    int                 m_Capacity;     // Power of two
+    int                 m_UsedCount;    // Slots with m_Hash set, including removed entries
+    Table*              m_Retired;      // Tables that this one replaced. Freed by Trim() or Destroy()
+    Slot*               m_Slots;
+  };
 
-    const char* m_CString;
-    int         m_RefCount;
+  struct SnapshotHeader
+  {
+    char                m_Magic[ 8 ];
+    uint32_t            m_Version;
+    uint32_t            m_HashFunction;   // MOJO_WIDE_STRING_HASH at the time of writing
+    uint32_t            m_Count;
+    uint32_t            m_SlotCount;      // Power of two
+    uint64_t            m_StringsSize;    // The strings follow the slots
+  };
+
+  struct SnapshotSlot
+  {
+    uint64_t            m_Hash;           // 0 if unused
+    uint32_t            m_Offset;         // Into the strings
+    uint32_t            m_Length;
+  };
+
+  struct DenseTable
+  {
+    uint32_t                  m_Capacity;
+    DenseTable*               m_Retired;    // Tables that this one replaced. Freed by Trim() or Destroy()
+    std::atomic< uint64_t >*  m_Hashes;     // Hash code for each dense index. 0 if unused
+  };
+
+  struct IndexEntry
+  {
+    uint64_t            m_Hash;
+    const char*         m_CString;        // NULL in the log if the string was removed
+    int                 m_Order;          // Position in the log
+  };
+
+  struct IndexList
+  {
+    IndexEntry*         m_Entries;
+    int                 m_Count;
+    int                 m_Capacity;
+  };
+
+  struct Shard
+  {
+    std::mutex              m_Lock;
+    std::atomic< Table* >   m_Table;
+    std::atomic< int >      m_Count;
+    Block*                  m_Blocks;         // All blocks that hold entries
+    Block*                  m_CurrentBlock;   // Block that new entries go into
+    Block*                  m_SpareBlock;     // Empty block kept for reuse
+    size_t                  m_StringBytes;
+    uint64_t                m_InsertCount;    // Counters are only touched under the lock, except the atomic ones
+    uint64_t                m_NewCount;
+    uint64_t                m_FreeCount;
+    uint64_t                m_ReviveCount;
+    uint64_t*               m_Retired;        // Hash codes of retired entries. The older batch comes first
+    int                     m_RetiredCount;
+    int                     m_RetiredCapacity;
+    int                     m_RetiredOlderCount;
+    uint32_t                m_RetiredBatch;   // Number of the current batch, from 1
+#if MOJO_ID_STATS
+    std::atomic< uint64_t > m_IncRefCount;
+    std::atomic< uint64_t > m_DecRefCount;
+#endif
+    char                    m_Padding[ 64 ];  // Keep the locks of neighboring shards out of each other's cache line
   };
 
   uint64_t Insert( const char* c_string );
+  uint64_t Insert( const char* chars, int length, uint64_t hash_code, MojoStatus* status = NULL );
+  MojoStatus InsertMany( const MojoStringView* strings, int count, uint64_t* hash_codes );
+  uint64_t InsertLocked( Shard& shard, const char* chars, int length, uint64_t hash_code, MojoStatus* status );
+  bool FindInSnapshot( const char* chars, int length, uint64_t hash_code, MojoStatus* status );
   void DecRefCount( uint64_t hash_code );
   void IncRefCount( uint64_t hash_code );
   const char* Find( uint64_t hash_code ) const;
+  const char* FindInSnapshot( uint64_t hash_code ) const;
+  int FindSnapshotSlot( uint64_t hash_code ) const;
+  void UnmapSnapshot();
+
+  static int GetShardIndex( uint64_t hash_code );
+  Shard& GetShard( uint64_t hash_code );
+  const Shard& GetShard( uint64_t hash_code ) const;
+  Entry* FindEntry( const Shard& shard, uint64_t hash_code ) const;
+  void RemoveEntry( Shard& shard, Slot* slot, Entry* entry );
+  Slot* FindSlot( Table* table, uint64_t hash_code ) const;
+  Table* NewTable( int capacity );
+  bool IsTableFull( const Table* table, int add_count ) const;
+  int GetTableCapacity( int capacity, int count ) const;
+  bool Grow( Shard& shard, int add_count );
+  void FreeTables( Table* table );
+  Entry* NewEntry( Shard& shard, const char* chars, int length );
+  void FreeEntry( Shard& shard, Entry* entry );
+  Block* NewBlock( Shard& shard, int size );
+  void FreeBlock( Shard& shard, Block* block );
+  void FreeBlocks( Shard& shard );
+  void LogIndex( uint64_t hash_code, const char* c_string );
+  void AppendIndexLog( uint64_t hash_code, const char* c_string );
+  MojoStatus UpdateIndex();
+  void FindIndexRange( const char* prefix, int* first, int* end ) const;
+  bool AcquireIndexed( uint64_t hash_code );
+  bool ReserveIndexList( IndexList& list, int count );
+  static int CompareIndexLog( const void* a, const void* b );
+  static int CompareIndexString( const void* a, const void* b );
+  uint32_t FindDenseIndex( uint64_t hash_code );
+  uint64_t FindDenseHash( uint32_t index ) const;
+  uint32_t AcquireDenseIndex( uint64_t hash_code );
+  void ReleaseDenseIndex( uint32_t index );
+  void FreeDense();
+  void FreeDenseTables();
+  void SampleHot( uint64_t hash_code, const char* c_string );
+  void RetireEntry( Shard& shard, Slot* slot, Entry* entry );
+  int ReclaimRetired( Shard& shard, bool all );
+  void FreeRetired( Shard& shard );
 
-  MojoMap< MojoHash< uint64_t >, Entry >  m_HashMap;
+  Shard                                   m_Shards[ kMojoIdManagerShardCount ];
+  MojoConfig                              m_Config;
+  std::atomic< uint32_t >                 m_Epoch;
+  std::atomic< int >                      m_CollisionCount;
+  const SnapshotHeader*                   m_Snapshot;       // NULL if no snapshot is loaded
+  size_t                                  m_SnapshotSize;
+  std::mutex                              m_IndexLock;
+  std::atomic< bool >                     m_Indexed;
+  std::atomic< int >                      m_IndexChangeCount;
+  MojoStatus                              m_IndexStatus;    // Set if the log could not grow. Queries report it
+  IndexList                               m_Index;          // Sorted by string
+  IndexList                               m_IndexLog;       // Added and removed since the last query
+  std::mutex                              m_DenseLock;
+  std::atomic< DenseTable* >              m_DenseTable;
+  std::atomic< uint32_t >                 m_DenseCount;     // Indices issued, including the Null index 0
+  uint32_t*                               m_DenseFree;      // Indices of removed strings, for reuse
+  int                                     m_DenseFreeCount;
+  int                                     m_DenseFreeCapacity;
+  int                                     m_DenseLiveCount;
+  std::atomic< std::atomic< uint32_t >* > m_SnapshotDense;  // Dense index per snapshot slot, assigned on first use
+  mutable std::mutex                      m_HotLock;
+  std::atomic< int >                      m_HotSampleRate;
+  std::atomic< int >                      m_ReclaimBatch;
+  int                                     m_HotCount;
+  MojoIdHotEntry                          m_Hot[ kMojoIdHotCount ];
   MojoAlloc*                              m_Alloc;
   MojoStatus                               m_Status;
 
   friend class MojoId;
+  friend class MojoIndexId;
 };
 
 /**
@@ -93,4 +469,3 @@ private:
  */
 extern MojoIdManager g_MojoIdManager;
 
-
@@ -0,0 +1,98 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+#pragma once
+
+// -- Standard Libs
+#include <string.h>
+
+// -- Mojo
+#include "MojoAbstractSet.h"
+#include "MojoCollector.h"
+#include "MojoId.h"
+#include "MojoIdManager.h"
+
+/**
+ \class MojoIdPrefixSet
+ \ingroup group_id
+ The set of all ids whose string starts with a given prefix. It enumerates in sorted string order, from the ordered
+ index of the dictionary, so g_MojoIdManager.CreateIndex() must have been called. Contains() works without the index.
+ \code
+ MojoIdPrefixSet characters( "char/" );
+ MojoIntersection< MojoId > loaded_characters( &characters, &loaded_assets );
+ loaded_characters.Enumerate( MojoArrayCollector< MojoId >( &listing ) );
+ \endcode
+ */
+class MojoIdPrefixSet final : public MojoAbstractSet< MojoId >
+{
+public:
+  /**
+   Construct for a prefix.
+   \param[in] prefix The prefix. Not copied, so it must outlive the set. An empty prefix matches every id.
+   */
+  MojoIdPrefixSet( const char* prefix = "" );
+  virtual bool Contains( const MojoId& key ) const override;
+  virtual void Enumerate( const MojoCollector< MojoId >& collector,
+                          const MojoAbstractSet< MojoId >* limit = NULL ) const override;
+  /** \private */
+  virtual int _GetEnumerationCost() const override;
+  /** \private */
+  virtual int _GetChangeCount() const override;
+
+private:
+  const char* m_Prefix;
+  size_t      m_PrefixLength;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+inline MojoIdPrefixSet::MojoIdPrefixSet( const char* prefix )
+: m_Prefix( prefix )
+, m_PrefixLength( strlen( prefix ) )
+{
+}
+
+inline bool MojoIdPrefixSet::Contains( const MojoId& key ) const
+{
+  const char* c_string = key.AsCString();
+  return c_string && strncmp( c_string, m_Prefix, m_PrefixLength ) == 0;
+}
+
+inline void MojoIdPrefixSet::Enumerate( const MojoCollector< MojoId >& collector,
+                                        const MojoAbstractSet< MojoId >* limit ) const
+{
+  g_MojoIdManager.EnumeratePrefix( m_Prefix, collector, limit );
+}
+
+inline int MojoIdPrefixSet::_GetEnumerationCost() const
+{
+  return g_MojoIdManager.CountPrefix( m_Prefix );
+}
+
+inline int MojoIdPrefixSet::_GetChangeCount() const
+{
+  return g_MojoIdManager.GetIndexChangeCount();
+}
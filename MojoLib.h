@@ -29,22 +29,31 @@
 #include "MojoConstants.h"
 #include "MojoStatus.h"
 #include "MojoUtil.h"
+#include "MojoQsbr.h"
 #include "MojoAlloc.h"
+#include "MojoArenaAlloc.h"
+#include "MojoPoolAlloc.h"
+#include "MojoHugePageAlloc.h"
 #include "MojoConfig.h"
 #include "MojoSet.h"
 
 // -- Containers
 #include "MojoKeyValue.h"
 #include "MojoCollector.h"
+#include "MojoCtrl.h"
 #include "MojoSet.h"
 #include "MojoMap.h"
 #include "MojoMultiMap.h"
+#include "MojoPooledMultiMap.h"
+#include "MojoConcurrentMap.h"
+#include "MojoSnapshot.h"
 #include "MojoArray.h"
 #include "MojoRelation.h"
 
 // -- Id
 #include "MojoId.h"
 #include "MojoIdManager.h"
+#include "MojoIdPrefixSet.h"
 
 // -- Boolean Sets
 #include "MojoAbstractSet.h"
@@ -27,10 +27,12 @@
 
 // -- Standard Libs
 #include <stdint.h>
+#include <limits.h>
 #include <new>
 
 // -- Mojo
 #include "MojoStatus.h"
+#include "MojoConstants.h"
 #include "MojoAlloc.h"
 
 #include "MojoConfig.h"
@@ -39,6 +41,7 @@
 #include "MojoAbstractSet.h"
 #include "MojoCollector.h"
 #include "MojoKeyValue.h"
+#include "MojoCtrl.h"
 
 /**
  \class MojoMap
@@ -121,6 +124,25 @@ public:
    */
   MojoStatus Insert( const key_T& key, const value_T& value );
 
+  /**
+   Make room for a number of key-value pairs, so that inserting up to that many pairs in total will not resize the
+   table again. The table never shrinks here. Note that removing pairs may still shrink it, if MojoConfig::m_AutoShrink
+   is set.
+   \param[in] count Number of key-value pairs the map should be able to hold.
+   \return Status code. kMojoStatus_CouldNotAlloc if dynamic allocation is not allowed and the table is too small.
+   */
+  MojoStatus Reserve( int count );
+
+  /**
+   Insert many key-value pairs at once. The table is resized once up front, instead of growing step by step as pairs
+   are added.
+   \param[in] keys Keys of the key-value pairs to insert.
+   \param[in] values Values of the key-value pairs to insert, one for each key. Existing values are overwritten.
+   \param[in] count Number of key-value pairs.
+   \return Status code. If any pair failed to insert, the status of the first failure.
+   */
+  MojoStatus InsertRange( const key_T* keys, const value_T* values, int count );
+
   /**
    Remove key-value pair from the map.
    \param[in] key Key of the key-value pair to remove.
@@ -151,6 +173,23 @@ public:
    */
   virtual bool Contains( const key_T& key ) const override;
 
+  /**
+   Find the values of many keys at once. This is faster than calling Find() for each key, because the keys are hashed
+   and their slots fetched from memory in batches, so that the cache misses overlap.
+   \param[in] keys Keys to seach for.
+   \param[in] count Number of keys.
+   \param[out] out Receives, for each key, the value paired with it, or not_found_value.
+   */
+  void FindMany( const key_T* keys, int count, value_T* out ) const;
+
+  /**
+   Test presence of many keys at once. Batched like FindMany().
+   \param[in] keys Keys to seach for.
+   \param[in] count Number of keys.
+   \param[out] out Receives, for each key, true if it is in the map.
+   */
+  virtual void ContainsMany( const key_T* keys, int count, bool* out ) const override;
+
   /**
    Square bracket operator is an alias for Find()
    */
@@ -159,6 +198,7 @@ public:
   /**
    Update table sizes, if needed. This is only useful if the config specified no dynamic memory allocation. If dynamic
    memory allocation is allowed, tables are resized as needed during Insert() or Remove(), and Update() is unnecessary.
+   During an incremental resize (see MojoConfig::m_ResizeStepCount), each call also migrates part of the old table.
    \return Status code.
    */
   MojoStatus Update();
@@ -238,6 +278,8 @@ private:
   MojoAlloc*          m_Alloc;
   const char*         m_Name;
   KeyValue*           m_KeyValues;
+  uint8_t*            m_Ctrl;           // One control byte per slot. NULL when using a fixed array
+  uint64_t*           m_Hashes;         // Hash code per slot, if m_CacheHash. NULL otherwise
   value_T             m_NotFoundValue;
   int                 m_ActiveCount;    // Number of key/values in play
   int                 m_AllocCount;     // Entries allocated
@@ -245,6 +287,14 @@ private:
   int                 m_ChangeCount;
   MojoStatus           m_Status;
 
+  KeyValue*           m_OldKeyValues;   // Table being migrated during an incremental resize. NULL otherwise
+  uint8_t*            m_OldCtrl;
+  uint64_t*           m_OldHashes;
+  int                 m_OldActiveCount; // Keys left in the old table
+  int                 m_OldAllocCount;
+  int                 m_OldTableCount;
+  int                 m_MigrateIndex;   // Next slot of the old table to migrate
+
   int                 m_AllocCountMin;
   int                 m_TableCountMin;
   int                 m_GrowThreshold;
@@ -252,6 +302,9 @@ private:
   bool                m_AutoGrow;
   bool                m_AutoShrink;
   bool                m_DynamicAlloc;
+  bool                m_RobinHood;
+  int                 m_ResizeStepCount;
+  bool                m_CacheHash;
 
   void Init();
   void Grow();
@@ -259,9 +312,30 @@ private:
   void AutoGrow();
   void AutoShrink();
   void Resize( int new_table_count, int new_capacity );
+  MojoStatus Add( const key_T& key, const value_T& value );
   int FindEmptyOrMatching( const key_T& key ) const;
+  int FindEmptyOrMatching( const key_T& key, uint64_t hash ) const;
+  value_T* FindValue( const key_T& key, uint64_t hash ) const;
+  void Prefetch( uint64_t hash ) const;
   int FindEmpty( const key_T& key ) const;
   void Reinsert( int index );
+  void SetSlotHash( int index, uint64_t hash );
+  uint64_t GetSlotHash( int index ) const;
+  void ClearCtrl( int index );
+  void ResetCtrl();
+  int GetDistance( int index ) const;
+  void MoveSlot( int to_index, int from_index );
+  int MakeRoom( uint64_t hash, int empty_index );
+  void ShiftBackward( int index );
+  void SortClusters();
+  int GetEndIndex() const;
+  int FindInOld( const key_T& key, uint64_t hash ) const;
+  void Migrate( int slot_count );
+  void MigrateKey( const key_T& key, uint64_t hash );
+  void MigrateSlot( int old_index );
+  void Place( const KeyValue& key_value, uint64_t hash );
+  void FreeOldTable();
+  size_t GetTableSize( int alloc_count, size_t* hash_offset = NULL, size_t* ctrl_offset = NULL ) const;
   value_T RemoveOne( const key_T& key );
   
   void Destruct( KeyValue* table, int count );
@@ -277,11 +351,20 @@ void MojoMap< key_T, value_T >::Init()
   m_Alloc = NULL;
   m_Name = NULL;
   m_KeyValues = NULL;
+  m_Ctrl = NULL;
+  m_Hashes = NULL;
   m_TableCount = 0;
   m_AllocCount = 0;
   m_ActiveCount = 0;
   m_ChangeCount = 0;
   m_Status = kMojoStatus_NotInitialized;
+  m_OldKeyValues = NULL;
+  m_OldCtrl = NULL;
+  m_OldHashes = NULL;
+  m_OldActiveCount = 0;
+  m_OldAllocCount = 0;
+  m_OldTableCount = 0;
+  m_MigrateIndex = 0;
 }
 
 template< typename key_T, typename value_T >
@@ -330,6 +413,11 @@ MojoStatus MojoMap< key_T, value_T >::Create( const char* name, const value_T& n
     m_AutoGrow          = config->m_AutoGrow;
     m_AutoShrink        = config->m_AutoShrink;
     m_DynamicAlloc      = config->m_DynamicAlloc && m_Alloc;
+    // Robin Hood insertion and removal read probe distances from cached hash codes, so that they never rehash a key.
+    // A fixed array has no room for those, and uses plain linear probing.
+    m_RobinHood         = config->m_RobinHood && !fixed_array;
+    m_ResizeStepCount   = config->m_ResizeStepCount;
+    m_CacheHash         = config->m_CacheHash || m_RobinHood;
 
     if( !m_KeyValues )
     {
@@ -360,10 +448,12 @@ void MojoMap< key_T, value_T >::Destroy()
 template< typename key_T, typename value_T >
 void MojoMap< key_T, value_T >::Reset()
 {
+  FreeOldTable();
   for( int i = 0; i < m_TableCount; ++i )
   {
     m_KeyValues[ i ] = KeyValue();
   }
+  ResetCtrl();
   m_ActiveCount = 0;
   m_ChangeCount += 1;
   Resize( m_TableCountMin, MojoMax( m_AllocCountMin, m_TableCountMin ) );
@@ -382,21 +472,89 @@ MojoStatus MojoMap< key_T, value_T >::Insert( const key_T& key, const value_T& v
     else
     {
       AutoGrow();
+      status = Add( key, value );
+    }
+  }
+  return status;
+}
 
-      if( m_ActiveCount < m_TableCount )
+template< typename key_T, typename value_T >
+MojoStatus MojoMap< key_T, value_T >::Add( const key_T& key, const value_T& value )
+{
+  // Insert without checking whether the table needs to grow
+  MojoStatus status = kMojoStatus_Ok;
+  Migrate( m_ResizeStepCount );
+
+  if( m_ActiveCount < m_TableCount )
+  {
+    uint64_t hash = key.GetHash();
+    MigrateKey( key, hash );
+    int index = FindEmptyOrMatching( key, hash );
+    if( m_KeyValues[ index ].key.IsHashNull() )
+    {
+      if( m_RobinHood )
       {
-        int index = FindEmptyOrMatching( key );
-        if( m_KeyValues[ index ].key.IsHashNull() )
-        {
-          m_KeyValues[ index ].key = key;
-          m_ActiveCount += 1;
-          m_ChangeCount += 1;
-        }
-        m_KeyValues[ index ].value = value;
+        index = MakeRoom( hash, index );
+      }
+      m_KeyValues[ index ].key = key;
+      SetSlotHash( index, hash );
+      m_ActiveCount += 1;
+      m_ChangeCount += 1;
+    }
+    m_KeyValues[ index ].value = value;
+  }
+  else
+  {
+    status = kMojoStatus_CouldNotAlloc;
+  }
+  return status;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoMap< key_T, value_T >::Reserve( int count )
+{
+  MojoStatus status = m_Status;
+  if( !status )
+  {
+    // Double the table size until count pairs stay below the grow threshold, just like Grow() would
+    int64_t limit = ( int64_t )count * 100;
+    int new_table_count = MojoMax( m_TableCount, m_TableCountMin );
+    while( ( int64_t )new_table_count * m_GrowThreshold < limit && new_table_count <= INT_MAX / 2 )
+    {
+      new_table_count *= 2;
+    }
+    if( new_table_count > m_TableCount )
+    {
+      int new_capacity = MojoMax( m_AllocCount, new_table_count );
+      if( !m_DynamicAlloc )
+      {
+        new_capacity = m_AllocCount;
+        new_table_count = MojoMin( new_table_count, new_capacity );
       }
-      else
+      Resize( new_table_count, new_capacity );
+    }
+    if( ( int64_t )m_TableCount * m_GrowThreshold < limit )
+    {
+      status = kMojoStatus_CouldNotAlloc;
+    }
+  }
+  return status;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoMap< key_T, value_T >::InsertRange( const key_T* keys, const value_T* values, int count )
+{
+  MojoStatus status = m_Status;
+  if( !status )
+  {
+    // If the reservation fails, the table is as large as it will get. Insert what fits.
+    Reserve( m_ActiveCount + count );
+    for( int i = 0; i < count; ++i )
+    {
+      MojoStatus key_status = keys[ i ].IsHashNull() ? kMojoStatus_InvalidArguments : Add( keys[ i ], values[ i ] );
+      if( !status )
       {
-        status = kMojoStatus_CouldNotAlloc;
+        status = key_status;
       }
     }
   }
@@ -412,6 +570,7 @@ value_T MojoMap< key_T, value_T >::Remove( const key_T& key )
   }
   else
   {
+    Migrate( m_ResizeStepCount );
     int before_count = m_ActiveCount;
     value_T return_value = RemoveOne( key );
     if( before_count > m_ActiveCount )
@@ -429,6 +588,7 @@ MojoStatus MojoMap< key_T, value_T >::Update()
   MojoStatus status = m_Status;
   if( !m_Status )
   {
+    Migrate( m_ResizeStepCount );
     Grow();
     Shrink();
   }
@@ -437,41 +597,97 @@ MojoStatus MojoMap< key_T, value_T >::Update()
 
 template< typename key_T, typename value_T >
 value_T MojoMap< key_T, value_T >::Find( const key_T& key ) const
+{
+  const value_T* value = FindValue( key, key.GetHash() );
+  return value ? *value : m_NotFoundValue;
+}
+
+template< typename key_T, typename value_T >
+value_T* MojoMap< key_T, value_T >::FindForImmediateChange( const key_T& key ) const
+{
+  return FindValue( key, key.GetHash() );
+}
+
+template< typename key_T, typename value_T >
+value_T* MojoMap< key_T, value_T >::FindValue( const key_T& key, uint64_t hash ) const
 {
   if( !m_Status && !key.IsHashNull() )
   {
-    int index = FindEmptyOrMatching( key );
+    int index = FindEmptyOrMatching( key, hash );
     if( !m_KeyValues[ index ].key.IsHashNull() )
     {
-      return m_KeyValues[ index ].value;
+      return &m_KeyValues[ index ].value;
+    }
+    index = m_OldActiveCount ? FindInOld( key, hash ) : -1;
+    if( index >= 0 )
+    {
+      return &m_OldKeyValues[ index ].value;
+    }
+  }
+  return NULL;
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::FindMany( const key_T* keys, int count, value_T* out ) const
+{
+  uint64_t hashes[ kMojoLookupBatchCount ];
+  for( int batch_index = 0; batch_index < count; batch_index += kMojoLookupBatchCount )
+  {
+    int batch_count = MojoMin( count - batch_index, kMojoLookupBatchCount );
+
+    // Hash the whole batch, and get the home slots on their way in from memory
+    for( int i = 0; i < batch_count; ++i )
+    {
+      hashes[ i ] = keys[ batch_index + i ].GetHash();
+      Prefetch( hashes[ i ] );
+    }
+
+    // By now, most of them should have arrived
+    for( int i = 0; i < batch_count; ++i )
+    {
+      const value_T* value = FindValue( keys[ batch_index + i ], hashes[ i ] );
+      out[ batch_index + i ] = value ? *value : m_NotFoundValue;
     }
   }
-  return m_NotFoundValue;
 }
 
 template< typename key_T, typename value_T >
-value_T* MojoMap< key_T, value_T >::FindForImmediateChange( const key_T& key ) const
+void MojoMap< key_T, value_T >::ContainsMany( const key_T* keys, int count, bool* out ) const
 {
-  if( !m_Status && !key.IsHashNull() )
+  uint64_t hashes[ kMojoLookupBatchCount ];
+  for( int batch_index = 0; batch_index < count; batch_index += kMojoLookupBatchCount )
   {
-    int index = FindEmptyOrMatching( key );
-    if( !m_KeyValues[ index ].key.IsHashNull() )
+    int batch_count = MojoMin( count - batch_index, kMojoLookupBatchCount );
+    for( int i = 0; i < batch_count; ++i )
     {
-      return &m_KeyValues[ index ].value;
+      hashes[ i ] = keys[ batch_index + i ].GetHash();
+      Prefetch( hashes[ i ] );
+    }
+    for( int i = 0; i < batch_count; ++i )
+    {
+      out[ batch_index + i ] = FindValue( keys[ batch_index + i ], hashes[ i ] ) != NULL;
     }
   }
-  return NULL;
 }
 
 template< typename key_T, typename value_T >
-bool MojoMap< key_T, value_T >::Contains( const key_T& key ) const
+void MojoMap< key_T, value_T >::Prefetch( uint64_t hash ) const
 {
-  if( !m_Status && !key.IsHashNull() )
+  if( !m_Status )
   {
-    int index = FindEmptyOrMatching( key );
-    return !m_KeyValues[ index ].key.IsHashNull();
+    int index = hash % m_TableCount;
+    if( m_Ctrl )
+    {
+      MojoPrefetch( m_Ctrl + index );
+    }
+    MojoPrefetch( m_KeyValues + index );
   }
-  return false;
+}
+
+template< typename key_T, typename value_T >
+bool MojoMap< key_T, value_T >::Contains( const key_T& key ) const
+{
+  return FindValue( key, key.GetHash() ) != NULL;
 }
 
 template< typename key_T, typename value_T >
@@ -489,6 +705,29 @@ int MojoMap< key_T, value_T >::_GetFirstIndex() const
 template< typename key_T, typename value_T >
 int MojoMap< key_T, value_T >::_GetNextIndex( int index ) const
 {
+  if( m_Ctrl )
+  {
+    // Scan a group of control bytes at a time. Bytes past the end of the table never read as full.
+    for( int i = index + 1; i < m_TableCount; i += kMojoCtrlGroupSize )
+    {
+      uint32_t full = MojoCtrlMatchFull( m_Ctrl + i );
+      if( full )
+      {
+        return i + MojoCtrlFirst( full );
+      }
+    }
+
+    // Continue into the old table, if a resize is in progress. Its indices follow those of the new table.
+    for( int i = MojoMax( index + 1 - m_TableCount, 0 ); i < m_OldTableCount; i += kMojoCtrlGroupSize )
+    {
+      uint32_t full = MojoCtrlMatchFull( m_OldCtrl + i );
+      if( full )
+      {
+        return m_TableCount + i + MojoCtrlFirst( full );
+      }
+    }
+    return GetEndIndex();
+  }
   for( int i = index + 1; i < m_TableCount; ++i )
   {
     if( !m_KeyValues[ i ].key.IsHashNull() )
@@ -502,19 +741,19 @@ int MojoMap< key_T, value_T >::_GetNextIndex( int index ) const
 template< typename key_T, typename value_T >
 bool MojoMap< key_T, value_T >::_IsIndexValid( int index ) const
 {
-  return !m_Status && index < m_TableCount;
+  return !m_Status && index < GetEndIndex();
 }
 
 template< typename key_T, typename value_T >
 key_T MojoMap< key_T, value_T >::_GetKeyAt( int index ) const
 {
-  return m_KeyValues[ index ].key;
+  return index < m_TableCount ? m_KeyValues[ index ].key : m_OldKeyValues[ index - m_TableCount ].key;
 }
 
 template< typename key_T, typename value_T >
 value_T MojoMap< key_T, value_T >::_GetValueAt( int index ) const
 {
-  return m_KeyValues[ index ].value;
+  return index < m_TableCount ? m_KeyValues[ index ].value : m_OldKeyValues[ index - m_TableCount ].value;
 }
 
 template< typename key_T, typename value_T >
@@ -538,11 +777,21 @@ void MojoMap< key_T, value_T >::Construct( KeyValue* table, int count )
 template< typename key_T, typename value_T >
 void MojoMap< key_T, value_T >::Resize( int new_table_count, int new_capacity )
 {
+  // Finish the previous incremental resize first. No need to if we're about to throw everything away.
+  if( new_capacity )
+  {
+    Migrate( m_OldTableCount );
+  }
+  FreeOldTable();
+
   if( m_Alloc && m_AllocCount != new_capacity )
   {
     KeyValue* old_key_values = m_KeyValues;
+    uint8_t* old_ctrl = m_Ctrl;
+    uint64_t* old_hashes = m_Hashes;
     int old_alloc_count = m_AllocCount;
     int old_table_count = m_TableCount;
+    int old_active_count = m_ActiveCount;
 
     // Allocate some new memory
     m_AllocCount = new_capacity;
@@ -550,21 +799,44 @@ void MojoMap< key_T, value_T >::Resize( int new_table_count, int new_capacity )
     m_ActiveCount = 0;
     if( m_AllocCount )
     {
-      m_KeyValues = ( KeyValue* )m_Alloc->Allocate( m_AllocCount * sizeof( KeyValue ), m_Name );
+      // Cached hash codes and control bytes live in the same block, after the key-value pairs
+      size_t hash_offset;
+      size_t ctrl_offset;
+      size_t size = GetTableSize( m_AllocCount, &hash_offset, &ctrl_offset );
+      m_KeyValues = ( KeyValue* )m_Alloc->AllocateAligned( size, kMojoCacheLineSize, m_Name );
       Construct( m_KeyValues, m_AllocCount );
+      m_Hashes = m_CacheHash ? ( uint64_t* )( ( char* )m_KeyValues + hash_offset ) : NULL;
+      m_Ctrl = ( uint8_t* )m_KeyValues + ctrl_offset;
+      ResetCtrl();
     }
     else
     {
       m_KeyValues = NULL;
+      m_Ctrl = NULL;
+      m_Hashes = NULL;
     }
 
-    if( old_key_values && m_KeyValues )
+    if( old_key_values && m_KeyValues && old_active_count && m_ResizeStepCount )
+    {
+      // Keep the old table around. Its keys will be migrated a few at a time.
+      m_OldKeyValues = old_key_values;
+      m_OldCtrl = old_ctrl;
+      m_OldHashes = old_hashes;
+      m_OldActiveCount = old_active_count;
+      m_OldAllocCount = old_alloc_count;
+      m_OldTableCount = old_table_count;
+      m_MigrateIndex = 0;
+      m_ActiveCount = old_active_count;
+      old_key_values = NULL;
+    }
+    else if( old_key_values && m_KeyValues )
     {
       for( int i = 0; i < old_table_count; ++i )
       {
         if( !old_key_values[ i ].key.IsHashNull() )
         {
-          Insert( old_key_values[ i ].key, old_key_values[ i ].value );
+          Place( old_key_values[ i ], old_hashes ? old_hashes[ i ] : old_key_values[ i ].key.GetHash() );
+          m_ActiveCount += 1;
         }
       }
     }
@@ -572,7 +844,7 @@ void MojoMap< key_T, value_T >::Resize( int new_table_count, int new_capacity )
     if( old_key_values )
     {
       Destruct( old_key_values, old_alloc_count );
-      m_Alloc->Free( old_key_values );
+      m_Alloc->FreeAligned( old_key_values, GetTableSize( old_alloc_count ), kMojoCacheLineSize );
     }
   }
   else if( new_table_count < m_TableCount )
@@ -580,6 +852,7 @@ void MojoMap< key_T, value_T >::Resize( int new_table_count, int new_capacity )
     // Shrink table in place
     int old_table_count = m_TableCount;
     m_TableCount = new_table_count;
+    ResetCtrl();
 
     for( int i = 0; i < old_table_count; ++i )
     {
@@ -588,12 +861,17 @@ void MojoMap< key_T, value_T >::Resize( int new_table_count, int new_capacity )
         Reinsert( i );
       }
     }
+    if( m_RobinHood )
+    {
+      SortClusters();
+    }
   }
   else if( new_table_count > m_TableCount )
   {
     // Grow table in place
     int old_table_count = m_TableCount;
     m_TableCount = new_table_count;
+    ResetCtrl();
 
     for( int i = 0; i < old_table_count; ++i )
     {
@@ -614,13 +892,64 @@ void MojoMap< key_T, value_T >::Resize( int new_table_count, int new_capacity )
       }
       Reinsert( i );
     }
+    if( m_RobinHood )
+    {
+      SortClusters();
+    }
   }
 }
 
 template< typename key_T, typename value_T >
 int MojoMap< key_T, value_T >::FindEmptyOrMatching( const key_T& key ) const
 {
-  int start_index = key.GetHash() % m_TableCount;
+  return FindEmptyOrMatching( key, key.GetHash() );
+}
+
+template< typename key_T, typename value_T >
+int MojoMap< key_T, value_T >::FindEmptyOrMatching( const key_T& key, uint64_t hash ) const
+{
+  int start_index = hash % m_TableCount;
+
+  if( m_Ctrl )
+  {
+    // Test a whole group of control bytes at once. Keys are only compared when the hash fragment matches.
+    uint8_t ctrl = MojoCtrlFromHash( hash );
+    int index = start_index;
+    for( int probe_count = 0; probe_count < m_TableCount; )
+    {
+      const uint8_t* group = m_Ctrl + index;
+      uint32_t match = MojoCtrlMatch( group, ctrl );
+      uint32_t empty = MojoCtrlMatchEmpty( group );
+      if( empty )
+      {
+        // Anything past the first empty slot is not part of this probe sequence
+        match &= ( empty & ( 0u - empty ) ) - 1;
+      }
+      while( match )
+      {
+        int i = index + MojoCtrlFirst( match );
+        if( ( !m_Hashes || m_Hashes[ i ] == hash ) && m_KeyValues[ i ].key == key )
+        {
+          return i;
+        }
+        match &= match - 1;
+      }
+      if( empty )
+      {
+        return index + MojoCtrlFirst( empty );
+      }
+
+      // Bytes past the end of the table are neither empty nor matching, so just wrap around to the start
+      int step = MojoMin( kMojoCtrlGroupSize, m_TableCount - index );
+      probe_count += step;
+      index += step;
+      if( index == m_TableCount )
+      {
+        index = 0;
+      }
+    }
+    return 0;
+  }
 
   // Look forward to the end of the key array
   for( int i = start_index; i < m_TableCount; ++i )
@@ -673,14 +1002,17 @@ template< typename key_T, typename value_T >
 void MojoMap< key_T, value_T >::Reinsert( int index )
 {
   // Only move the entry if it is in the wrong place (due to collision)
-  int new_index = FindEmptyOrMatching( m_KeyValues[ index ].key );
+  uint64_t hash = GetSlotHash( index );
+  int new_index = FindEmptyOrMatching( m_KeyValues[ index ].key, hash );
   if( new_index != index )
   {
     // Occupy new location
     m_KeyValues[ new_index ] = m_KeyValues[ index ];
+    SetSlotHash( new_index, hash );
 
     // Vacate old location
     m_KeyValues[ index ] = KeyValue();
+    ClearCtrl( index );
   }
 }
 
@@ -692,7 +1024,9 @@ value_T MojoMap< key_T, value_T >::RemoveOne( const key_T& key )
     return m_NotFoundValue;
   }
 
-  int index = FindEmptyOrMatching( key );
+  uint64_t hash = key.GetHash();
+  MigrateKey( key, hash );
+  int index = FindEmptyOrMatching( key, hash );
   if( m_KeyValues[ index ].key.IsHashNull() )
   {
     return m_NotFoundValue;
@@ -703,8 +1037,15 @@ value_T MojoMap< key_T, value_T >::RemoveOne( const key_T& key )
 
     // Clear the slot
     m_KeyValues[ index ] = KeyValue();
+    ClearCtrl( index );
     m_ActiveCount--;
 
+    if( m_RobinHood )
+    {
+      ShiftBackward( index );
+      return return_value;
+    }
+
     // Now fix up entries after this, that may have landed there after a hash collision.
     for( int i = index + 1; i < m_TableCount; ++i )
     {
@@ -726,6 +1067,291 @@ value_T MojoMap< key_T, value_T >::RemoveOne( const key_T& key )
   }
 }
 
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::SetSlotHash( int index, uint64_t hash )
+{
+  if( m_Ctrl )
+  {
+    m_Ctrl[ index ] = MojoCtrlFromHash( hash );
+  }
+  if( m_Hashes )
+  {
+    m_Hashes[ index ] = hash;
+  }
+}
+
+template< typename key_T, typename value_T >
+uint64_t MojoMap< key_T, value_T >::GetSlotHash( int index ) const
+{
+  return m_Hashes ? m_Hashes[ index ] : m_KeyValues[ index ].key.GetHash();
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::ClearCtrl( int index )
+{
+  // Slots beyond the table (during an in-place shrink) must keep reading as kMojoCtrl_End
+  if( m_Ctrl && index < m_TableCount )
+  {
+    m_Ctrl[ index ] = kMojoCtrl_Empty;
+  }
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::ResetCtrl()
+{
+  if( m_Ctrl )
+  {
+    for( int i = 0; i < m_TableCount; ++i )
+    {
+      m_Ctrl[ i ] = m_KeyValues[ i ].key.IsHashNull() ? kMojoCtrl_Empty : MojoCtrlFromHash( GetSlotHash( i ) );
+    }
+    memset( m_Ctrl + m_TableCount, kMojoCtrl_End, m_AllocCount + kMojoCtrlGroupSize - m_TableCount );
+  }
+}
+
+template< typename key_T, typename value_T >
+int MojoMap< key_T, value_T >::GetDistance( int index ) const
+{
+  // Number of slots between the home slot of the key and where it is
+  int home = ( int )( GetSlotHash( index ) % m_TableCount );
+  return index >= home ? index - home : index + m_TableCount - home;
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::MoveSlot( int to_index, int from_index )
+{
+  m_KeyValues[ to_index ] = m_KeyValues[ from_index ];
+  if( m_Ctrl )
+  {
+    m_Ctrl[ to_index ] = m_Ctrl[ from_index ];
+  }
+  if( m_Hashes )
+  {
+    m_Hashes[ to_index ] = m_Hashes[ from_index ];
+  }
+}
+
+template< typename key_T, typename value_T >
+int MojoMap< key_T, value_T >::MakeRoom( uint64_t hash, int empty_index )
+{
+  // The new key takes the first slot whose key is closer to its home slot than the new key would be. All keys from
+  // there up to the empty slot move forward by one.
+  int index = hash % m_TableCount;
+  for( int distance = 0; index != empty_index && GetDistance( index ) >= distance; ++distance )
+  {
+    index = index + 1 < m_TableCount ? index + 1 : 0;
+  }
+  for( int i = empty_index; i != index; )
+  {
+    int prev_index = i > 0 ? i - 1 : m_TableCount - 1;
+    MoveSlot( i, prev_index );
+    i = prev_index;
+  }
+  return index;
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::ShiftBackward( int index )
+{
+  // Slot at index has just been vacated. Move the keys that follow back by one slot, until we reach an empty slot or
+  // a key that is in its home slot.
+  int next_index = index + 1 < m_TableCount ? index + 1 : 0;
+  while( !m_KeyValues[ next_index ].key.IsHashNull() && GetDistance( next_index ) > 0 )
+  {
+    MoveSlot( index, next_index );
+    index = next_index;
+    next_index = index + 1 < m_TableCount ? index + 1 : 0;
+  }
+  m_KeyValues[ index ] = KeyValue();
+  ClearCtrl( index );
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::SortClusters()
+{
+  // After an in-place resize, the entries are where linear probing would have put them. Within a run of occupied slots,
+  // Robin Hood order is simply ascending home slot, so a stable sort of each run will restore it.
+  int empty_index = 0;
+  while( empty_index < m_TableCount && !m_KeyValues[ empty_index ].key.IsHashNull() )
+  {
+    empty_index += 1;
+  }
+
+  // Start right after an empty slot, so that no run is cut in two by the end of the table.
+  int offset = 1;
+  while( empty_index < m_TableCount && offset < m_TableCount )
+  {
+    int run_start = ( empty_index + offset ) % m_TableCount;
+    int run_count = 0;
+    while( offset + run_count < m_TableCount
+           && !m_KeyValues[ ( run_start + run_count ) % m_TableCount ].key.IsHashNull() )
+    {
+      run_count += 1;
+    }
+
+    for( int i = 1; i < run_count; ++i )
+    {
+      int index = ( run_start + i ) % m_TableCount;
+      int home = i - GetDistance( index );
+      KeyValue key_value = m_KeyValues[ index ];
+      uint64_t hash = GetSlotHash( index );
+      int j = i;
+      for( ; j > 0; --j )
+      {
+        int prev_index = ( run_start + j - 1 ) % m_TableCount;
+        if( j - 1 - GetDistance( prev_index ) <= home )
+        {
+          break;
+        }
+        MoveSlot( ( run_start + j ) % m_TableCount, prev_index );
+      }
+      m_KeyValues[ ( run_start + j ) % m_TableCount ] = key_value;
+      SetSlotHash( ( run_start + j ) % m_TableCount, hash );
+    }
+    offset += run_count + 1;
+  }
+}
+
+template< typename key_T, typename value_T >
+int MojoMap< key_T, value_T >::GetEndIndex() const
+{
+  return m_TableCount + ( m_OldKeyValues ? m_OldTableCount : 0 );
+}
+
+template< typename key_T, typename value_T >
+int MojoMap< key_T, value_T >::FindInOld( const key_T& key, uint64_t hash ) const
+{
+  // Like FindEmptyOrMatching(), but in the old table. Migrated slots are marked kMojoCtrl_Deleted, and are skipped.
+  uint8_t ctrl = MojoCtrlFromHash( hash );
+  int index = hash % m_OldTableCount;
+  for( int probe_count = 0; probe_count < m_OldTableCount; )
+  {
+    const uint8_t* group = m_OldCtrl + index;
+    uint32_t match = MojoCtrlMatch( group, ctrl );
+    uint32_t empty = MojoCtrlMatchEmpty( group );
+    if( empty )
+    {
+      match &= ( empty & ( 0u - empty ) ) - 1;
+    }
+    while( match )
+    {
+      int i = index + MojoCtrlFirst( match );
+      if( ( !m_OldHashes || m_OldHashes[ i ] == hash ) && m_OldKeyValues[ i ].key == key )
+      {
+        return i;
+      }
+      match &= match - 1;
+    }
+    if( empty )
+    {
+      return -1;
+    }
+
+    int step = MojoMin( kMojoCtrlGroupSize, m_OldTableCount - index );
+    probe_count += step;
+    index += step;
+    if( index == m_OldTableCount )
+    {
+      index = 0;
+    }
+  }
+  return -1;
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::Migrate( int slot_count )
+{
+  if( m_OldKeyValues )
+  {
+    int end_index = MojoMin( m_MigrateIndex + slot_count, m_OldTableCount );
+    for( ; m_MigrateIndex < end_index && m_OldActiveCount; ++m_MigrateIndex )
+    {
+      if( MojoCtrlIsFull( m_OldCtrl[ m_MigrateIndex ] ) )
+      {
+        MigrateSlot( m_MigrateIndex );
+      }
+    }
+    if( m_MigrateIndex == m_OldTableCount || !m_OldActiveCount )
+    {
+      FreeOldTable();
+    }
+  }
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::MigrateKey( const key_T& key, uint64_t hash )
+{
+  // A key must be in the new table before it can be changed
+  if( m_OldActiveCount )
+  {
+    int old_index = FindInOld( key, hash );
+    if( old_index >= 0 )
+    {
+      MigrateSlot( old_index );
+    }
+  }
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::MigrateSlot( int old_index )
+{
+  Place( m_OldKeyValues[ old_index ],
+         m_OldHashes ? m_OldHashes[ old_index ] : m_OldKeyValues[ old_index ].key.GetHash() );
+
+  // Leave a tombstone, so that look-ups in the old table still find the keys that follow
+  m_OldKeyValues[ old_index ] = KeyValue();
+  m_OldCtrl[ old_index ] = kMojoCtrl_Deleted;
+  m_OldActiveCount -= 1;
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::Place( const KeyValue& key_value, uint64_t hash )
+{
+  // Put an entry in the table that is known not to be in it yet
+  int index = FindEmptyOrMatching( key_value.key, hash );
+  if( m_RobinHood )
+  {
+    index = MakeRoom( hash, index );
+  }
+  m_KeyValues[ index ] = key_value;
+  SetSlotHash( index, hash );
+}
+
+template< typename key_T, typename value_T >
+size_t MojoMap< key_T, value_T >::GetTableSize( int alloc_count, size_t* hash_offset, size_t* ctrl_offset ) const
+{
+  // Control bytes start on a cache line, like the block itself
+  size_t hashes = ( alloc_count * sizeof( KeyValue ) + sizeof( uint64_t ) - 1 ) & ~( sizeof( uint64_t ) - 1 );
+  size_t ctrl = m_CacheHash ? hashes + alloc_count * sizeof( uint64_t ) : alloc_count * sizeof( KeyValue );
+  ctrl = ( ctrl + kMojoCacheLineSize - 1 ) & ~( ( size_t )kMojoCacheLineSize - 1 );
+  if( hash_offset )
+  {
+    *hash_offset = hashes;
+  }
+  if( ctrl_offset )
+  {
+    *ctrl_offset = ctrl;
+  }
+  return ctrl + alloc_count + kMojoCtrlGroupSize;
+}
+
+template< typename key_T, typename value_T >
+void MojoMap< key_T, value_T >::FreeOldTable()
+{
+  if( m_OldKeyValues )
+  {
+    Destruct( m_OldKeyValues, m_OldAllocCount );
+    m_Alloc->FreeAligned( m_OldKeyValues, GetTableSize( m_OldAllocCount ), kMojoCacheLineSize );
+    m_OldKeyValues = NULL;
+    m_OldCtrl = NULL;
+    m_OldHashes = NULL;
+    m_OldActiveCount = 0;
+    m_OldAllocCount = 0;
+    m_OldTableCount = 0;
+    m_MigrateIndex = 0;
+  }
+}
+
 template< typename key_T, typename value_T >
 void MojoMap< key_T, value_T >::Grow()
 {
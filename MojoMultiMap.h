@@ -31,6 +31,7 @@
 
 // -- Mojo
 #include "MojoStatus.h"
+#include "MojoConstants.h"
 #include "MojoAlloc.h"
 
 #include "MojoConfig.h"
@@ -38,6 +39,7 @@
 #include "MojoArray.h"
 #include "MojoAbstractSet.h"
 #include "MojoKeyValue.h"
+#include "MojoCtrl.h"
 
 /**
  \class MojoMultiMap
@@ -160,9 +162,18 @@ public:
    */
   value_T operator[]( const key_T& key ) const { return Find( key ); }
   
+  /**
+   Get the number of values of a key. This visits every value of the key. See MojoPooledMultiMap if you need this to be
+   fast.
+   \param[in] key Key to seach for.
+   \return Number of values. 0 if the key is not in the map.
+   */
+  int GetValueCount( const key_T& key ) const;
+  
   /**
    Update table sizes, if needed. This is only useful if the config specified no dynamic memory allocation. If dynamic
    memory allocation is allowed, tables are resized as needed during Insert() or Remove(), and Update() is unnecessary.
+   During an incremental resize (see MojoConfig::m_ResizeStepCount), each call also migrates part of the old table.
    \return Status code.
    */
   MojoStatus Update();
@@ -263,6 +274,8 @@ private:
   MojoAlloc*          m_Alloc;
   const char*         m_Name;
   KeyValue*           m_KeyValues;
+  uint8_t*            m_Ctrl;           // One control byte per slot. NULL when using a fixed array
+  uint64_t*           m_Hashes;         // Hash code per slot, if m_CacheHash. NULL otherwise
   value_T             m_NotFoundValue;
   int                 m_ActiveCount;    // Number of key/values in play
   int                 m_AllocCount;     // Entries allocated
@@ -270,6 +283,14 @@ private:
   int                 m_ChangeCount;
   MojoStatus           m_Status;
   
+  KeyValue*           m_OldKeyValues;   // Table being migrated during an incremental resize. NULL otherwise
+  uint8_t*            m_OldCtrl;
+  uint64_t*           m_OldHashes;
+  int                 m_OldActiveCount; // Keys left in the old table
+  int                 m_OldAllocCount;
+  int                 m_OldTableCount;
+  int                 m_MigrateIndex;   // Next slot of the old table to migrate
+  
   int                 m_AllocCountMin;
   int                 m_TableCountMin;
   int                 m_GrowThreshold;
@@ -277,6 +298,9 @@ private:
   bool                m_AutoGrow;
   bool                m_AutoShrink;
   bool                m_DynamicAlloc;
+  bool                m_RobinHood;
+  int                 m_ResizeStepCount;
+  bool                m_CacheHash;
   
   void Init();
   void Grow();
@@ -285,9 +309,29 @@ private:
   void AutoShrink();
   void Resize( int new_table_count, int new_capacity );
   int FindEmptyOrMatching( const key_T& key ) const;
+  int FindEmptyOrMatching( const key_T& key, uint64_t hash ) const;
   int FindEmptyOrMatching( const key_T& key, const value_T& value ) const;
+  int FindEmptyOrMatching( const key_T& key, const value_T& value, uint64_t hash ) const;
   int FindEmpty( const key_T& key ) const;
   void Reinsert( int index );
+  void SetSlotHash( int index, uint64_t hash );
+  uint64_t GetSlotHash( int index ) const;
+  void ClearCtrl( int index );
+  void ResetCtrl();
+  int GetDistance( int index ) const;
+  void MoveSlot( int to_index, int from_index );
+  int MakeRoom( uint64_t hash, int empty_index );
+  void ShiftBackward( int index );
+  void SortClusters();
+  int GetEndIndex() const;
+  int FindInOld( const key_T& key, uint64_t hash ) const;
+  int FindNextInOld( const key_T& key, int old_index ) const;
+  void Migrate( int slot_count );
+  void MigrateKey( const key_T& key, uint64_t hash );
+  void MigrateSlot( int old_index );
+  void Place( const KeyValue& key_value, uint64_t hash );
+  void FreeOldTable();
+  size_t GetTableSize( int alloc_count, size_t* hash_offset = NULL, size_t* ctrl_offset = NULL ) const;
   void FixUp( int index, int count );
   bool RemoveAll( const key_T& key );
   bool RemoveOne( const key_T& key, const value_T& value );
@@ -295,6 +339,7 @@ private:
   void Destruct( KeyValue* table, int count );
   void Construct( KeyValue* table, int count );
   bool IsFirstInRun( int index ) const;
+  bool IsFirstInOldRun( int old_index ) const;
 };
 
 template< typename key_T, typename value_T >
@@ -303,11 +348,20 @@ void MojoMultiMap< key_T, value_T >::Init()
   m_Alloc = NULL;
   m_Name = NULL;
   m_KeyValues = NULL;
+  m_Ctrl = NULL;
+  m_Hashes = NULL;
   m_TableCount = 0;
   m_AllocCount = 0;
   m_ActiveCount = 0;
   m_ChangeCount = 0;
   m_Status = kMojoStatus_NotInitialized;
+  m_OldKeyValues = NULL;
+  m_OldCtrl = NULL;
+  m_OldHashes = NULL;
+  m_OldActiveCount = 0;
+  m_OldAllocCount = 0;
+  m_OldTableCount = 0;
+  m_MigrateIndex = 0;
 }
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -360,6 +414,11 @@ MojoStatus MojoMultiMap< key_T, value_T >::Create( const char* name, const value
     m_AutoGrow          = config->m_AutoGrow;
     m_AutoShrink        = config->m_AutoShrink;
     m_DynamicAlloc      = config->m_DynamicAlloc && m_Alloc;
+    // Robin Hood insertion and removal read probe distances from cached hash codes, so that they never rehash a key.
+    // A fixed array has no room for those, and uses plain linear probing.
+    m_RobinHood         = config->m_RobinHood && !fixed_array;
+    m_ResizeStepCount   = config->m_ResizeStepCount;
+    m_CacheHash         = config->m_CacheHash || m_RobinHood;
     
     if( !m_KeyValues )
     {
@@ -390,10 +449,12 @@ void MojoMultiMap< key_T, value_T >::Destroy()
 template< typename key_T, typename value_T >
 void MojoMultiMap< key_T, value_T >::Reset()
 {
+  FreeOldTable();
   for( int i = 0; i < m_TableCount; ++i )
   {
     m_KeyValues[ i ] = KeyValue();
   }
+  ResetCtrl();
   m_ActiveCount = 0;
   m_ChangeCount += 1;
   Resize( m_TableCountMin, MojoMax( m_AllocCountMin, m_TableCountMin ) );
@@ -412,14 +473,22 @@ MojoStatus MojoMultiMap< key_T, value_T >::Insert( const key_T& key, const value
     else
     {
       AutoGrow();
+      Migrate( m_ResizeStepCount );
       
       if( m_ActiveCount < m_TableCount )
       {
-        int index = FindEmptyOrMatching( key, value );
+        uint64_t hash = key.GetHash();
+        MigrateKey( key, hash );
+        int index = FindEmptyOrMatching( key, value, hash );
         if( m_KeyValues[ index ].key.IsHashNull() )
         {
+          if( m_RobinHood )
+          {
+            index = MakeRoom( hash, index );
+          }
           m_KeyValues[ index ].key = key;
           m_KeyValues[ index ].value = value;
+          SetSlotHash( index, hash );
           m_ActiveCount += 1;
           m_ChangeCount += 1;
         }
@@ -442,6 +511,7 @@ MojoStatus MojoMultiMap< key_T, value_T >::Remove( const key_T& key )
   }
   else if( !key.IsHashNull() )
   {
+    Migrate( m_ResizeStepCount );
     if( RemoveAll( key ) )
     {
       m_ChangeCount += 1;
@@ -461,6 +531,7 @@ MojoStatus MojoMultiMap< key_T, value_T >::Remove( const key_T& key, const value
   }
   else if( !key.IsHashNull() )
   {
+    Migrate( m_ResizeStepCount );
     if( RemoveOne( key, value ) )
     {
       m_ChangeCount += 1;
@@ -471,12 +542,24 @@ MojoStatus MojoMultiMap< key_T, value_T >::Remove( const key_T& key, const value
   return kMojoStatus_NotFound;
 }
 
+template< typename key_T, typename value_T >
+int MojoMultiMap< key_T, value_T >::GetValueCount( const key_T& key ) const
+{
+  int count = 0;
+  for( int i = _GetFirstIndexOf( key ); _IsIndexValidOf( key, i ); i = _GetNextIndexOf( key, i ) )
+  {
+    count += 1;
+  }
+  return count;
+}
+
 template< typename key_T, typename value_T >
 MojoStatus MojoMultiMap< key_T, value_T >::Update()
 {
   MojoStatus status = m_Status;
   if( !m_Status )
   {
+    Migrate( m_ResizeStepCount );
     Grow();
     Shrink();
   }
@@ -488,11 +571,17 @@ value_T MojoMultiMap< key_T, value_T >::Find( const key_T& key ) const
 {
   if( !m_Status && !key.IsHashNull() )
   {
-    int index = FindEmptyOrMatching( key );
+    uint64_t hash = key.GetHash();
+    int index = FindEmptyOrMatching( key, hash );
     if( !m_KeyValues[ index ].key.IsHashNull() )
     {
       return m_KeyValues[ index ].value;
     }
+    index = m_OldActiveCount ? FindInOld( key, hash ) : -1;
+    if( index >= 0 )
+    {
+      return m_OldKeyValues[ index ].value;
+    }
   }
   return m_NotFoundValue;
 }
@@ -502,25 +591,37 @@ int MojoMultiMap< key_T, value_T >::_GetFirstIndexOf( const key_T& key ) const
 {
   if( !m_Status && !key.IsHashNull() )
   {
-    int index = FindEmptyOrMatching( key );
+    uint64_t hash = key.GetHash();
+    int index = FindEmptyOrMatching( key, hash );
     if( !m_KeyValues[ index ].key.IsHashNull() )
     {
       return index;
     }
+    index = m_OldActiveCount ? FindInOld( key, hash ) : -1;
+    if( index >= 0 )
+    {
+      return m_TableCount + index;
+    }
   }
-  return m_TableCount;
+  return GetEndIndex();
 }
 
 template< typename key_T, typename value_T >
 int MojoMultiMap< key_T, value_T >::_GetNextIndexOf( const key_T& key, int index ) const
 {
+  if( !m_Status && !key.IsHashNull() && index >= m_TableCount )
+  {
+    // A key lives in one table only. If we're in the old table, we stay there.
+    int old_index = FindNextInOld( key, index - m_TableCount );
+    return old_index >= 0 ? m_TableCount + old_index : GetEndIndex();
+  }
   if( !m_Status && !key.IsHashNull() )
   {
     for( int i = index + 1; i < m_TableCount; ++i )
     {
       if( m_KeyValues[ i ].key.IsHashNull() )
       {
-        return m_TableCount;
+        return GetEndIndex();
       }
       if( m_KeyValues[ i ].key == key )
       {
@@ -532,7 +633,7 @@ int MojoMultiMap< key_T, value_T >::_GetNextIndexOf( const key_T& key, int index
     {
       if( m_KeyValues[ i ].key.IsHashNull() )
       {
-        return m_TableCount;
+        return GetEndIndex();
       }
       if( m_KeyValues[ i ].key == key )
       {
@@ -540,7 +641,7 @@ int MojoMultiMap< key_T, value_T >::_GetNextIndexOf( const key_T& key, int index
       }
     }
   }
-  return m_TableCount;
+  return GetEndIndex();
 }
 
 template< typename key_T, typename value_T >
@@ -548,8 +649,9 @@ bool MojoMultiMap< key_T, value_T >::Contains( const key_T& key ) const
 {
   if( !m_Status && !key.IsHashNull() )
   {
-    int index = FindEmptyOrMatching( key );
-    return !m_KeyValues[ index ].key.IsHashNull();
+    uint64_t hash = key.GetHash();
+    int index = FindEmptyOrMatching( key, hash );
+    return !m_KeyValues[ index ].key.IsHashNull() || ( m_OldActiveCount && FindInOld( key, hash ) >= 0 );
   }
   return false;
 }
@@ -559,8 +661,19 @@ bool MojoMultiMap< key_T, value_T >::Contains( const key_T& key, const value_T&
 {
   if( !m_Status && !key.IsHashNull() )
   {
-    int index = FindEmptyOrMatching( key, value );
-    return !m_KeyValues[ index ].key.IsHashNull();
+    uint64_t hash = key.GetHash();
+    int index = FindEmptyOrMatching( key, value, hash );
+    if( !m_KeyValues[ index ].key.IsHashNull() )
+    {
+      return true;
+    }
+    for( index = m_OldActiveCount ? FindInOld( key, hash ) : -1; index >= 0; index = FindNextInOld( key, index ) )
+    {
+      if( m_OldKeyValues[ index ].value == value )
+      {
+        return true;
+      }
+    }
   }
   return false;
 }
@@ -612,6 +725,39 @@ bool MojoMultiMap< key_T, value_T >::IsFirstInRun( int index ) const
 template< typename key_T, typename value_T >
 int MojoMultiMap< key_T, value_T >::_GetNextIndex( int index ) const
 {
+  if( m_Ctrl )
+  {
+    // Scan a group of control bytes at a time. Bytes past the end of the table never read as full.
+    for( int i = index + 1; i < m_TableCount; i += kMojoCtrlGroupSize )
+    {
+      uint32_t full = MojoCtrlMatchFull( m_Ctrl + i );
+      while( full )
+      {
+        int j = i + MojoCtrlFirst( full );
+        if( IsFirstInRun( j ) )
+        {
+          return j;
+        }
+        full &= full - 1;
+      }
+    }
+    
+    // Continue into the old table, if a resize is in progress. Its indices follow those of the new table.
+    for( int i = MojoMax( index + 1 - m_TableCount, 0 ); i < m_OldTableCount; i += kMojoCtrlGroupSize )
+    {
+      uint32_t full = MojoCtrlMatchFull( m_OldCtrl + i );
+      while( full )
+      {
+        int j = i + MojoCtrlFirst( full );
+        if( IsFirstInOldRun( j ) )
+        {
+          return m_TableCount + j;
+        }
+        full &= full - 1;
+      }
+    }
+    return GetEndIndex();
+  }
   for( int i = index + 1; i < m_TableCount; ++i )
   {
     if( !m_KeyValues[ i ].key.IsHashNull() && IsFirstInRun( i ) )
@@ -625,19 +771,19 @@ int MojoMultiMap< key_T, value_T >::_GetNextIndex( int index ) const
 template< typename key_T, typename value_T >
 bool MojoMultiMap< key_T, value_T >::_IsIndexValid( int index ) const
 {
-  return !m_Status && index < m_TableCount;
+  return !m_Status && index < GetEndIndex();
 }
 
 template< typename key_T, typename value_T >
 key_T MojoMultiMap< key_T, value_T >::_GetKeyAt( int index ) const
 {
-  return m_KeyValues[ index ].key;
+  return index < m_TableCount ? m_KeyValues[ index ].key : m_OldKeyValues[ index - m_TableCount ].key;
 }
 
 template< typename key_T, typename value_T >
 value_T MojoMultiMap< key_T, value_T >::_GetValueAt( int index ) const
 {
-  return m_KeyValues[ index ].value;
+  return index < m_TableCount ? m_KeyValues[ index ].value : m_OldKeyValues[ index - m_TableCount ].value;
 }
 
 template< typename key_T, typename value_T >
@@ -661,11 +807,21 @@ void MojoMultiMap< key_T, value_T >::Construct( KeyValue* table, int count )
 template< typename key_T, typename value_T >
 void MojoMultiMap< key_T, value_T >::Resize( int new_table_count, int new_capacity )
 {
+  // Finish the previous incremental resize first. No need to if we're about to throw everything away.
+  if( new_capacity )
+  {
+    Migrate( m_OldTableCount );
+  }
+  FreeOldTable();
+  
   if( m_Alloc && m_AllocCount != new_capacity )
   {
     KeyValue* old_key_values = m_KeyValues;
+    uint8_t* old_ctrl = m_Ctrl;
+    uint64_t* old_hashes = m_Hashes;
     int old_alloc_count = m_AllocCount;
     int old_table_count = m_TableCount;
+    int old_active_count = m_ActiveCount;
     
     // Allocate some new memory
     m_AllocCount = new_capacity;
@@ -673,21 +829,44 @@ void MojoMultiMap< key_T, value_T >::Resize( int new_table_count, int new_capaci
     m_ActiveCount = 0;
     if( m_AllocCount )
     {
-      m_KeyValues = ( KeyValue* )m_Alloc->Allocate( m_AllocCount * sizeof( KeyValue ), m_Name );
+      // Cached hash codes and control bytes live in the same block, after the key-value pairs
+      size_t hash_offset;
+      size_t ctrl_offset;
+      size_t size = GetTableSize( m_AllocCount, &hash_offset, &ctrl_offset );
+      m_KeyValues = ( KeyValue* )m_Alloc->AllocateAligned( size, kMojoCacheLineSize, m_Name );
       Construct( m_KeyValues, m_AllocCount );
+      m_Hashes = m_CacheHash ? ( uint64_t* )( ( char* )m_KeyValues + hash_offset ) : NULL;
+      m_Ctrl = ( uint8_t* )m_KeyValues + ctrl_offset;
+      ResetCtrl();
     }
     else
     {
       m_KeyValues = NULL;
+      m_Ctrl = NULL;
+      m_Hashes = NULL;
     }
     
-    if( old_key_values && m_KeyValues )
+    if( old_key_values && m_KeyValues && old_active_count && m_ResizeStepCount )
+    {
+      // Keep the old table around. Its keys will be migrated a few at a time.
+      m_OldKeyValues = old_key_values;
+      m_OldCtrl = old_ctrl;
+      m_OldHashes = old_hashes;
+      m_OldActiveCount = old_active_count;
+      m_OldAllocCount = old_alloc_count;
+      m_OldTableCount = old_table_count;
+      m_MigrateIndex = 0;
+      m_ActiveCount = old_active_count;
+      old_key_values = NULL;
+    }
+    else if( old_key_values && m_KeyValues )
     {
       for( int i = 0; i < old_table_count; ++i )
       {
         if( !old_key_values[ i ].key.IsHashNull() )
         {
-          Insert( old_key_values[ i ].key, old_key_values[ i ].value );
+          Place( old_key_values[ i ], old_hashes ? old_hashes[ i ] : old_key_values[ i ].key.GetHash() );
+          m_ActiveCount += 1;
         }
       }
     }
@@ -695,7 +874,7 @@ void MojoMultiMap< key_T, value_T >::Resize( int new_table_count, int new_capaci
     if( old_key_values )
     {
       Destruct( old_key_values, old_alloc_count );
-      m_Alloc->Free( old_key_values );
+      m_Alloc->FreeAligned( old_key_values, GetTableSize( old_alloc_count ), kMojoCacheLineSize );
     }
   }
   else if( new_table_count < m_TableCount )
@@ -703,6 +882,7 @@ void MojoMultiMap< key_T, value_T >::Resize( int new_table_count, int new_capaci
     // Shrink table in place
     int old_table_count = m_TableCount;
     m_TableCount = new_table_count;
+    ResetCtrl();
     
     for( int i = 0; i < old_table_count; ++i )
     {
@@ -711,12 +891,17 @@ void MojoMultiMap< key_T, value_T >::Resize( int new_table_count, int new_capaci
         Reinsert( i );
       }
     }
+    if( m_RobinHood )
+    {
+      SortClusters();
+    }
   }
   else if( new_table_count > m_TableCount )
   {
     // Grow table in place
     int old_table_count = m_TableCount;
     m_TableCount = new_table_count;
+    ResetCtrl();
     
     for( int i = 0; i < old_table_count; ++i )
     {
@@ -737,13 +922,64 @@ void MojoMultiMap< key_T, value_T >::Resize( int new_table_count, int new_capaci
       }
       Reinsert( i );
     }
+    if( m_RobinHood )
+    {
+      SortClusters();
+    }
   }
 }
 
 template< typename key_T, typename value_T >
 int MojoMultiMap< key_T, value_T >::FindEmptyOrMatching( const key_T& key ) const
 {
-  int start_index = key.GetHash() % m_TableCount;
+  return FindEmptyOrMatching( key, key.GetHash() );
+}
+
+template< typename key_T, typename value_T >
+int MojoMultiMap< key_T, value_T >::FindEmptyOrMatching( const key_T& key, uint64_t hash ) const
+{
+  int start_index = hash % m_TableCount;
+
+  if( m_Ctrl )
+  {
+    // Test a whole group of control bytes at once. Keys are only compared when the hash fragment matches.
+    uint8_t ctrl = MojoCtrlFromHash( hash );
+    int index = start_index;
+    for( int probe_count = 0; probe_count < m_TableCount; )
+    {
+      const uint8_t* group = m_Ctrl + index;
+      uint32_t match = MojoCtrlMatch( group, ctrl );
+      uint32_t empty = MojoCtrlMatchEmpty( group );
+      if( empty )
+      {
+        // Anything past the first empty slot is not part of this probe sequence
+        match &= ( empty & ( 0u - empty ) ) - 1;
+      }
+      while( match )
+      {
+        int i = index + MojoCtrlFirst( match );
+        if( ( !m_Hashes || m_Hashes[ i ] == hash ) && m_KeyValues[ i ].key == key )
+        {
+          return i;
+        }
+        match &= match - 1;
+      }
+      if( empty )
+      {
+        return index + MojoCtrlFirst( empty );
+      }
+
+      // Bytes past the end of the table are neither empty nor matching, so just wrap around to the start
+      int step = MojoMin( kMojoCtrlGroupSize, m_TableCount - index );
+      probe_count += step;
+      index += step;
+      if( index == m_TableCount )
+      {
+        index = 0;
+      }
+    }
+    return 0;
+  }
   
   // Look forward to the end of the key array
   for( int i = start_index; i < m_TableCount; ++i )
@@ -769,7 +1005,53 @@ int MojoMultiMap< key_T, value_T >::FindEmptyOrMatching( const key_T& key ) cons
 template< typename key_T, typename value_T >
 int MojoMultiMap< key_T, value_T >::FindEmptyOrMatching( const key_T& key, const value_T& value ) const
 {
-  int start_index = key.GetHash() % m_TableCount;
+  return FindEmptyOrMatching( key, value, key.GetHash() );
+}
+
+template< typename key_T, typename value_T >
+int MojoMultiMap< key_T, value_T >::FindEmptyOrMatching( const key_T& key, const value_T& value,
+                                                         uint64_t hash ) const
+{
+  int start_index = hash % m_TableCount;
+  
+  if( m_Ctrl )
+  {
+    // Same as FindEmptyOrMatching( key, hash ), but the value must match as well
+    uint8_t ctrl = MojoCtrlFromHash( hash );
+    int index = start_index;
+    for( int probe_count = 0; probe_count < m_TableCount; )
+    {
+      const uint8_t* group = m_Ctrl + index;
+      uint32_t match = MojoCtrlMatch( group, ctrl );
+      uint32_t empty = MojoCtrlMatchEmpty( group );
+      if( empty )
+      {
+        match &= ( empty & ( 0u - empty ) ) - 1;
+      }
+      while( match )
+      {
+        int i = index + MojoCtrlFirst( match );
+        if( ( !m_Hashes || m_Hashes[ i ] == hash ) && m_KeyValues[ i ].key == key && m_KeyValues[ i ].value == value )
+        {
+          return i;
+        }
+        match &= match - 1;
+      }
+      if( empty )
+      {
+        return index + MojoCtrlFirst( empty );
+      }
+      
+      int step = MojoMin( kMojoCtrlGroupSize, m_TableCount - index );
+      probe_count += step;
+      index += step;
+      if( index == m_TableCount )
+      {
+        index = 0;
+      }
+    }
+    return 0;
+  }
   
   // Look forward to the end of the key array
   for( int i = start_index; i < m_TableCount; ++i )
@@ -796,14 +1078,17 @@ template< typename key_T, typename value_T >
 void MojoMultiMap< key_T, value_T >::Reinsert( int index )
 {
   // Only move the entry if it is in the wrong place (due to collision)
-  int new_index = FindEmptyOrMatching( m_KeyValues[ index ].key, m_KeyValues[ index ].value );
+  uint64_t hash = GetSlotHash( index );
+  int new_index = FindEmptyOrMatching( m_KeyValues[ index ].key, m_KeyValues[ index ].value, hash );
   if( new_index != index )
   {
     // Occupy new location
     m_KeyValues[ new_index ] = m_KeyValues[ index ];
+    SetSlotHash( new_index, hash );
     
     // Vacate old location
     m_KeyValues[ index ] = KeyValue();
+    ClearCtrl( index );
   }
 }
 
@@ -840,8 +1125,29 @@ bool MojoMultiMap< key_T, value_T >::RemoveAll( const key_T& key )
   int before_count = m_ActiveCount;
   if( !key.IsHashNull() )
   {
-    int index = FindEmptyOrMatching( key );
-    if( !m_KeyValues[ index ].key.IsHashNull() )
+    uint64_t hash = key.GetHash();
+    MigrateKey( key, hash );
+    int index = FindEmptyOrMatching( key, hash );
+    if( m_RobinHood )
+    {
+      // Remove every matching entry with a backward shift. After a shift, the next entry is in the same slot.
+      int i = index;
+      while( !m_KeyValues[ i ].key.IsHashNull() )
+      {
+        if( m_KeyValues[ i ].key == key )
+        {
+          m_KeyValues[ i ] = KeyValue();
+          ClearCtrl( i );
+          m_ActiveCount--;
+          ShiftBackward( i );
+        }
+        else
+        {
+          i = i + 1 < m_TableCount ? i + 1 : 0;
+        }
+      }
+    }
+    else if( !m_KeyValues[ index ].key.IsHashNull() )
     {
       int count = 0;
       int i = index;
@@ -850,6 +1156,7 @@ bool MojoMultiMap< key_T, value_T >::RemoveAll( const key_T& key )
         if( m_KeyValues[ i ].key == key )
         {
           m_KeyValues[ i ] = KeyValue();
+          ClearCtrl( i );
           m_ActiveCount--;
         }
         count += 1;
@@ -867,8 +1174,19 @@ bool MojoMultiMap< key_T, value_T >::RemoveOne( const key_T& key, const value_T&
   int before_count = m_ActiveCount;
   if( !key.IsHashNull() && !value.IsHashNull() )
   {
-    int index = FindEmptyOrMatching( key );
-    if( !m_KeyValues[ index ].key.IsHashNull() )
+    MigrateKey( key, key.GetHash() );
+    int index = m_RobinHood ? FindEmptyOrMatching( key, value ) : FindEmptyOrMatching( key );
+    if( m_RobinHood )
+    {
+      if( !m_KeyValues[ index ].key.IsHashNull() )
+      {
+        m_KeyValues[ index ] = KeyValue();
+        ClearCtrl( index );
+        m_ActiveCount--;
+        ShiftBackward( index );
+      }
+    }
+    else if( !m_KeyValues[ index ].key.IsHashNull() )
     {
       int count = 0;
       int i = index;
@@ -877,6 +1195,7 @@ bool MojoMultiMap< key_T, value_T >::RemoveOne( const key_T& key, const value_T&
         if( m_KeyValues[ i ].key == key && m_KeyValues[ i ].value == value )
         {
           m_KeyValues[ i ] = KeyValue();
+          ClearCtrl( i );
           m_ActiveCount--;
         }
         count += 1;
@@ -888,6 +1207,330 @@ bool MojoMultiMap< key_T, value_T >::RemoveOne( const key_T& key, const value_T&
   return m_ActiveCount < before_count;
 }
 
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::SetSlotHash( int index, uint64_t hash )
+{
+  if( m_Ctrl )
+  {
+    m_Ctrl[ index ] = MojoCtrlFromHash( hash );
+  }
+  if( m_Hashes )
+  {
+    m_Hashes[ index ] = hash;
+  }
+}
+
+template< typename key_T, typename value_T >
+uint64_t MojoMultiMap< key_T, value_T >::GetSlotHash( int index ) const
+{
+  return m_Hashes ? m_Hashes[ index ] : m_KeyValues[ index ].key.GetHash();
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::ClearCtrl( int index )
+{
+  // Slots beyond the table (during an in-place shrink) must keep reading as kMojoCtrl_End
+  if( m_Ctrl && index < m_TableCount )
+  {
+    m_Ctrl[ index ] = kMojoCtrl_Empty;
+  }
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::ResetCtrl()
+{
+  if( m_Ctrl )
+  {
+    for( int i = 0; i < m_TableCount; ++i )
+    {
+      m_Ctrl[ i ] = m_KeyValues[ i ].key.IsHashNull() ? kMojoCtrl_Empty : MojoCtrlFromHash( GetSlotHash( i ) );
+    }
+    memset( m_Ctrl + m_TableCount, kMojoCtrl_End, m_AllocCount + kMojoCtrlGroupSize - m_TableCount );
+  }
+}
+
+template< typename key_T, typename value_T >
+int MojoMultiMap< key_T, value_T >::GetDistance( int index ) const
+{
+  // Number of slots between the home slot of the key and where it is
+  int home = ( int )( GetSlotHash( index ) % m_TableCount );
+  return index >= home ? index - home : index + m_TableCount - home;
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::MoveSlot( int to_index, int from_index )
+{
+  m_KeyValues[ to_index ] = m_KeyValues[ from_index ];
+  if( m_Ctrl )
+  {
+    m_Ctrl[ to_index ] = m_Ctrl[ from_index ];
+  }
+  if( m_Hashes )
+  {
+    m_Hashes[ to_index ] = m_Hashes[ from_index ];
+  }
+}
+
+template< typename key_T, typename value_T >
+int MojoMultiMap< key_T, value_T >::MakeRoom( uint64_t hash, int empty_index )
+{
+  // The new key takes the first slot whose key is closer to its home slot than the new key would be. All keys from
+  // there up to the empty slot move forward by one.
+  int index = hash % m_TableCount;
+  for( int distance = 0; index != empty_index && GetDistance( index ) >= distance; ++distance )
+  {
+    index = index + 1 < m_TableCount ? index + 1 : 0;
+  }
+  for( int i = empty_index; i != index; )
+  {
+    int prev_index = i > 0 ? i - 1 : m_TableCount - 1;
+    MoveSlot( i, prev_index );
+    i = prev_index;
+  }
+  return index;
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::ShiftBackward( int index )
+{
+  // Slot at index has just been vacated. Move the keys that follow back by one slot, until we reach an empty slot or
+  // a key that is in its home slot.
+  int next_index = index + 1 < m_TableCount ? index + 1 : 0;
+  while( !m_KeyValues[ next_index ].key.IsHashNull() && GetDistance( next_index ) > 0 )
+  {
+    MoveSlot( index, next_index );
+    index = next_index;
+    next_index = index + 1 < m_TableCount ? index + 1 : 0;
+  }
+  m_KeyValues[ index ] = KeyValue();
+  ClearCtrl( index );
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::SortClusters()
+{
+  // After an in-place resize, the entries are where linear probing would have put them. Within a run of occupied slots,
+  // Robin Hood order is simply ascending home slot, so a stable sort of each run will restore it.
+  int empty_index = 0;
+  while( empty_index < m_TableCount && !m_KeyValues[ empty_index ].key.IsHashNull() )
+  {
+    empty_index += 1;
+  }
+  
+  // Start right after an empty slot, so that no run is cut in two by the end of the table.
+  int offset = 1;
+  while( empty_index < m_TableCount && offset < m_TableCount )
+  {
+    int run_start = ( empty_index + offset ) % m_TableCount;
+    int run_count = 0;
+    while( offset + run_count < m_TableCount
+           && !m_KeyValues[ ( run_start + run_count ) % m_TableCount ].key.IsHashNull() )
+    {
+      run_count += 1;
+    }
+    
+    for( int i = 1; i < run_count; ++i )
+    {
+      int index = ( run_start + i ) % m_TableCount;
+      int home = i - GetDistance( index );
+      KeyValue key_value = m_KeyValues[ index ];
+      uint64_t hash = GetSlotHash( index );
+      int j = i;
+      for( ; j > 0; --j )
+      {
+        int prev_index = ( run_start + j - 1 ) % m_TableCount;
+        if( j - 1 - GetDistance( prev_index ) <= home )
+        {
+          break;
+        }
+        MoveSlot( ( run_start + j ) % m_TableCount, prev_index );
+      }
+      m_KeyValues[ ( run_start + j ) % m_TableCount ] = key_value;
+      SetSlotHash( ( run_start + j ) % m_TableCount, hash );
+    }
+    offset += run_count + 1;
+  }
+}
+
+template< typename key_T, typename value_T >
+int MojoMultiMap< key_T, value_T >::GetEndIndex() const
+{
+  return m_TableCount + ( m_OldKeyValues ? m_OldTableCount : 0 );
+}
+
+template< typename key_T, typename value_T >
+int MojoMultiMap< key_T, value_T >::FindInOld( const key_T& key, uint64_t hash ) const
+{
+  // Like FindEmptyOrMatching(), but in the old table. Migrated slots are marked kMojoCtrl_Deleted, and are skipped.
+  uint8_t ctrl = MojoCtrlFromHash( hash );
+  int index = hash % m_OldTableCount;
+  for( int probe_count = 0; probe_count < m_OldTableCount; )
+  {
+    const uint8_t* group = m_OldCtrl + index;
+    uint32_t match = MojoCtrlMatch( group, ctrl );
+    uint32_t empty = MojoCtrlMatchEmpty( group );
+    if( empty )
+    {
+      match &= ( empty & ( 0u - empty ) ) - 1;
+    }
+    while( match )
+    {
+      int i = index + MojoCtrlFirst( match );
+      if( ( !m_OldHashes || m_OldHashes[ i ] == hash ) && m_OldKeyValues[ i ].key == key )
+      {
+        return i;
+      }
+      match &= match - 1;
+    }
+    if( empty )
+    {
+      return -1;
+    }
+    
+    int step = MojoMin( kMojoCtrlGroupSize, m_OldTableCount - index );
+    probe_count += step;
+    index += step;
+    if( index == m_OldTableCount )
+    {
+      index = 0;
+    }
+  }
+  return -1;
+}
+
+template< typename key_T, typename value_T >
+int MojoMultiMap< key_T, value_T >::FindNextInOld( const key_T& key, int old_index ) const
+{
+  for( int i = 1; i < m_OldTableCount; ++i )
+  {
+    int index = ( old_index + i ) % m_OldTableCount;
+    if( m_OldCtrl[ index ] == kMojoCtrl_Empty )
+    {
+      return -1;
+    }
+    if( MojoCtrlIsFull( m_OldCtrl[ index ] ) && m_OldKeyValues[ index ].key == key )
+    {
+      return index;
+    }
+  }
+  return -1;
+}
+
+template< typename key_T, typename value_T >
+bool MojoMultiMap< key_T, value_T >::IsFirstInOldRun( int old_index ) const
+{
+  // Same as IsFirstInRun(), for the old table
+  const key_T& key = m_OldKeyValues[ old_index ].key;
+  for( int i = 1; i < m_OldTableCount; ++i )
+  {
+    int index = ( old_index + m_OldTableCount - i ) % m_OldTableCount;
+    if( m_OldCtrl[ index ] == kMojoCtrl_Empty )
+    {
+      return true;
+    }
+    if( MojoCtrlIsFull( m_OldCtrl[ index ] ) && m_OldKeyValues[ index ].key == key )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::Migrate( int slot_count )
+{
+  if( m_OldKeyValues )
+  {
+    int end_index = MojoMin( m_MigrateIndex + slot_count, m_OldTableCount );
+    for( ; m_MigrateIndex < end_index && m_OldActiveCount; ++m_MigrateIndex )
+    {
+      if( MojoCtrlIsFull( m_OldCtrl[ m_MigrateIndex ] ) )
+      {
+        // Take all values of the key along, so that each key lives in one table only
+        key_T key = m_OldKeyValues[ m_MigrateIndex ].key;
+        MigrateKey( key, m_OldHashes ? m_OldHashes[ m_MigrateIndex ] : key.GetHash() );
+      }
+    }
+    if( m_MigrateIndex == m_OldTableCount || !m_OldActiveCount )
+    {
+      FreeOldTable();
+    }
+  }
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::MigrateKey( const key_T& key, uint64_t hash )
+{
+  // A key must be in the new table before it can be changed
+  if( m_OldActiveCount )
+  {
+    for( int old_index = FindInOld( key, hash ); old_index >= 0; old_index = FindNextInOld( key, old_index ) )
+    {
+      MigrateSlot( old_index );
+    }
+  }
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::MigrateSlot( int old_index )
+{
+  Place( m_OldKeyValues[ old_index ],
+         m_OldHashes ? m_OldHashes[ old_index ] : m_OldKeyValues[ old_index ].key.GetHash() );
+  
+  // Leave a tombstone, so that look-ups in the old table still find the keys that follow
+  m_OldKeyValues[ old_index ] = KeyValue();
+  m_OldCtrl[ old_index ] = kMojoCtrl_Deleted;
+  m_OldActiveCount -= 1;
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::Place( const KeyValue& key_value, uint64_t hash )
+{
+  // Put an entry in the table that is known not to be in it yet
+  int index = FindEmptyOrMatching( key_value.key, key_value.value, hash );
+  if( m_RobinHood )
+  {
+    index = MakeRoom( hash, index );
+  }
+  m_KeyValues[ index ] = key_value;
+  SetSlotHash( index, hash );
+}
+
+template< typename key_T, typename value_T >
+size_t MojoMultiMap< key_T, value_T >::GetTableSize( int alloc_count, size_t* hash_offset, size_t* ctrl_offset ) const
+{
+  // Control bytes start on a cache line, like the block itself
+  size_t hashes = ( alloc_count * sizeof( KeyValue ) + sizeof( uint64_t ) - 1 ) & ~( sizeof( uint64_t ) - 1 );
+  size_t ctrl = m_CacheHash ? hashes + alloc_count * sizeof( uint64_t ) : alloc_count * sizeof( KeyValue );
+  ctrl = ( ctrl + kMojoCacheLineSize - 1 ) & ~( ( size_t )kMojoCacheLineSize - 1 );
+  if( hash_offset )
+  {
+    *hash_offset = hashes;
+  }
+  if( ctrl_offset )
+  {
+    *ctrl_offset = ctrl;
+  }
+  return ctrl + alloc_count + kMojoCtrlGroupSize;
+}
+
+template< typename key_T, typename value_T >
+void MojoMultiMap< key_T, value_T >::FreeOldTable()
+{
+  if( m_OldKeyValues )
+  {
+    Destruct( m_OldKeyValues, m_OldAllocCount );
+    m_Alloc->FreeAligned( m_OldKeyValues, GetTableSize( m_OldAllocCount ), kMojoCacheLineSize );
+    m_OldKeyValues = NULL;
+    m_OldCtrl = NULL;
+    m_OldHashes = NULL;
+    m_OldActiveCount = 0;
+    m_OldAllocCount = 0;
+    m_OldTableCount = 0;
+    m_MigrateIndex = 0;
+  }
+}
+
 template< typename key_T, typename value_T >
 void MojoMultiMap< key_T, value_T >::Grow()
 {
@@ -0,0 +1,255 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+// -- Self
+#include "MojoPoolAlloc.h"
+
+// -- Standard Libs
+#include <atomic>
+
+// -- Mojo
+#include "MojoUtil.h"
+
+static const int kPoolClassShiftMin = 4;
+
+static int GetThreadCacheIndex()
+{
+  // Threads take turns, so that the first kMojoPoolCacheCount threads each get a cache of their own
+  static std::atomic< int > s_NextIndex( 0 );
+  static thread_local int t_Index = s_NextIndex.fetch_add( 1, std::memory_order_relaxed ) % kMojoPoolCacheCount;
+  return t_Index;
+}
+
+MojoPoolAlloc::MojoPoolAlloc( MojoAlloc* alloc )
+: m_Chunks( NULL )
+, m_Alloc( alloc ? alloc : MojoAlloc::GetDefault() )
+{
+  for( int i = 0; i < kClassCount; ++i )
+  {
+    m_Shared[ i ].m_List = NULL;
+    for( int j = 0; j < kMojoPoolCacheCount; ++j )
+    {
+      m_Caches[ j ].m_Lists[ i ] = NULL;
+      m_Caches[ j ].m_Counts[ i ] = 0;
+    }
+  }
+}
+
+MojoPoolAlloc::~MojoPoolAlloc()
+{
+  while( m_Chunks )
+  {
+    Chunk* next = m_Chunks->m_Next;
+    m_Alloc->FreeSized( m_Chunks, m_Chunks->m_Size );
+    m_Chunks = next;
+  }
+}
+
+void* MojoPoolAlloc::Allocate( size_t byte_count, const char* name )
+{
+  int size_class = GetClass( byte_count );
+  if( size_class < 0 )
+  {
+    Header* header = ( Header* )m_Alloc->Allocate( sizeof( Header ) + byte_count, name );
+    if( !header )
+    {
+      return NULL;
+    }
+    header->m_Class = kLargeClass;
+    return header + 1;
+  }
+  
+  Cache& cache = m_Caches[ GetThreadCacheIndex() ];
+  std::lock_guard< std::mutex > lock( cache.m_Lock );
+  if( !cache.m_Lists[ size_class ] && !Refill( cache, size_class ) )
+  {
+    return NULL;
+  }
+  FreeBlock* block = cache.m_Lists[ size_class ];
+  cache.m_Lists[ size_class ] = block->m_Next;
+  cache.m_Counts[ size_class ] -= 1;
+  Header* header = ( Header* )block;
+  header->m_Class = ( uint32_t )size_class;
+  return header + 1;
+}
+
+void MojoPoolAlloc::Free( void* p )
+{
+  if( !p )
+  {
+    return;
+  }
+  Header* header = ( Header* )p - 1;
+  if( header->m_Class == kLargeClass )
+  {
+    m_Alloc->Free( header );
+    return;
+  }
+  
+  Release( header, ( int )header->m_Class );
+}
+
+void* MojoPoolAlloc::Reallocate( void* p, size_t old_byte_count, size_t byte_count, const char* name )
+{
+  if( !p )
+  {
+    return Allocate( byte_count, name );
+  }
+  int old_class = GetClass( old_byte_count );
+  int size_class = GetClass( byte_count );
+  if( size_class >= 0 && size_class == old_class )
+  {
+    return p;  // Same size class, the block already fits
+  }
+  if( size_class < 0 && old_class < 0 )
+  {
+    Header* header = ( Header* )m_Alloc->Reallocate( ( Header* )p - 1, sizeof( Header ) + old_byte_count,
+                                                     sizeof( Header ) + byte_count, name );
+    return header ? header + 1 : NULL;
+  }
+  return MojoAlloc::Reallocate( p, old_byte_count, byte_count, name );
+}
+
+void MojoPoolAlloc::FreeSized( void* p, size_t byte_count )
+{
+  if( !p )
+  {
+    return;
+  }
+  // The size gives the class, so the header does not have to be read
+  Header* header = ( Header* )p - 1;
+  int size_class = GetClass( byte_count );
+  if( size_class < 0 )
+  {
+    m_Alloc->FreeSized( header, sizeof( Header ) + byte_count );
+    return;
+  }
+  Release( header, size_class );
+}
+
+size_t MojoPoolAlloc::GetChunkSize() const
+{
+  std::lock_guard< std::mutex > lock( m_ChunkLock );
+  size_t size = 0;
+  for( const Chunk* chunk = m_Chunks; chunk; chunk = chunk->m_Next )
+  {
+    size += chunk->m_Size;
+  }
+  return size;
+}
+
+void MojoPoolAlloc::Release( Header* header, int size_class )
+{
+  Cache& cache = m_Caches[ GetThreadCacheIndex() ];
+  std::lock_guard< std::mutex > lock( cache.m_Lock );
+  FreeBlock* block = ( FreeBlock* )header;
+  block->m_Next = cache.m_Lists[ size_class ];
+  cache.m_Lists[ size_class ] = block;
+  cache.m_Counts[ size_class ] += 1;
+  if( cache.m_Counts[ size_class ] > GetCacheLimit( size_class ) )
+  {
+    Flush( cache, size_class );
+  }
+}
+
+int MojoPoolAlloc::GetClass( size_t byte_count )
+{
+  int shift = kPoolClassShiftMin;
+  while( ( ( size_t )1 << shift ) < byte_count )
+  {
+    if( ++shift > kMojoPoolClassShiftMax )
+    {
+      return -1;
+    }
+  }
+  return shift;
+}
+
+int MojoPoolAlloc::GetCacheLimit( int size_class )
+{
+  return MojoMax( kMojoPoolCacheBytes >> size_class, 2 );
+}
+
+bool MojoPoolAlloc::Refill( Cache& cache, int size_class )
+{
+  // Take half a cache worth from the shared list, if it has any
+  Shared& shared = m_Shared[ size_class ];
+  std::lock_guard< std::mutex > lock( shared.m_Lock );
+  int count = MojoMax( GetCacheLimit( size_class ) / 2, 1 );
+  for( int i = 0; i < count && shared.m_List; ++i )
+  {
+    FreeBlock* block = shared.m_List;
+    shared.m_List = block->m_Next;
+    block->m_Next = cache.m_Lists[ size_class ];
+    cache.m_Lists[ size_class ] = block;
+    cache.m_Counts[ size_class ] += 1;
+  }
+  if( cache.m_Lists[ size_class ] )
+  {
+    return true;
+  }
+  
+  // Carve a new chunk. All of its blocks go into this cache.
+  size_t stride = sizeof( Header ) + ( ( size_t )1 << size_class );
+  size_t block_count = MojoMax( ( size_t )kMojoPoolChunkSize / stride, ( size_t )1 );
+  size_t offset = ( sizeof( Chunk ) + sizeof( Header ) - 1 ) & ~( sizeof( Header ) - 1 );
+  size_t size = offset + block_count * stride;
+  Chunk* chunk = ( Chunk* )m_Alloc->Allocate( size, "MojoPoolAlloc" );
+  if( !chunk )
+  {
+    return false;
+  }
+  chunk->m_Size = size;
+  {
+    std::lock_guard< std::mutex > chunk_lock( m_ChunkLock );
+    chunk->m_Next = m_Chunks;
+    m_Chunks = chunk;
+  }
+  // The offset and the stride are multiples of the header size, so blocks are as aligned as the chunk
+  char* first = ( char* )chunk + offset;
+  for( size_t i = 0; i < block_count; ++i )
+  {
+    FreeBlock* block = ( FreeBlock* )( first + i * stride );
+    block->m_Next = cache.m_Lists[ size_class ];
+    cache.m_Lists[ size_class ] = block;
+  }
+  cache.m_Counts[ size_class ] += ( int )block_count;
+  return true;
+}
+
+void MojoPoolAlloc::Flush( Cache& cache, int size_class )
+{
+  Shared& shared = m_Shared[ size_class ];
+  std::lock_guard< std::mutex > lock( shared.m_Lock );
+  int count = cache.m_Counts[ size_class ] / 2;
+  for( int i = 0; i < count; ++i )
+  {
+    FreeBlock* block = cache.m_Lists[ size_class ];
+    cache.m_Lists[ size_class ] = block->m_Next;
+    block->m_Next = shared.m_List;
+    shared.m_List = block;
+  }
+  cache.m_Counts[ size_class ] -= count;
+}
@@ -0,0 +1,127 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+#pragma once
+
+// -- Standard Libs
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+
+// -- Mojo
+#include "MojoAlloc.h"
+#include "MojoConstants.h"
+
+/**
+ \class MojoPoolAlloc
+ \ingroup group_config
+ Thread safe pool allocator for containers that grow and shrink over and over, such as the tables of MojoSet and
+ MojoMap on worker threads.
+ - Requests are rounded up to a power of two, from 16 bytes up to 2 to the power of kMojoPoolClassShiftMax. Bigger
+ requests go straight to the backing allocator.
+ - Each thread allocates from and frees to its own cache of free lists. There are kMojoPoolCacheCount caches, and
+ threads are spread over them, so threads rarely share one. A cache that holds more than kMojoPoolCacheBytes of a size
+ class returns half of those blocks to a shared list, where other threads pick them up.
+ - Blocks are carved from chunks of kMojoPoolChunkSize bytes. Chunks are only returned to the backing allocator when
+ the pool is destroyed.
+ */
+class MojoPoolAlloc final : public MojoAlloc
+{
+public:
+  /**
+   Construct.
+   \param[in] alloc Backing allocator for chunks and for big requests. If omitted, the global default will be used. It
+   must be thread safe if the pool is used from several threads.
+   */
+  MojoPoolAlloc( MojoAlloc* alloc = NULL );
+  /**
+   Destructor. Returns all chunks to the backing allocator. Blocks that are still in use become invalid.
+   */
+  virtual ~MojoPoolAlloc();
+
+  virtual void* Allocate( size_t byte_count, const char* name ) override;
+  virtual void  Free( void* p ) override;
+  /**
+   Returns p if the new size is in the same size class. Otherwise allocates and copies.
+   */
+  virtual void* Reallocate( void* p, size_t old_byte_count, size_t byte_count, const char* name ) override;
+  /**
+   Like Free( p ), but takes the size class from byte_count instead of from the block header.
+   */
+  virtual void  FreeSized( void* p, size_t byte_count ) override;
+
+  /**
+   Get the number of bytes in all chunks, whether the blocks in them are in use or not.
+   \return Bytes held.
+   */
+  size_t GetChunkSize() const;
+
+private:
+  static const int kClassCount = kMojoPoolClassShiftMax + 1;
+  static const uint32_t kLargeClass = 0xffffffff;
+
+  struct FreeBlock
+  {
+    FreeBlock*  m_Next;
+  };
+
+  struct Header
+  {
+    uint32_t    m_Class;          // Size class, or kLargeClass
+    uint32_t    m_Padding[ 3 ];   // Keep the block 16-byte aligned
+  };
+
+  struct Chunk
+  {
+    Chunk*      m_Next;
+    size_t      m_Size;
+  };
+
+  struct Cache
+  {
+    std::mutex  m_Lock;
+    FreeBlock*  m_Lists[ kClassCount ];
+    int         m_Counts[ kClassCount ];
+    char        m_Padding[ 64 ];  // Keep the locks of neighboring caches out of each other's cache line
+  };
+
+  struct Shared
+  {
+    std::mutex  m_Lock;
+    FreeBlock*  m_List;
+  };
+
+  static int GetClass( size_t byte_count );
+  static int GetCacheLimit( int size_class );
+  void Release( Header* header, int size_class );
+  bool Refill( Cache& cache, int size_class );
+  void Flush( Cache& cache, int size_class );
+
+  Cache               m_Caches[ kMojoPoolCacheCount ];
+  Shared              m_Shared[ kClassCount ];
+  mutable std::mutex  m_ChunkLock;
+  Chunk*              m_Chunks;
+  MojoAlloc*          m_Alloc;
+};
@@ -0,0 +1,818 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+#include <new>
+#include <type_traits>
+
+// -- Mojo
+#include "MojoStatus.h"
+#include "MojoAlloc.h"
+#include "MojoConfig.h"
+#include "MojoUtil.h"
+#include "MojoAbstractSet.h"
+#include "MojoKeyValue.h"
+#include "MojoMap.h"
+#include "MojoMultiMap.h"
+
+/**
+ \class MojoPooledMultiMap
+ \ingroup group_container
+ A one-to-many hash table, like MojoMultiMap, with a different memory layout. The hash table only holds the keys. The
+ values of each key are stored next to each other in a separate pool.
+ - Visiting all values of a key is a linear scan through memory.
+ - GetValueCount() does not need to visit the values at all.
+ - Removing a key, or some of its values, does not disturb the hash table probe sequence of other keys.
+
+ The downside is some unused space in the pool, because each key reserves room for more values than it has.
+ MojoForEachKey and MojoForEachMultiValue work the same as with MojoMultiMap.
+ \tparam key_T Key type. Must be hashable.
+ \tparam value_T Value type.
+ */
+template< typename key_T, typename value_T >
+class MojoPooledMultiMap final : public MojoAbstractSet< key_T >
+{
+public:
+  /**
+   Shorthand specialization of MojoKeyValue.
+   */
+  typedef MojoKeyValue< key_T, value_T > KeyValue;
+  
+  /**
+   Default constructor. You must call Create() before the map is ready for use.
+   */
+  MojoPooledMultiMap()
+  {
+    Init();
+  }
+  
+  /**
+   Initializing constructor. No need to call Create().
+   \param[in] name The name of the map. Will also be used for internal memory allocation.
+   \param[in] not_found_value The value to return if nothing was found.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig for
+   details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global defualt will be used. See documentation for MojoAlloc for
+   details on how to set the global default.
+   */
+  MojoPooledMultiMap( const char* name, const value_T& not_found_value = value_T(), const MojoConfig* config = NULL,
+                     MojoAlloc* alloc = NULL )
+  {
+    Init();
+    Create( name, not_found_value, config, alloc );
+  }
+  
+  /**
+   Create after default constructor or Destroy().
+   \param[in] name The name of the map. Will also be used for internal memory allocation.
+   \param[in] not_found_value The value to return if nothing was found.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig for
+   details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global defualt will be used. See documentation for MojoAlloc for
+   details on how to set the global default.
+   \return Status code.
+   */
+  MojoStatus Create( const char* name, const value_T& not_found_value = value_T(), const MojoConfig* config = NULL,
+                   MojoAlloc* alloc = NULL );
+  
+  /**
+   Remove all entries and free all allocated buffers.
+   */
+  void Destroy();
+  
+  /**
+   Remove all key-value pairs.
+   */
+  void Reset();
+  
+  /**
+   Insert key-value pair into the map. If the key-value pair already exists in map, does nothing.
+   \param[in] key Key of the key-value pair to insert.
+   \param[in] value Value of the key-value pair to insert.
+   \return Status code.
+   */
+  MojoStatus Insert( const key_T& key, const value_T& value );
+  
+  /**
+   Remove all key-value pairs with given key from the map.
+   \param[in] key Key to remove.
+   \return Status code.
+   */
+  MojoStatus Remove( const key_T& key );
+  
+  /**
+   Remove key-value pair from the map.
+   \param[in] key Key of the key-value pair to remove.
+   \param[in] value Value of the key-value pair to remove.
+   \return Status code.
+   */
+  MojoStatus Remove( const key_T& key, const value_T& value );
+  
+  /**
+   Find value that is associated with the key.
+   */
+  value_T Find( const key_T& key ) const;
+  
+  /**
+   Test presence of a key.
+   \param[in] key Key to seach for.
+   \return true if key is in the map.
+   */
+  virtual bool Contains( const key_T& key ) const override;
+  
+  /**
+   Test presence of a key-value pair.
+   \param[in] key Key of the key-value pair to seach for.
+   \param[in] value Value of the key-value pair to seach for.
+   \return true if key-value pair is in the map.
+   */
+  bool Contains( const key_T& key, const value_T& value ) const;
+  
+  /**
+   Square bracket operator is an alias for Find()
+   */
+  value_T operator[]( const key_T& key ) const { return Find( key ); }
+  
+  /**
+   Get the number of values of a key.
+   \param[in] key Key to seach for.
+   \return Number of values. 0 if the key is not in the map.
+   */
+  int GetValueCount( const key_T& key ) const;
+  
+  /**
+   Update table sizes, if needed, and compact the value pool if it has many unused slots. See MojoMultiMap::Update().
+   \return Status code.
+   */
+  MojoStatus Update();
+  
+  /**
+   Return table status state. This is the only way to find out if something went wrong in the default constructor.
+   If Create() was used, the returned status code will be the same.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const;
+  
+  /**
+   Get number of key-value pairs in the map.
+   \return Number of pairs.
+   */
+  int GetCount() const;
+  
+  /**
+   Return name of the map.
+   \return Given name.
+   */
+  const char* GetName() const { return m_Name; }
+  
+  /**
+   Get index of first key in the pool. This is used for the ForEach... macros. It must be declared public to work with
+   the macros, but should be considered private.
+   \private
+   */
+  int _GetFirstIndex() const;
+  
+  /**
+   Get index of first value of a particular key. This is used for the ForEach... macros. It must be declared public to
+   work with the macros, but should be considered private.
+   \private
+   */
+  int _GetFirstIndexOf( const key_T& key ) const;
+  
+  /**
+   Get index of next key in the pool. This is used for the ForEach... macros. It must be declared public to work with
+   the macros, but should be considered private.
+   \private
+   */
+  int _GetNextIndex( int index ) const;
+  
+  /**
+   Get index of next value of the same key. This is used for the ForEach... macros. It must be declared public to work
+   with the macros, but should be considered private.
+   \private
+   */
+  int _GetNextIndexOf( const key_T& key, int index ) const;
+  
+  /**
+   Verify that pool index is in range. This is used for the ForEach... macros. It must be declared public to work with
+   the macros, but should be considered private.
+   \private
+   */
+  bool _IsIndexValid( int index ) const;
+  
+  /**
+   Verify that pool index is in range. This is used for the ForEach... macros. It must be declared public to work with
+   the macros, but should be considered private.
+   \private
+   */
+  bool _IsIndexValidOf( const key_T&, int index ) const { return _IsIndexValid( index ); }
+  
+  /**
+   Get key at a specific index in the pool. This is used for the ForEach... macros. It must be declared public to work
+   with the macros, but should be considered private.
+   \private
+   */
+  key_T _GetKeyAt( int index ) const;
+  
+  /**
+   Get value at a specific index in the pool. This is used for the ForEach... macros. It must be declared public to
+   work with the macros, but should be considered private.
+   \private
+   */
+  value_T _GetValueAt( int index ) const;
+  
+  /**
+   Get key-value pair at a specific index in the pool. This is used for the ForEach... macros. It must be declared
+   public to work with the macros, but should be considered private.
+   \private
+   */
+  KeyValue _GetKeyValueAt( int index ) const;
+  
+  virtual void Enumerate( const MojoCollector< key_T >& collector,
+                         const MojoAbstractSet< key_T >* limit = NULL ) const override;
+  /** \private */
+  virtual int _GetEnumerationCost() const override;
+  /** \private */
+  virtual int _GetChangeCount() const override;
+  
+  virtual ~MojoPooledMultiMap();
+  
+private:
+  
+  // Where the values of a key are in the pool
+  struct Run
+  {
+    Run() : m_Start( 0 ), m_Count( 0 ), m_Capacity( 0 ) {}
+    int m_Start;
+    int m_Count;
+    int m_Capacity;
+  };
+  
+  MojoAlloc*          m_Alloc;
+  const char*         m_Name;
+  MojoMap< key_T, Run > m_Runs;
+  KeyValue*           m_Pool;           // Runs of key-value pairs. Slots that are not in use have a Null key
+  value_T             m_NotFoundValue;
+  int                 m_ActiveCount;    // Number of key/values in play
+  int                 m_PoolAllocCount; // Entries allocated
+  int                 m_PoolUsedCount;  // Portion of the pool that holds runs
+  int                 m_PoolFreeCount;  // Slots within the used portion that belong to no run
+  int                 m_ChangeCount;
+  MojoStatus           m_Status;
+  
+  int                 m_AllocCountMin;
+  int                 m_ShrinkThreshold;
+  bool                m_AutoShrink;
+  bool                m_DynamicAlloc;
+  
+  void Init();
+  bool GrowRun( const key_T& key, Run* run );
+  void FreeRun( const Run& run );
+  void CompactPool();
+  void ResizePool( int new_capacity );
+  void AutoShrink();
+  
+  void Destruct( KeyValue* table, int count );
+  void Construct( KeyValue* table, int count );
+};
+// ---------------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename key_T, typename value_T >
+void MojoPooledMultiMap< key_T, value_T >::Init()
+{
+  m_Alloc = NULL;
+  m_Name = NULL;
+  m_Pool = NULL;
+  m_ActiveCount = 0;
+  m_PoolAllocCount = 0;
+  m_PoolUsedCount = 0;
+  m_PoolFreeCount = 0;
+  m_ChangeCount = 0;
+  m_Status = kMojoStatus_NotInitialized;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoPooledMultiMap< key_T, value_T >::GetStatus() const
+{
+  return m_Status;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoPooledMultiMap< key_T, value_T >::Create( const char* name, const value_T& not_found_value,
+                                                         const MojoConfig* config, MojoAlloc* alloc )
+{
+  if( !config )
+  {
+    config = MojoConfig::GetDefault();
+  }
+  if( !alloc )
+  {
+    alloc = MojoAlloc::GetDefault();
+  }
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    m_Status = kMojoStatus_DoubleInitialized;
+  }
+  else
+  {
+    m_Status = m_Runs.Create( name, Run(), config, alloc );
+    if( !m_Status )
+    {
+      m_Alloc           = alloc;
+      m_Name            = name;
+      m_NotFoundValue   = not_found_value;
+      m_ActiveCount     = 0;
+      
+      m_AllocCountMin   = config->m_AllocCountMin;
+      m_ShrinkThreshold = config->m_ShrinkThreshold;
+      m_AutoShrink      = config->m_AutoShrink;
+      m_DynamicAlloc    = config->m_DynamicAlloc;
+      
+      ResizePool( m_AllocCountMin );
+      if( !m_Pool )
+      {
+        m_Status = kMojoStatus_CouldNotAlloc;
+      }
+    }
+  }
+  return m_Status;
+}
+
+template< typename key_T, typename value_T >
+MojoPooledMultiMap< key_T, value_T >::~MojoPooledMultiMap()
+{
+  Destroy();
+}
+
+template< typename key_T, typename value_T >
+void MojoPooledMultiMap< key_T, value_T >::Destroy()
+{
+  m_Runs.Destroy();
+  ResizePool( 0 );
+  Init();
+}
+
+template< typename key_T, typename value_T >
+void MojoPooledMultiMap< key_T, value_T >::Reset()
+{
+  m_Runs.Reset();
+  for( int i = 0; i < m_PoolUsedCount; ++i )
+  {
+    m_Pool[ i ] = KeyValue();
+  }
+  m_ActiveCount = 0;
+  m_PoolUsedCount = 0;
+  m_PoolFreeCount = 0;
+  m_ChangeCount += 1;
+  ResizePool( m_AllocCountMin );
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoPooledMultiMap< key_T, value_T >::Insert( const key_T& key, const value_T& value )
+{
+  MojoStatus status = m_Status;
+  if( !status )
+  {
+    if( key.IsHashNull() )
+    {
+      status = kMojoStatus_InvalidArguments;
+    }
+    else
+    {
+      Run run = m_Runs.Find( key );
+      for( int i = run.m_Start; i < run.m_Start + run.m_Count; ++i )
+      {
+        if( m_Pool[ i ].value == value )
+        {
+          return status;
+        }
+      }
+      if( run.m_Count < run.m_Capacity || GrowRun( key, &run ) )
+      {
+        m_Pool[ run.m_Start + run.m_Count ].key = key;
+        m_Pool[ run.m_Start + run.m_Count ].value = value;
+        run.m_Count += 1;
+        status = m_Runs.Insert( key, run );
+        m_ActiveCount += 1;
+        m_ChangeCount += 1;
+      }
+      else
+      {
+        status = kMojoStatus_CouldNotAlloc;
+      }
+    }
+  }
+  return status;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoPooledMultiMap< key_T, value_T >::Remove( const key_T& key )
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  else if( !key.IsHashNull() )
+  {
+    Run run = m_Runs.Remove( key );
+    if( run.m_Count )
+    {
+      FreeRun( run );
+      m_ActiveCount -= run.m_Count;
+      m_ChangeCount += 1;
+      AutoShrink();
+      return kMojoStatus_Ok;
+    }
+  }
+  return kMojoStatus_NotFound;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoPooledMultiMap< key_T, value_T >::Remove( const key_T& key, const value_T& value )
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  else if( !key.IsHashNull() )
+  {
+    Run run = m_Runs.Find( key );
+    for( int i = run.m_Start; i < run.m_Start + run.m_Count; ++i )
+    {
+      if( m_Pool[ i ].value == value )
+      {
+        // Order of values is not preserved. The last value of the run fills the gap.
+        run.m_Count -= 1;
+        m_Pool[ i ] = m_Pool[ run.m_Start + run.m_Count ];
+        m_Pool[ run.m_Start + run.m_Count ] = KeyValue();
+        if( run.m_Count )
+        {
+          m_Runs.Insert( key, run );
+        }
+        else
+        {
+          m_Runs.Remove( key );
+          FreeRun( run );
+        }
+        m_ActiveCount -= 1;
+        m_ChangeCount += 1;
+        AutoShrink();
+        return kMojoStatus_Ok;
+      }
+    }
+  }
+  return kMojoStatus_NotFound;
+}
+
+template< typename key_T, typename value_T >
+value_T MojoPooledMultiMap< key_T, value_T >::Find( const key_T& key ) const
+{
+  if( !m_Status && !key.IsHashNull() )
+  {
+    Run run = m_Runs.Find( key );
+    if( run.m_Count )
+    {
+      return m_Pool[ run.m_Start ].value;
+    }
+  }
+  return m_NotFoundValue;
+}
+
+template< typename key_T, typename value_T >
+bool MojoPooledMultiMap< key_T, value_T >::Contains( const key_T& key ) const
+{
+  return !m_Status && m_Runs.Contains( key );
+}
+
+template< typename key_T, typename value_T >
+bool MojoPooledMultiMap< key_T, value_T >::Contains( const key_T& key, const value_T& value ) const
+{
+  if( !m_Status && !key.IsHashNull() )
+  {
+    Run run = m_Runs.Find( key );
+    for( int i = run.m_Start; i < run.m_Start + run.m_Count; ++i )
+    {
+      if( m_Pool[ i ].value == value )
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+template< typename key_T, typename value_T >
+int MojoPooledMultiMap< key_T, value_T >::GetValueCount( const key_T& key ) const
+{
+  return m_Status || key.IsHashNull() ? 0 : m_Runs.Find( key ).m_Count;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoPooledMultiMap< key_T, value_T >::Update()
+{
+  MojoStatus status = m_Status;
+  if( !status )
+  {
+    status = m_Runs.Update();
+    if( m_PoolFreeCount )
+    {
+      CompactPool();
+    }
+  }
+  return status;
+}
+
+template< typename key_T, typename value_T >
+int MojoPooledMultiMap< key_T, value_T >::GetCount() const
+{
+  return m_ActiveCount;
+}
+
+template< typename key_T, typename value_T >
+bool MojoPooledMultiMap< key_T, value_T >::GrowRun( const key_T& key, Run* run )
+{
+  // Double the capacity of the run. If it is the last run in the pool, it can simply grow in place. Otherwise, it moves
+  // to the end of the pool.
+  int new_capacity = MojoMax( run->m_Capacity * 2, 2 );
+  bool is_last = run->m_Capacity && run->m_Start + run->m_Capacity == m_PoolUsedCount;
+  int needed_count = is_last ? new_capacity - run->m_Capacity : new_capacity;
+  if( m_PoolUsedCount + needed_count > m_PoolAllocCount )
+  {
+    if( m_PoolFreeCount )
+    {
+      // Get rid of the gaps first. This may move the run itself.
+      CompactPool();
+      *run = m_Runs.Find( key );
+      is_last = run->m_Capacity && run->m_Start + run->m_Capacity == m_PoolUsedCount;
+      needed_count = is_last ? new_capacity - run->m_Capacity : new_capacity;
+    }
+    if( m_PoolUsedCount + needed_count > m_PoolAllocCount && m_DynamicAlloc )
+    {
+      ResizePool( MojoMax( m_PoolAllocCount * 2, m_PoolUsedCount + needed_count ) );
+    }
+    if( m_PoolUsedCount + needed_count > m_PoolAllocCount )
+    {
+      return false;
+    }
+  }
+  
+  if( !is_last )
+  {
+    int new_start = m_PoolUsedCount;
+    for( int i = 0; i < run->m_Count; ++i )
+    {
+      m_Pool[ new_start + i ] = m_Pool[ run->m_Start + i ];
+    }
+    FreeRun( *run );
+    run->m_Start = new_start;
+  }
+  m_PoolUsedCount += needed_count;
+  run->m_Capacity = new_capacity;
+  return true;
+}
+
+template< typename key_T, typename value_T >
+void MojoPooledMultiMap< key_T, value_T >::FreeRun( const Run& run )
+{
+  for( int i = run.m_Start; i < run.m_Start + run.m_Capacity; ++i )
+  {
+    m_Pool[ i ] = KeyValue();
+  }
+  if( run.m_Start + run.m_Capacity == m_PoolUsedCount )
+  {
+    m_PoolUsedCount = run.m_Start;
+  }
+  else
+  {
+    m_PoolFreeCount += run.m_Capacity;
+  }
+}
+
+template< typename key_T, typename value_T >
+void MojoPooledMultiMap< key_T, value_T >::CompactPool()
+{
+  // Slide all runs toward the start of the pool, in order. A run never moves past the start of the next one.
+  int to_index = 0;
+  int index = 0;
+  while( index < m_PoolUsedCount )
+  {
+    if( m_Pool[ index ].key.IsHashNull() )
+    {
+      index += 1;
+    }
+    else
+    {
+      key_T key = m_Pool[ index ].key;
+      Run run = m_Runs.Find( key );
+      if( run.m_Start != to_index )
+      {
+        for( int i = 0; i < run.m_Count; ++i )
+        {
+          m_Pool[ to_index + i ] = m_Pool[ run.m_Start + i ];
+          m_Pool[ run.m_Start + i ] = KeyValue();
+        }
+        run.m_Start = to_index;
+        m_Runs.Insert( key, run );
+      }
+      index = index + run.m_Capacity;
+      to_index += run.m_Capacity;
+    }
+  }
+  m_PoolUsedCount = to_index;
+  m_PoolFreeCount = 0;
+}
+
+template< typename key_T, typename value_T >
+void MojoPooledMultiMap< key_T, value_T >::ResizePool( int new_capacity )
+{
+  if( m_Alloc && m_PoolAllocCount != new_capacity )
+  {
+    KeyValue* old_pool = m_Pool;
+    int old_alloc_count = m_PoolAllocCount;
+    
+    if( old_pool && new_capacity && std::is_trivially_copyable< KeyValue >::value )
+    {
+      // Pairs may be moved as plain bytes, so the allocator may resize the pool in place
+      KeyValue* pool = ( KeyValue* )m_Alloc->Reallocate( old_pool, old_alloc_count * sizeof( KeyValue ),
+                                                         new_capacity * sizeof( KeyValue ), m_Name );
+      if( pool )
+      {
+        m_Pool = pool;
+        m_PoolAllocCount = new_capacity;
+        if( new_capacity > old_alloc_count )
+        {
+          Construct( m_Pool + old_alloc_count, new_capacity - old_alloc_count );
+        }
+      }
+      return;
+    }
+    
+    m_PoolAllocCount = new_capacity;
+    m_Pool = NULL;
+    if( m_PoolAllocCount )
+    {
+      m_Pool = ( KeyValue* )m_Alloc->Allocate( m_PoolAllocCount * sizeof( KeyValue ), m_Name );
+      Construct( m_Pool, m_PoolAllocCount );
+      for( int i = 0; i < m_PoolUsedCount; ++i )
+      {
+        m_Pool[ i ] = old_pool[ i ];
+      }
+    }
+    
+    if( old_pool )
+    {
+      Destruct( old_pool, old_alloc_count );
+      m_Alloc->FreeSized( old_pool, old_alloc_count * sizeof( KeyValue ) );
+    }
+  }
+}
+
+template< typename key_T, typename value_T >
+void MojoPooledMultiMap< key_T, value_T >::AutoShrink()
+{
+  // Compact when at least half of the used part of the pool is gaps, then shrink the pool if it's getting too empty
+  if( m_AutoShrink && m_PoolFreeCount * 2 >= m_PoolUsedCount )
+  {
+    CompactPool();
+    if( m_DynamicAlloc && m_PoolAllocCount > m_AllocCountMin
+       && m_PoolUsedCount * 100 < m_PoolAllocCount * m_ShrinkThreshold )
+    {
+      ResizePool( MojoMax( m_PoolAllocCount / 2, m_AllocCountMin ) );
+    }
+  }
+}
+
+template< typename key_T, typename value_T >
+int MojoPooledMultiMap< key_T, value_T >::_GetFirstIndex() const
+{
+  return _GetNextIndex( -1 );
+}
+
+template< typename key_T, typename value_T >
+int MojoPooledMultiMap< key_T, value_T >::_GetFirstIndexOf( const key_T& key ) const
+{
+  if( !m_Status && !key.IsHashNull() )
+  {
+    Run run = m_Runs.Find( key );
+    if( run.m_Count )
+    {
+      return run.m_Start;
+    }
+  }
+  return m_PoolUsedCount;
+}
+
+template< typename key_T, typename value_T >
+int MojoPooledMultiMap< key_T, value_T >::_GetNextIndex( int index ) const
+{
+  // Skip the rest of the current run, then any unused slots
+  int i = index + 1;
+  if( index >= 0 )
+  {
+    while( i < m_PoolUsedCount && m_Pool[ i ].key == m_Pool[ index ].key )
+    {
+      i += 1;
+    }
+  }
+  while( i < m_PoolUsedCount && m_Pool[ i ].key.IsHashNull() )
+  {
+    i += 1;
+  }
+  return i;
+}
+
+template< typename key_T, typename value_T >
+int MojoPooledMultiMap< key_T, value_T >::_GetNextIndexOf( const key_T& key, int index ) const
+{
+  // The run ends at the first slot that holds another key, or none
+  index += 1;
+  return index < m_PoolUsedCount && m_Pool[ index ].key == key ? index : m_PoolUsedCount;
+}
+
+template< typename key_T, typename value_T >
+bool MojoPooledMultiMap< key_T, value_T >::_IsIndexValid( int index ) const
+{
+  return !m_Status && index < m_PoolUsedCount;
+}
+
+template< typename key_T, typename value_T >
+key_T MojoPooledMultiMap< key_T, value_T >::_GetKeyAt( int index ) const
+{
+  return m_Pool[ index ].key;
+}
+
+template< typename key_T, typename value_T >
+value_T MojoPooledMultiMap< key_T, value_T >::_GetValueAt( int index ) const
+{
+  return m_Pool[ index ].value;
+}
+
+template< typename key_T, typename value_T >
+typename MojoPooledMultiMap< key_T, value_T >::KeyValue
+MojoPooledMultiMap< key_T, value_T >::_GetKeyValueAt( int index ) const
+{
+  return m_Pool[ index ];
+}
+
+template< typename key_T, typename value_T >
+void MojoPooledMultiMap< key_T, value_T >::Enumerate( const MojoCollector< key_T >& collector,
+                                                     const MojoAbstractSet< key_T >* limit ) const
+{
+  m_Runs.Enumerate( collector, limit );
+}
+
+template< typename key_T, typename value_T >
+int MojoPooledMultiMap< key_T, value_T >::_GetEnumerationCost() const
+{
+  return m_Runs._GetEnumerationCost();
+}
+
+template< typename key_T, typename value_T >
+int MojoPooledMultiMap< key_T, value_T >::_GetChangeCount() const
+{
+  return m_ChangeCount;
+}
+
+template< typename key_T, typename value_T >
+void MojoPooledMultiMap< key_T, value_T >::Destruct( KeyValue* table, int count )
+{
+  for( int i = 0; i < count; ++i )
+  {
+    table[ i ].~KeyValue();
+  }
+}
+
+template< typename key_T, typename value_T >
+void MojoPooledMultiMap< key_T, value_T >::Construct( KeyValue* table, int count )
+{
+  for( int i = 0; i < count; ++i )
+  {
+    new( table + i ) KeyValue();
+  }
+}
@@ -0,0 +1,96 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+#include "MojoQsbr.h"
+
+MojoQsbr::MojoQsbr()
+{
+  m_Epoch.store( 1 );
+  for( int i = 0; i < kMojoQsbrReaderMax; ++i )
+  {
+    m_Readers[ i ].m_Epoch.store( 0 );
+    m_Readers[ i ].m_InUse.store( false );
+  }
+}
+
+int MojoQsbr::RegisterReader()
+{
+  for( int i = 0; i < kMojoQsbrReaderMax; ++i )
+  {
+    bool in_use = false;
+    if( m_Readers[ i ].m_InUse.compare_exchange_strong( in_use, true ) )
+    {
+      Quiescent( i );
+      return i;
+    }
+  }
+  return -1;
+}
+
+void MojoQsbr::UnregisterReader( int reader )
+{
+  Offline( reader );
+  m_Readers[ reader ].m_InUse.store( false, std::memory_order_release );
+}
+
+void MojoQsbr::Quiescent( int reader )
+{
+  // Everything this reader read before is ordered before the store. The writer's acquire in IsSafe() pairs with it.
+  m_Readers[ reader ].m_Epoch.store( m_Epoch.load( std::memory_order_acquire ), std::memory_order_release );
+  // Either the writer sees this store, or this reader's next loads see what the writer published. See Retire().
+  std::atomic_thread_fence( std::memory_order_seq_cst );
+}
+
+void MojoQsbr::Offline( int reader )
+{
+  m_Readers[ reader ].m_Epoch.store( 0, std::memory_order_release );
+}
+
+uint64_t MojoQsbr::Retire()
+{
+  // Readers that see the new epoch in Quiescent() are past the point where the object was unpublished
+  uint64_t ticket = m_Epoch.fetch_add( 1, std::memory_order_seq_cst ) + 1;
+  std::atomic_thread_fence( std::memory_order_seq_cst );
+  return ticket;
+}
+
+bool MojoQsbr::IsSafe( uint64_t ticket ) const
+{
+  for( int i = 0; i < kMojoQsbrReaderMax; ++i )
+  {
+    uint64_t epoch = m_Readers[ i ].m_Epoch.load( std::memory_order_acquire );
+    if( epoch && epoch < ticket )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+MojoQsbr* MojoQsbr::GetDefault()
+{
+  static MojoQsbr default_qsbr;
+  return &default_qsbr;
+}
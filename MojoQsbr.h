@@ -0,0 +1,114 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+#include <atomic>
+
+// -- Mojo
+#include "MojoConstants.h"
+
+/**
+ \class MojoQsbr
+ \ingroup group_util
+ Quiescent-state-based reclamation. Tells a writer when memory that it has unpublished can no longer be in use by any
+ reader thread, without readers having to do anything at all while they read.
+ - Each reader thread calls RegisterReader() once, and Quiescent() every now and then, at a point where it holds no
+ pointers into shared data. Between two calls to Quiescent() is one read-side critical section.
+ - The writer first unpublishes an object, so that readers can no longer find it, then calls Retire() to get a ticket.
+ Once IsSafe() returns true for that ticket, every reader has passed through a quiescent state, and the object may be
+ freed.
+
+ A reader that is going to be idle for a while should call Offline(), so that it does not hold up the writer, and
+ Quiescent() when it resumes.
+ \see MojoSnapshotSet, MojoSnapshotMap
+ */
+class MojoQsbr
+{
+public:
+  
+  MojoQsbr();
+  
+  /**
+   Register the calling reader thread. The reader starts out in a quiescent state.
+   \return Reader index, to pass to Quiescent(), Offline() and UnregisterReader(). -1 if kMojoQsbrReaderMax readers are
+   already registered.
+   */
+  int RegisterReader();
+  
+  /**
+   Unregister a reader. It must not hold any pointers into shared data.
+   \param[in] reader Reader index returned by RegisterReader().
+   */
+  void UnregisterReader( int reader );
+  
+  /**
+   Report that the reader holds no pointers into shared data right now. Any pointer it obtains after this call belongs
+   to a new read-side critical section.
+   \param[in] reader Reader index returned by RegisterReader().
+   */
+  void Quiescent( int reader );
+  
+  /**
+   Report that the reader holds no pointers into shared data, and will not obtain any until its next call to
+   Quiescent().
+   \param[in] reader Reader index returned by RegisterReader().
+   */
+  void Offline( int reader );
+  
+  /**
+   Called by the writer, after an object has been unpublished.
+   \return Ticket to pass to IsSafe().
+   */
+  uint64_t Retire();
+  
+  /**
+   Test whether all readers have passed a quiescent state since a ticket was handed out.
+   \param[in] ticket Ticket returned by Retire().
+   \return true if objects retired with this ticket may be freed.
+   */
+  bool IsSafe( uint64_t ticket ) const;
+  
+  /**
+   Get the global default instance.
+   \return The global default MojoQsbr.
+   */
+  static MojoQsbr* GetDefault();
+  
+private:
+  
+  // Each reader on its own cache line, so that readers do not slow each other down
+  struct Reader
+  {
+    std::atomic< uint64_t > m_Epoch;      // Epoch of the last quiescent state. 0 when offline
+    std::atomic< bool >     m_InUse;
+    char                    m_Padding[ 64 - sizeof( std::atomic< uint64_t > ) - sizeof( std::atomic< bool > ) ];
+  };
+  
+  std::atomic< uint64_t > m_Epoch;
+  Reader                  m_Readers[ kMojoQsbrReaderMax ];
+};
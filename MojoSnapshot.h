@@ -0,0 +1,742 @@
+/*
+ Copyright (c) 2013, Insomniac Games
+ 
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without modification, are permitted provided that the
+ following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, this list of conditions and the following
+ disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following
+ disclaimer in the documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+ INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ \file
+ \author Ron Pieket \n<http://www.ItShouldJustWorkTM.com> \n<http://twitter.com/RonPieket>
+ */
+/* MojoLib is documented at: http://www.itshouldjustworktm.com/mojolib/ */
+#pragma once
+
+// -- Standard Libs
+#include <stdint.h>
+#include <atomic>
+#include <new>
+
+// -- Mojo
+#include "MojoStatus.h"
+#include "MojoAlloc.h"
+#include "MojoConfig.h"
+#include "MojoAbstractSet.h"
+#include "MojoCollector.h"
+#include "MojoSet.h"
+#include "MojoMap.h"
+#include "MojoQsbr.h"
+
+/**
+ \class MojoSnapshotSet
+ \ingroup group_container
+ A key-only hash table for one writer thread and many reader threads.
+ The writer changes a private MojoSet, and calls Publish() to make its current state visible to readers as a new,
+ immutable MojoSet. Readers always see the most recently published version, and never wait: Contains() and
+ Enumerate() involve no locks, and no atomic operations other than a plain pointer load.
+ Old versions are freed once every reader has passed through a quiescent state (see MojoQsbr). Each reader thread must
+ register with the MojoQsbr, and call MojoQsbr::Quiescent() regularly, when it holds no pointers it got from the set.
+ \tparam key_T Key type. Must be hashable.
+ */
+template< typename key_T >
+class MojoSnapshotSet final : public MojoAbstractSet< key_T >
+{
+public:
+  
+  /**
+   Default constructor. You must call Create() before the set is ready for use.
+   */
+  MojoSnapshotSet()
+  {
+    Init();
+  }
+  
+  /**
+   Initializing constructor. No need to call Create().
+   \param[in] name The name of the set. Will also be used for internal memory allocation.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig for
+   details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global defualt will be used. See documentation for MojoAlloc for
+   details on how to set the global default. Only the writer thread allocates.
+   \param[in] qsbr Reclamation domain of the reader threads. If omitted, MojoQsbr::GetDefault() will be used.
+   */
+  MojoSnapshotSet( const char* name, const MojoConfig* config = NULL, MojoAlloc* alloc = NULL, MojoQsbr* qsbr = NULL )
+  {
+    Init();
+    Create( name, config, alloc, qsbr );
+  }
+  
+  /**
+   Create after default constructor or Destroy(). Publishes an empty set.
+   \param[in] name The name of the set. Will also be used for internal memory allocation.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig for
+   details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global defualt will be used. See documentation for MojoAlloc for
+   details on how to set the global default. Only the writer thread allocates.
+   \param[in] qsbr Reclamation domain of the reader threads. If omitted, MojoQsbr::GetDefault() will be used.
+   \return Status code.
+   */
+  MojoStatus Create( const char* name, const MojoConfig* config = NULL, MojoAlloc* alloc = NULL,
+                   MojoQsbr* qsbr = NULL );
+  
+  /**
+   Free all versions. There must be no readers left.
+   */
+  void Destroy();
+  
+  /**
+   Writer only. Insert key into the writer's set. Readers will not see it until Publish().
+   \param[in] key Key to insert.
+   \return Status code.
+   */
+  MojoStatus Insert( const key_T& key );
+  
+  /**
+   Writer only. Remove key from the writer's set. Readers will not see the change until Publish().
+   \param[in] key Key to remove.
+   \return Status code.
+   */
+  MojoStatus Remove( const key_T& key );
+  
+  /**
+   Writer only. Remove all keys from the writer's set. Readers will not see the change until Publish().
+   */
+  void Reset();
+  
+  /**
+   Writer only. Make a copy of the writer's set, and make it the version that readers see. The version it replaces is
+   freed once it is safe to do so.
+   \return Status code.
+   */
+  MojoStatus Publish();
+  
+  /**
+   Writer only. Free the old versions that no reader can be using anymore. Publish() does this too.
+   */
+  void Reclaim();
+  
+  /**
+   Get the writer's set. Writer only.
+   \return The set that Insert() and Remove() change.
+   */
+  const MojoSet< key_T >* GetWritable() const { return &m_Writable; }
+  
+  /**
+   Get the published version. The pointer stays valid until the calling reader's next quiescent state. Looking up
+   many keys in the same snapshot saves reloading the pointer for each one.
+   \return The current immutable version.
+   */
+  const MojoSet< key_T >* GetSnapshot() const;
+  
+  /**
+   Test presence of a key in the published version.
+   */
+  virtual bool Contains( const key_T& key ) const override;
+  
+  /**
+   Get number of keys in the published version.
+   */
+  int GetCount() const;
+  
+  /**
+   Return table status state.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const { return m_Status; }
+  
+  /**
+   Return name of the set.
+   */
+  const char* GetName() const { return m_Name; }
+  
+  virtual void Enumerate( const MojoCollector< key_T >& collector,
+                         const MojoAbstractSet< key_T >* limit = NULL ) const override;
+  /** \private */
+  virtual int _GetEnumerationCost() const override;
+  /** \private */
+  virtual int _GetChangeCount() const override;
+  
+  virtual ~MojoSnapshotSet();
+  
+private:
+  
+  struct Version
+  {
+    MojoSet< key_T >    m_Set;
+    int                 m_PublishCount;
+    uint64_t            m_Ticket;         // When retired. See MojoQsbr::Retire()
+    Version*            m_NextRetired;
+  };
+  
+  const char*             m_Name;
+  MojoConfig              m_Config;
+  MojoAlloc*              m_Alloc;
+  MojoQsbr*               m_Qsbr;
+  MojoSet< key_T >        m_Writable;
+  std::atomic< Version* > m_Published;
+  Version*                m_Retired;      // Oldest first
+  int                     m_PublishCount;
+  MojoStatus               m_Status;
+  
+  void Init();
+  void FreeVersion( Version* version );
+};
+
+/**
+ \class MojoSnapshotMap
+ \ingroup group_container
+ A one-to-one hash table for one writer thread and many reader threads. Works like MojoSnapshotSet: the writer
+ changes a private MojoMap and publishes immutable copies of it, and readers use Find() and Contains() without locks.
+ \tparam key_T Key type. Must be hashable.
+ \tparam value_T Value type.
+ */
+template< typename key_T, typename value_T >
+class MojoSnapshotMap final : public MojoAbstractSet< key_T >
+{
+public:
+  
+  /**
+   Default constructor. You must call Create() before the map is ready for use.
+   */
+  MojoSnapshotMap()
+  {
+    Init();
+  }
+  
+  /**
+   Initializing constructor. No need to call Create().
+   \param[in] name The name of the map. Will also be used for internal memory allocation.
+   \param[in] not_found_value The value to return if nothing was found.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig for
+   details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global defualt will be used. See documentation for MojoAlloc for
+   details on how to set the global default. Only the writer thread allocates.
+   \param[in] qsbr Reclamation domain of the reader threads. If omitted, MojoQsbr::GetDefault() will be used.
+   */
+  MojoSnapshotMap( const char* name, const value_T& not_found_value = value_T(), const MojoConfig* config = NULL,
+                  MojoAlloc* alloc = NULL, MojoQsbr* qsbr = NULL )
+  {
+    Init();
+    Create( name, not_found_value, config, alloc, qsbr );
+  }
+  
+  /**
+   Create after default constructor or Destroy(). Publishes an empty map.
+   \param[in] name The name of the map. Will also be used for internal memory allocation.
+   \param[in] not_found_value The value to return if nothing was found.
+   \param[in] config Config to use. If omitted, the global default will be used. See documentation for MojoConfig for
+   details on how to set a global default.
+   \param[in] alloc Allocator to use. If omitted, the global defualt will be used. See documentation for MojoAlloc for
+   details on how to set the global default. Only the writer thread allocates.
+   \param[in] qsbr Reclamation domain of the reader threads. If omitted, MojoQsbr::GetDefault() will be used.
+   \return Status code.
+   */
+  MojoStatus Create( const char* name, const value_T& not_found_value = value_T(), const MojoConfig* config = NULL,
+                   MojoAlloc* alloc = NULL, MojoQsbr* qsbr = NULL );
+  
+  /**
+   Free all versions. There must be no readers left.
+   */
+  void Destroy();
+  
+  /**
+   Writer only. Insert key-value pair into the writer's map. Readers will not see it until Publish().
+   \param[in] key Key of the key-value pair to insert.
+   \param[in] value Value of the key-value pair to insert.
+   \return Status code.
+   */
+  MojoStatus Insert( const key_T& key, const value_T& value );
+  
+  /**
+   Writer only. Remove key-value pair from the writer's map. Readers will not see the change until Publish().
+   \param[in] key Key of the key-value pair to remove.
+   \return The removed value. If key was not found, the not_found_value is returned.
+   */
+  value_T Remove( const key_T& key );
+  
+  /**
+   Writer only. Remove all key-value pairs from the writer's map. Readers will not see the change until Publish().
+   */
+  void Reset();
+  
+  /**
+   Writer only. Make a copy of the writer's map, and make it the version that readers see. The version it replaces is
+   freed once it is safe to do so.
+   \return Status code.
+   */
+  MojoStatus Publish();
+  
+  /**
+   Writer only. Free the old versions that no reader can be using anymore. Publish() does this too.
+   */
+  void Reclaim();
+  
+  /**
+   Get the writer's map. Writer only.
+   \return The map that Insert() and Remove() change.
+   */
+  const MojoMap< key_T, value_T >* GetWritable() const { return &m_Writable; }
+  
+  /**
+   Get the published version. The pointer stays valid until the calling reader's next quiescent state.
+   \return The current immutable version.
+   */
+  const MojoMap< key_T, value_T >* GetSnapshot() const;
+  
+  /**
+   Find value that is associated with the key in the published version.
+   \param[in] key Key to seach for.
+   \return The value. If key was not found, the not_found_value is returned.
+   */
+  value_T Find( const key_T& key ) const;
+  
+  /**
+   Test presence of a key in the published version.
+   */
+  virtual bool Contains( const key_T& key ) const override;
+  
+  /**
+   Get number of key-value pairs in the published version.
+   */
+  int GetCount() const;
+  
+  /**
+   Return table status state.
+   \return Status code.
+   */
+  MojoStatus GetStatus() const { return m_Status; }
+  
+  /**
+   Return name of the map.
+   */
+  const char* GetName() const { return m_Name; }
+  
+  virtual void Enumerate( const MojoCollector< key_T >& collector,
+                         const MojoAbstractSet< key_T >* limit = NULL ) const override;
+  /** \private */
+  virtual int _GetEnumerationCost() const override;
+  /** \private */
+  virtual int _GetChangeCount() const override;
+  
+  virtual ~MojoSnapshotMap();
+  
+private:
+  
+  struct Version
+  {
+    MojoMap< key_T, value_T > m_Map;
+    int                 m_PublishCount;
+    uint64_t            m_Ticket;         // When retired. See MojoQsbr::Retire()
+    Version*            m_NextRetired;
+  };
+  
+  const char*             m_Name;
+  value_T                 m_NotFoundValue;
+  MojoConfig              m_Config;
+  MojoAlloc*              m_Alloc;
+  MojoQsbr*               m_Qsbr;
+  MojoMap< key_T, value_T > m_Writable;
+  std::atomic< Version* > m_Published;
+  Version*                m_Retired;      // Oldest first
+  int                     m_PublishCount;
+  MojoStatus               m_Status;
+  
+  void Init();
+  void FreeVersion( Version* version );
+};
+// ---------------------------------------------------------------------------------------------------------------------
+// Inline implementations
+
+template< typename key_T >
+void MojoSnapshotSet< key_T >::Init()
+{
+  m_Name = NULL;
+  m_Alloc = NULL;
+  m_Qsbr = NULL;
+  m_Published.store( NULL );
+  m_Retired = NULL;
+  m_PublishCount = 0;
+  m_Status = kMojoStatus_NotInitialized;
+}
+
+template< typename key_T >
+MojoStatus MojoSnapshotSet< key_T >::Create( const char* name, const MojoConfig* config, MojoAlloc* alloc,
+                                           MojoQsbr* qsbr )
+{
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    m_Status = kMojoStatus_DoubleInitialized;
+  }
+  else
+  {
+    m_Name   = name;
+    m_Config = config ? *config : *MojoConfig::GetDefault();
+    m_Alloc  = alloc ? alloc : MojoAlloc::GetDefault();
+    m_Qsbr   = qsbr ? qsbr : MojoQsbr::GetDefault();
+    m_Status = m_Writable.Create( name, &m_Config, m_Alloc );
+    if( !m_Status )
+    {
+      m_Status = Publish();
+    }
+  }
+  return m_Status;
+}
+
+template< typename key_T >
+MojoSnapshotSet< key_T >::~MojoSnapshotSet()
+{
+  Destroy();
+}
+
+template< typename key_T >
+void MojoSnapshotSet< key_T >::Destroy()
+{
+  FreeVersion( m_Published.load() );
+  while( m_Retired )
+  {
+    Version* version = m_Retired;
+    m_Retired = version->m_NextRetired;
+    FreeVersion( version );
+  }
+  m_Writable.Destroy();
+  Init();
+}
+
+template< typename key_T >
+MojoStatus MojoSnapshotSet< key_T >::Insert( const key_T& key )
+{
+  return m_Status ? m_Status : m_Writable.Insert( key );
+}
+
+template< typename key_T >
+MojoStatus MojoSnapshotSet< key_T >::Remove( const key_T& key )
+{
+  return m_Status ? m_Status : m_Writable.Remove( key );
+}
+
+template< typename key_T >
+void MojoSnapshotSet< key_T >::Reset()
+{
+  m_Writable.Reset();
+}
+
+template< typename key_T >
+MojoStatus MojoSnapshotSet< key_T >::Publish()
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  
+  Version* version = ( Version* )m_Alloc->Allocate( sizeof( Version ), m_Name );
+  if( !version )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+  new( version ) Version();
+  version->m_PublishCount = ++m_PublishCount;
+  version->m_Ticket = 0;
+  version->m_NextRetired = NULL;
+  MojoStatus status = version->m_Set.Create( m_Name, &m_Config, m_Alloc );
+  if( !status )
+  {
+    status = version->m_Set.InsertFrom( m_Writable );
+  }
+  if( status )
+  {
+    FreeVersion( version );
+    return status;
+  }
+  
+  // The version is complete before the pointer to it is stored. Readers that load the pointer see all of it.
+  Version* old_version = m_Published.exchange( version, std::memory_order_acq_rel );
+  if( old_version )
+  {
+    old_version->m_Ticket = m_Qsbr->Retire();
+    Version** last = &m_Retired;
+    while( *last )
+    {
+      last = &( *last )->m_NextRetired;
+    }
+    *last = old_version;
+  }
+  Reclaim();
+  return kMojoStatus_Ok;
+}
+
+template< typename key_T >
+void MojoSnapshotSet< key_T >::Reclaim()
+{
+  // Tickets are in increasing order, so stop at the first one that is not safe yet
+  while( m_Retired && m_Qsbr->IsSafe( m_Retired->m_Ticket ) )
+  {
+    Version* version = m_Retired;
+    m_Retired = version->m_NextRetired;
+    FreeVersion( version );
+  }
+}
+
+template< typename key_T >
+const MojoSet< key_T >* MojoSnapshotSet< key_T >::GetSnapshot() const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  return version ? &version->m_Set : NULL;
+}
+
+template< typename key_T >
+bool MojoSnapshotSet< key_T >::Contains( const key_T& key ) const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  return version && version->m_Set.Contains( key );
+}
+
+template< typename key_T >
+int MojoSnapshotSet< key_T >::GetCount() const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  return version ? version->m_Set.GetCount() : 0;
+}
+
+template< typename key_T >
+void MojoSnapshotSet< key_T >::Enumerate( const MojoCollector< key_T >& collector,
+                                        const MojoAbstractSet< key_T >* limit ) const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  if( version )
+  {
+    version->m_Set.Enumerate( collector, limit );
+  }
+}
+
+template< typename key_T >
+int MojoSnapshotSet< key_T >::_GetEnumerationCost() const
+{
+  return GetCount();
+}
+
+template< typename key_T >
+int MojoSnapshotSet< key_T >::_GetChangeCount() const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  return version ? version->m_PublishCount : 0;
+}
+
+template< typename key_T >
+void MojoSnapshotSet< key_T >::FreeVersion( Version* version )
+{
+  if( version )
+  {
+    version->~Version();
+    m_Alloc->FreeSized( version, sizeof( Version ) );
+  }
+}
+
+template< typename key_T, typename value_T >
+void MojoSnapshotMap< key_T, value_T >::Init()
+{
+  m_Name = NULL;
+  m_Alloc = NULL;
+  m_Qsbr = NULL;
+  m_Published.store( NULL );
+  m_Retired = NULL;
+  m_PublishCount = 0;
+  m_Status = kMojoStatus_NotInitialized;
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoSnapshotMap< key_T, value_T >::Create( const char* name, const value_T& not_found_value,
+                                                      const MojoConfig* config, MojoAlloc* alloc, MojoQsbr* qsbr )
+{
+  if( m_Status != kMojoStatus_NotInitialized )
+  {
+    m_Status = kMojoStatus_DoubleInitialized;
+  }
+  else
+  {
+    m_Name          = name;
+    m_NotFoundValue = not_found_value;
+    m_Config        = config ? *config : *MojoConfig::GetDefault();
+    m_Alloc         = alloc ? alloc : MojoAlloc::GetDefault();
+    m_Qsbr          = qsbr ? qsbr : MojoQsbr::GetDefault();
+    m_Status = m_Writable.Create( name, not_found_value, &m_Config, m_Alloc );
+    if( !m_Status )
+    {
+      m_Status = Publish();
+    }
+  }
+  return m_Status;
+}
+
+template< typename key_T, typename value_T >
+MojoSnapshotMap< key_T, value_T >::~MojoSnapshotMap()
+{
+  Destroy();
+}
+
+template< typename key_T, typename value_T >
+void MojoSnapshotMap< key_T, value_T >::Destroy()
+{
+  FreeVersion( m_Published.load() );
+  while( m_Retired )
+  {
+    Version* version = m_Retired;
+    m_Retired = version->m_NextRetired;
+    FreeVersion( version );
+  }
+  m_Writable.Destroy();
+  Init();
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoSnapshotMap< key_T, value_T >::Insert( const key_T& key, const value_T& value )
+{
+  return m_Status ? m_Status : m_Writable.Insert( key, value );
+}
+
+template< typename key_T, typename value_T >
+value_T MojoSnapshotMap< key_T, value_T >::Remove( const key_T& key )
+{
+  return m_Status ? m_NotFoundValue : m_Writable.Remove( key );
+}
+
+template< typename key_T, typename value_T >
+void MojoSnapshotMap< key_T, value_T >::Reset()
+{
+  m_Writable.Reset();
+}
+
+template< typename key_T, typename value_T >
+MojoStatus MojoSnapshotMap< key_T, value_T >::Publish()
+{
+  if( m_Status )
+  {
+    return m_Status;
+  }
+  
+  Version* version = ( Version* )m_Alloc->Allocate( sizeof( Version ), m_Name );
+  if( !version )
+  {
+    return kMojoStatus_CouldNotAlloc;
+  }
+  new( version ) Version();
+  version->m_PublishCount = ++m_PublishCount;
+  version->m_Ticket = 0;
+  version->m_NextRetired = NULL;
+  MojoStatus status = version->m_Map.Create( m_Name, m_NotFoundValue, &m_Config, m_Alloc );
+  if( !status )
+  {
+    status = version->m_Map.Reserve( m_Writable.GetCount() );
+  }
+  const MojoMap< key_T, value_T >& writable = m_Writable;
+  for( int i = writable._GetFirstIndex(); !status && writable._IsIndexValid( i ); i = writable._GetNextIndex( i ) )
+  {
+    status = version->m_Map.Insert( writable._GetKeyAt( i ), writable._GetValueAt( i ) );
+  }
+  if( status )
+  {
+    FreeVersion( version );
+    return status;
+  }
+  
+  // The version is complete before the pointer to it is stored. Readers that load the pointer see all of it.
+  Version* old_version = m_Published.exchange( version, std::memory_order_acq_rel );
+  if( old_version )
+  {
+    old_version->m_Ticket = m_Qsbr->Retire();
+    Version** last = &m_Retired;
+    while( *last )
+    {
+      last = &( *last )->m_NextRetired;
+    }
+    *last = old_version;
+  }
+  Reclaim();
+  return kMojoStatus_Ok;
+}
+
+template< typename key_T, typename value_T >
+void MojoSnapshotMap< key_T, value_T >::Reclaim()
+{
+  // Tickets are in increasing order, so stop at the first one that is not safe yet
+  while( m_Retired && m_Qsbr->IsSafe( m_Retired->m_Ticket ) )
+  {
+    Version* version = m_Retired;
+    m_Retired = version->m_NextRetired;
+    FreeVersion( version );
+  }
+}
+
+template< typename key_T, typename value_T >
+const MojoMap< key_T, value_T >* MojoSnapshotMap< key_T, value_T >::GetSnapshot() const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  return version ? &version->m_Map : NULL;
+}
+
+template< typename key_T, typename value_T >
+value_T MojoSnapshotMap< key_T, value_T >::Find( const key_T& key ) const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  return version ? version->m_Map.Find( key ) : m_NotFoundValue;
+}
+
+template< typename key_T, typename value_T >
+bool MojoSnapshotMap< key_T, value_T >::Contains( const key_T& key ) const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  return version && version->m_Map.Contains( key );
+}
+
+template< typename key_T, typename value_T >
+int MojoSnapshotMap< key_T, value_T >::GetCount() const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  return version ? version->m_Map.GetCount() : 0;
+}
+
+template< typename key_T, typename value_T >
+void MojoSnapshotMap< key_T, value_T >::Enumerate( const MojoCollector< key_T >& collector,
+                                                  const MojoAbstractSet< key_T >* limit ) const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  if( version )
+  {
+    version->m_Map.Enumerate( collector, limit );
+  }
+}
+
+template< typename key_T, typename value_T >
+int MojoSnapshotMap< key_T, value_T >::_GetEnumerationCost() const
+{
+  return GetCount();
+}
+
+template< typename key_T, typename value_T >
+int MojoSnapshotMap< key_T, value_T >::_GetChangeCount() const
+{
+  Version* version = m_Published.load( std::memory_order_acquire );
+  return version ? version->m_PublishCount : 0;
+}
+
+template< typename key_T, typename value_T >
+void MojoSnapshotMap< key_T, value_T >::FreeVersion( Version* version )
+{
+  if( version )
+  {
+    version->~Version();
+    m_Alloc->FreeSized( version, sizeof( Version ) );
+  }
+}
@@ -47,6 +47,10 @@ enum MojoStatus
   kMojoStatus_InvalidArguments,
   /// Index was out of range.
   kMojoStatus_IndexOutOfRange,
+  /// A different string with the same hash code is already in the dictionary.
+  kMojoStatus_HashCollision,
+  /// A file could not be opened, read or written, or does not have the expected format.
+  kMojoStatus_InvalidFile,
 
   kMojoStatus_Count
 };
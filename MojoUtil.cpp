@@ -29,6 +29,7 @@
 
 // -- Standard Libs
 #include <stdint.h>
+#include <string.h>
 
 /**
  As per http://www.isthe.com/chongo/tech/comp/fnv/#FNV-param
@@ -106,3 +107,164 @@ uint64_t MojoFnv64( const char* s, int count )
   hash = ( hash ^ '~' ) * kFnvPrimeU64;
   return hash;
 }
+
+// Must produce the same results as MojoConstWideHash64() in MojoUtil.h
+static inline uint64_t WideRotate( uint64_t x, int bits )
+{
+  return ( x << bits ) | ( x >> ( 64 - bits ) );
+}
+
+static inline uint64_t WideRound( uint64_t lane, uint64_t word )
+{
+  return WideRotate( lane + word * kMojoWidePrime2, 31 ) * kMojoWidePrime1;
+}
+
+static inline uint64_t WideWord( const char* s, int count )
+{
+  // Little-endian, like _MojoConstWideWord()
+  uint64_t word = 0;
+  for( int i = count - 1; i >= 0; --i )
+  {
+    word = ( word << 8 ) | ( uint8_t )s[ i ];
+  }
+  return word;
+}
+
+static inline uint64_t WideWord8( const char* s )
+{
+#if defined( __BYTE_ORDER__ ) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return WideWord( s, 8 );
+#else
+  uint64_t word;
+  memcpy( &word, s, 8 );
+  return word;
+#endif
+}
+
+uint64_t MojoWideHash64( const char* s )
+{
+  if( !s || s[ 0 ] == 0 )
+  {
+    return 0;
+  }
+  return MojoWideHash64( s, ( int )strlen( s ) );
+}
+
+// The rest of MojoWideHash64(), from lanes that have consumed a multiple of 16 characters
+static uint64_t WideFinish( uint64_t lane1, uint64_t lane2, const char* s, int count )
+{
+  for( ; count >= 16; s += 16, count -= 16 )
+  {
+    lane1 = WideRound( lane1, WideWord8( s ) );
+    lane2 = WideRound( lane2, WideWord8( s + 8 ) );
+  }
+  uint64_t hash = lane1 ^ WideRotate( lane2, 29 );
+  if( count >= 8 )
+  {
+    hash = WideRound( hash, WideWord8( s ) );
+    s += 8;
+    count -= 8;
+  }
+  if( count )
+  {
+    hash = WideRound( hash, WideWord( s, count ) );
+  }
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+uint64_t MojoWideHash64( const char* s, int count )
+{
+  if( !s || count <= 0 )
+  {
+    return 0;
+  }
+  return WideFinish( kMojoWidePrime1 ^ ( uint64_t )count, kMojoWidePrime2 ^ ( uint64_t )count, s, count );
+}
+
+// Characters that all four strings have, so that the lanes can run side by side for that long
+static int GetCommonCount( const char* const* s, const int* count )
+{
+  int common = INT32_MAX;
+  for( int k = 0; k < 4; ++k )
+  {
+    common = MojoMin( common, s[ k ] ? MojoMax( count[ k ], 0 ) : 0 );
+  }
+  return common;
+}
+
+#if !MOJO_WIDE_STRING_HASH
+static void Fnv64x4( const char* const* s, const int* count, uint64_t* hash )
+{
+  int common = GetCommonCount( s, count );
+  uint64_t hash0 = kFnvBasisU64;
+  uint64_t hash1 = kFnvBasisU64;
+  uint64_t hash2 = kFnvBasisU64;
+  uint64_t hash3 = kFnvBasisU64;
+  for( int i = 0; i < common; ++i )
+  {
+    hash0 = ( hash0 ^ s[ 0 ][ i ] ) * kFnvPrimeU64;
+    hash1 = ( hash1 ^ s[ 1 ][ i ] ) * kFnvPrimeU64;
+    hash2 = ( hash2 ^ s[ 2 ][ i ] ) * kFnvPrimeU64;
+    hash3 = ( hash3 ^ s[ 3 ][ i ] ) * kFnvPrimeU64;
+  }
+  hash[ 0 ] = hash0;
+  hash[ 1 ] = hash1;
+  hash[ 2 ] = hash2;
+  hash[ 3 ] = hash3;
+  for( int k = 0; k < 4; ++k )
+  {
+    if( !s[ k ] || s[ k ][ 0 ] == 0 )
+    {
+      hash[ k ] = 0;
+      continue;
+    }
+    for( int i = common; i < count[ k ]; ++i )
+    {
+      hash[ k ] = ( hash[ k ] ^ s[ k ][ i ] ) * kFnvPrimeU64;
+    }
+    hash[ k ] = ( hash[ k ] ^ '~' ) * kFnvPrimeU64;
+  }
+}
+#else
+static void WideHash64x4( const char* const* s, const int* count, uint64_t* hash )
+{
+  int common = GetCommonCount( s, count ) & ~15;
+  uint64_t lane1[ 4 ];
+  uint64_t lane2[ 4 ];
+  for( int k = 0; k < 4; ++k )
+  {
+    lane1[ k ] = kMojoWidePrime1 ^ ( uint64_t )count[ k ];
+    lane2[ k ] = kMojoWidePrime2 ^ ( uint64_t )count[ k ];
+  }
+  for( int i = 0; i < common; i += 16 )
+  {
+    lane1[ 0 ] = WideRound( lane1[ 0 ], WideWord8( s[ 0 ] + i ) );
+    lane2[ 0 ] = WideRound( lane2[ 0 ], WideWord8( s[ 0 ] + i + 8 ) );
+    lane1[ 1 ] = WideRound( lane1[ 1 ], WideWord8( s[ 1 ] + i ) );
+    lane2[ 1 ] = WideRound( lane2[ 1 ], WideWord8( s[ 1 ] + i + 8 ) );
+    lane1[ 2 ] = WideRound( lane1[ 2 ], WideWord8( s[ 2 ] + i ) );
+    lane2[ 2 ] = WideRound( lane2[ 2 ], WideWord8( s[ 2 ] + i + 8 ) );
+    lane1[ 3 ] = WideRound( lane1[ 3 ], WideWord8( s[ 3 ] + i ) );
+    lane2[ 3 ] = WideRound( lane2[ 3 ], WideWord8( s[ 3 ] + i + 8 ) );
+  }
+  for( int k = 0; k < 4; ++k )
+  {
+    hash[ k ] = !s[ k ] || count[ k ] <= 0 ? 0 :
+                WideFinish( lane1[ k ], lane2[ k ], s[ k ] + common, count[ k ] - common );
+  }
+}
+#endif
+
+void MojoStringHash64x4( const char* const* s, const int* count, uint64_t* hash )
+{
+#if MOJO_WIDE_STRING_HASH
+  WideHash64x4( s, count, hash );
+#else
+  Fnv64x4( s, count, hash );
+#endif
+}
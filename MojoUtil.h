@@ -30,6 +30,12 @@
 // -- Standard Libs
 #include <stdint.h>
 #include <string.h>
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+#include <xmmintrin.h>
+#endif
+
+// -- Mojo
+#include "MojoConstants.h"
 
 /**
  \file MojoUtil.h
@@ -79,6 +85,180 @@ uint64_t MojoFnv64( const char* s );
  */
 uint64_t MojoFnv64( const char* s, int count );
 
+/**
+ \private
+ */
+constexpr uint64_t _MojoConstFnv64Step( const char* s, uint64_t hash )
+{
+  return *s ? _MojoConstFnv64Step( s + 1, ( hash ^ *s ) * 1099511628211ULL ) : ( hash ^ '~' ) * 1099511628211ULL;
+}
+
+/**
+ \ingroup group_util
+ Same as MojoFnv64( const char* s ), but can be evaluated at compile time. Intended for string literals. Use
+ MojoFnv64() for strings that are only known at run time.
+ \param s The zero terminated string to hash.
+ \return A hash value.
+ */
+constexpr uint64_t MojoConstFnv64( const char* s )
+{
+  return ( !s || !*s ) ? 0 : _MojoConstFnv64Step( s, 14695981039346656037ULL );
+}
+
+/**
+ \ingroup group_util
+ A 64-bit string hash that consumes 16 bytes per step, in two independent 8-byte lanes, followed by a full avalanche.
+ Much faster than MojoFnv64() on long strings. Hash codes are defined by little-endian byte order.
+ <br>Returns zero if the input pointer is NULL or the length is 0.
+ \param s The zero terminated string to hash.
+ \return A hash value.
+ */
+uint64_t MojoWideHash64( const char* s );
+/**
+ \ingroup group_util
+ A 64-bit string hash that consumes 16 bytes per step, in two independent 8-byte lanes, followed by a full avalanche.
+ <br>Returns zero if the input pointer is NULL or the count is 0.
+ \param s The string to hash.
+ \param count The number of characters.
+ \return A hash value.
+ */
+uint64_t MojoWideHash64( const char* s, int count );
+
+/** \private */
+static const uint64_t kMojoWidePrime1 = 0x9E3779B185EBCA87ULL;
+/** \private */
+static const uint64_t kMojoWidePrime2 = 0xC2B2AE3D27D4EB4FULL;
+
+/** \private */
+constexpr int _MojoConstLength( const char* s )
+{
+  return *s ? 1 + _MojoConstLength( s + 1 ) : 0;
+}
+
+/** \private */
+constexpr uint64_t _MojoConstWideWord( const char* s, int count )
+{
+  return count ?
+    ( ( uint64_t )( uint8_t )s[ count - 1 ] << ( ( count - 1 ) * 8 ) ) | _MojoConstWideWord( s, count - 1 ) : 0;
+}
+
+/** \private */
+constexpr uint64_t _MojoConstWideRotate( uint64_t x, int bits )
+{
+  return ( x << bits ) | ( x >> ( 64 - bits ) );
+}
+
+/** \private */
+constexpr uint64_t _MojoConstWideRound( uint64_t lane, uint64_t word )
+{
+  return _MojoConstWideRotate( lane + word * kMojoWidePrime2, 31 ) * kMojoWidePrime1;
+}
+
+/** \private */
+constexpr uint64_t _MojoConstWideShift( uint64_t h )
+{
+  return h ^ ( h >> 33 );
+}
+
+/** \private */
+constexpr uint64_t _MojoConstWideTail( const char* s, int count, uint64_t h )
+{
+  return count >= 8 ? _MojoConstWideTail( s + 8, count - 8, _MojoConstWideRound( h, _MojoConstWideWord( s, 8 ) ) ) :
+         count ? _MojoConstWideRound( h, _MojoConstWideWord( s, count ) ) : h;
+}
+
+/** \private */
+constexpr uint64_t _MojoConstWideBody( const char* s, int count, uint64_t lane1, uint64_t lane2 )
+{
+  return count >= 16 ?
+    _MojoConstWideBody( s + 16, count - 16, _MojoConstWideRound( lane1, _MojoConstWideWord( s, 8 ) ),
+                        _MojoConstWideRound( lane2, _MojoConstWideWord( s + 8, 8 ) ) ) :
+    _MojoConstWideShift( _MojoConstWideShift( _MojoConstWideShift(
+      _MojoConstWideTail( s, count, lane1 ^ _MojoConstWideRotate( lane2, 29 ) ) ) * 0xFF51AFD7ED558CCDULL ) *
+      0xC4CEB9FE1A85EC53ULL );
+}
+
+/**
+ \ingroup group_util
+ Same as MojoWideHash64( const char* s ), but can be evaluated at compile time. Intended for string literals.
+ \param s The zero terminated string to hash.
+ \return A hash value.
+ */
+constexpr uint64_t MojoConstWideHash64( const char* s )
+{
+  return ( !s || !*s ) ? 0 : _MojoConstWideBody( s, _MojoConstLength( s ), kMojoWidePrime1 ^ _MojoConstLength( s ),
+                                                kMojoWidePrime2 ^ _MojoConstLength( s ) );
+}
+
+/**
+ \ingroup group_util
+ The string hash used by MojoId, MojoHashable and MojoHashableCString. Either MojoFnv64() or MojoWideHash64(),
+ depending on MOJO_WIDE_STRING_HASH. Use MojoFnv64() directly for hash codes that are persisted.
+ \param s The zero terminated string to hash.
+ \return A hash value.
+ */
+inline uint64_t MojoStringHash64( const char* s )
+{
+#if MOJO_WIDE_STRING_HASH
+  return MojoWideHash64( s );
+#else
+  return MojoFnv64( s );
+#endif
+}
+
+/**
+ \ingroup group_util
+ The string hash used by MojoId, MojoHashable and MojoHashableCString. Either MojoFnv64() or MojoWideHash64(),
+ depending on MOJO_WIDE_STRING_HASH.
+ \param s The string to hash.
+ \param count The number of characters.
+ \return A hash value.
+ */
+inline uint64_t MojoStringHash64( const char* s, int count )
+{
+#if MOJO_WIDE_STRING_HASH
+  return MojoWideHash64( s, count );
+#else
+  return MojoFnv64( s, count );
+#endif
+}
+
+/**
+ \ingroup group_util
+ MojoStringHash64( const char* s, int count ) of four strings at once. The strings are hashed side by side, so that the
+ multiply chain of one does not have to wait for the others. Gives the same results as four separate calls.
+ \param s The four strings to hash.
+ \param count The number of characters of each string.
+ \param[out] hash The four hash values.
+ */
+void MojoStringHash64x4( const char* const* s, const int* count, uint64_t* hash );
+
+/**
+ \ingroup group_util
+ Same as MojoStringHash64( const char* s ), but can be evaluated at compile time.
+ \param s The zero terminated string to hash.
+ \return A hash value.
+ */
+constexpr uint64_t MojoConstStringHash64( const char* s )
+{
+#if MOJO_WIDE_STRING_HASH
+  return MojoConstWideHash64( s );
+#else
+  return MojoConstFnv64( s );
+#endif
+}
+
+/**
+ \ingroup group_util
+ A string that is given by a pointer and a length, such as a token in a larger buffer. It need not be zero terminated,
+ and must not contain zero characters.
+ */
+struct MojoStringView
+{
+  const char* m_Chars;
+  int         m_Length;
+};
+
 /**
  \ingroup group_util
  Substitute for std::max. Something in the libraries we use here at Insomniac causes a compile status if I use std::max
@@ -99,6 +279,22 @@ T MojoMax( const T& a, const T& b ) { return a > b ? a : b; }
 template< typename T >
 T MojoMin( const T& a, const T& b ) { return a <= b ? a : b; }
 
+/**
+ \ingroup group_util
+ Tell the processor that the memory at an address will be read soon. Does nothing if the compiler has no way to say so.
+ \param[in] address Address to prefetch.
+ */
+inline void MojoPrefetch( const void* address )
+{
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+  _mm_prefetch( ( const char* )address, _MM_HINT_T0 );
+#elif defined( __GNUC__ )
+  __builtin_prefetch( address );
+#else
+  ( void )address;
+#endif
+}
+
 /**
  \ingroup group_util
  Template to use an integer type directly as a hash code. The hash code must be well-distributed. Random numbers are
@@ -173,7 +369,7 @@ private:
  \ingroup group_util
  Template to use an integer type indirectly as a hash code. No assumptions are made about suitability for use as a hash
  code. Use this template if you have an integer identifier that is not well-distributed, such as an index.
- The template will compute a hash code by applying a modified FNV-1A algorithm.
+ The template will compute a hash code by applying MojoStringHash64().
  This, of course, incurs more processing overhead than the MojoHash template, which does no processing at all.
  \note Value 0 is reserved and means Null. This marks an empty slot in the hash table.
  */
@@ -217,12 +413,12 @@ public:
   
   /**
    Compute hash code.
-   \return MojoFnv64( &value, sizeof( value ) )
+   \return MojoStringHash64( &value, sizeof( value ) )
    \note Hash table algorithm counts on this function.
    */
   uint64_t GetHash() const
   {
-    return MojoFnv64( ( const char* )&m_Key, sizeof( m_Key ) );
+    return MojoStringHash64( ( const char* )&m_Key, sizeof( m_Key ) );
   }
   
   /**
@@ -242,8 +438,8 @@ private:
 
 /**
  \ingroup group_util
- Template to use a C-string as hash code. The template will compute a hash code by applying a modified FNV-1A
- algorithm. This incurs some processing overhead, especially for long strings. You may want to consider using MojoId
+ Template to use a C-string as hash code. The template will compute a hash code by applying MojoStringHash64().
+ This incurs some processing overhead, especially for long strings. You may want to consider using MojoId
  if you want to index your hash tables with strings.
  \note A NULL pointer is considered a Null hash code, and is used to mark empty slots in the hash table.
  \warning C-string must NOT be the empty string: "".
@@ -287,12 +483,12 @@ public:
   
   /**
    Compute hash code.
-   \return MojoFnv64( value )
+   \return MojoStringHash64( value )
    \note Hash table algorithm counts on this function.
    */
   uint64_t GetHash() const
   {
-    return MojoFnv64( m_Key );
+    return MojoStringHash64( m_Key );
   }
 
   /**
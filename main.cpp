@@ -32,6 +32,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <initializer_list>
 
 // -- MojoLib
 #include "MojoLib.h"
@@ -78,6 +82,44 @@ public:
 
 static CountingAlloc MyCountingAlloc;
 
+// Without reference counts, strings stay in the dictionary until they are swept. Sweep them before counting, so that
+// counts mean the same in both modes. Only valid where no id that is checked later is alive. Empty shards keep their
+// memory until trimmed, which is safe here because the tests run on one thread.
+static void SweepIds()
+{
+#if !MOJO_ID_REFCOUNT
+  g_MojoIdManager.Sweep( g_MojoIdManager.AdvanceEpoch() );
+#endif
+  g_MojoIdManager.Trim();
+}
+
+// Sweep every string except those of the given ids. Without reference counts, this is how dropped strings go.
+static void SweepIdsExcept( std::initializer_list< MojoId > kept )
+{
+#if !MOJO_ID_REFCOUNT
+  uint32_t epoch = g_MojoIdManager.AdvanceEpoch();
+  for( const MojoId& id : kept )
+  {
+    id.Mark();
+  }
+  g_MojoIdManager.Sweep( epoch );
+#else
+  ( void )kept;
+#endif
+}
+
+static int GetActiveAlloc()
+{
+  SweepIds();
+  return MyCountingAlloc.m_ActiveAlloc;
+}
+
+static int GetIdCount()
+{
+  SweepIds();
+  return g_MojoIdManager.GetCount();
+}
+
 // -------------------------------------------------------------------------------------------------------------------
 // I'm using RefCountedInt for other unit tests. Better make sure the class is actually working.
 
@@ -204,7 +246,7 @@ REGISTER_UNIT_TEST( MojoArrayTest, Container )
   EXPECT_INT( 0, array.GetCount() );
   
   array.Destroy();
-  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+  EXPECT_INT( 0, GetActiveAlloc() );
 }
 
 // -------------------------------------------------------------------------------------------------------------------
@@ -285,7 +327,7 @@ REGISTER_UNIT_TEST( MojoArrayTestEdge, Container )
 
   EXPECT_INT( 1, RefCountedInt::s_InfoAssignedCount );  // Remember not_found_value is still in there.
   EXPECT_INT( 1, RefCountedInt::s_InfoConstructedCount );
-  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+  EXPECT_INT( 0, GetActiveAlloc() );
 
   // Re-creating a destroyed object should work. (Note this time it's NOT restricted)
   status = array.Create( __FUNCTION__, -1 );
@@ -325,7 +367,7 @@ REGISTER_UNIT_TEST( MojoArrayTestEdge, Container )
 
   EXPECT_INT( 1, RefCountedInt::s_InfoAssignedCount );  // Remember not_found_value is still in there.
   EXPECT_INT( 1, RefCountedInt::s_InfoConstructedCount );
-  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+  EXPECT_INT( 0, GetActiveAlloc() );
 }
 
 // -------------------------------------------------------------------------------------------------------------------
@@ -408,7 +450,7 @@ REGISTER_UNIT_TEST( MojoMapTest, Container )
   
   map.Destroy();
   EXPECT_INT( 1, RefCountedInt::s_InfoConstructedCount );
-  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+  EXPECT_INT( 0, GetActiveAlloc() );
 }
 
 // -------------------------------------------------------------------------------------------------------------------
@@ -492,7 +534,981 @@ REGISTER_UNIT_TEST( MojoSetTest, Container )
   EXPECT_INT( 0, set.GetCount() );
   
   set.Destroy();
-  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+// -------------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoSetTestChurn, Container )
+{
+  // Lots of collisions, inserts and removes, so that the tables grow and shrink while runs wrap around the end.
+  MojoSet< MojoHash< uint32_t > > set( __FUNCTION__ );
+  MojoMultiMap< MojoHash< uint32_t >, MojoHash< uint32_t > > multi_map( __FUNCTION__, 0 );
+  
+  const int key_range = 3000;
+  bool present[ key_range ] = { false };
+  
+  for( int i = 0; i < 50000; ++i )
+  {
+    uint32_t key = 1 + Random() % key_range;
+    if( Random() % 3 )
+    {
+      EXPECT_INT( kMojoStatus_Ok, set.Insert( key ) );
+      EXPECT_INT( kMojoStatus_Ok, multi_map.Insert( ( key % 499 + 1 ) * 7919, key ) );
+      present[ key - 1 ] = true;
+    }
+    else
+    {
+      EXPECT_INT( present[ key - 1 ] ? kMojoStatus_Ok : kMojoStatus_NotFound, set.Remove( key ) );
+      multi_map.Remove( ( key % 499 + 1 ) * 7919, key );
+      present[ key - 1 ] = false;
+    }
+  }
+  
+  int count = 0;
+  for( int i = 0; i < key_range; ++i )
+  {
+    EXPECT_TRUE( present[ i ] == set.Contains( i + 1 ) );
+    EXPECT_TRUE( present[ i ] == multi_map.Contains( ( ( i + 1 ) % 499 + 1 ) * 7919, i + 1 ) );
+    count += present[ i ];
+  }
+  EXPECT_INT( count, set.GetCount() );
+  EXPECT_INT( count, multi_map.GetCount() );
+  
+  int iteration_count = 0;
+  MojoHash< uint32_t > key;
+  MojoForEachKey( set, key )
+  {
+    EXPECT_TRUE( present[ key - 1 ] );
+    iteration_count += 1;
+  }
+  EXPECT_INT( count, iteration_count );
+  
+  set.Destroy();
+  multi_map.Destroy();
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+// -------------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoSetTestRobinHood, Container )
+{
+  MojoConfig config;
+  config.m_RobinHood = true;
+  config.m_AllocCountMin = 64;
+  
+  MojoSet< MojoHash< uint32_t > > set( __FUNCTION__, &config );
+  MojoMap< MojoHash< uint32_t >, MojoHash< uint32_t > > map( __FUNCTION__, 0, &config );
+  MojoMultiMap< MojoHash< uint32_t >, MojoHash< uint32_t > > multi_map( __FUNCTION__, 0, &config );
+  
+  const int key_range = 3000;
+  bool present[ key_range ] = { false };
+  
+  for( int i = 0; i < 50000; ++i )
+  {
+    uint32_t key = 1 + Random() % key_range;
+    if( Random() % 3 )
+    {
+      EXPECT_INT( kMojoStatus_Ok, set.Insert( key ) );
+      EXPECT_INT( kMojoStatus_Ok, map.Insert( key, key ) );
+      EXPECT_INT( kMojoStatus_Ok, multi_map.Insert( key % 97 + 1, key ) );
+      present[ key - 1 ] = true;
+    }
+    else
+    {
+      EXPECT_INT( present[ key - 1 ] ? kMojoStatus_Ok : kMojoStatus_NotFound, set.Remove( key ) );
+      EXPECT_INT( present[ key - 1 ] ? key : 0, map.Remove( key ) );
+      multi_map.Remove( key % 97 + 1, key );
+      present[ key - 1 ] = false;
+    }
+    if( i % 5000 == 0 )
+    {
+      // Remove all values of one key at once
+      uint32_t multi_key = 1 + Random() % 97;
+      multi_map.Remove( multi_key );
+      for( int k = 0; k < key_range; ++k )
+      {
+        if( ( k + 1 ) % 97 + 1 == ( int )multi_key && present[ k ] )
+        {
+          set.Remove( k + 1 );
+          map.Remove( k + 1 );
+          present[ k ] = false;
+        }
+      }
+    }
+  }
+  
+  int count = 0;
+  for( int i = 0; i < key_range; ++i )
+  {
+    EXPECT_TRUE( present[ i ] == set.Contains( i + 1 ) );
+    EXPECT_TRUE( present[ i ] == map.Contains( i + 1 ) );
+    EXPECT_TRUE( present[ i ] == multi_map.Contains( ( i + 1 ) % 97 + 1, i + 1 ) );
+    count += present[ i ];
+  }
+  EXPECT_INT( count, set.GetCount() );
+  EXPECT_INT( count, map.GetCount() );
+  EXPECT_INT( count, multi_map.GetCount() );
+  
+  // Shrink back down, in place and through reallocation
+  for( int i = 0; i < key_range; ++i )
+  {
+    set.Remove( i + 1 );
+    map.Remove( i + 1 );
+    multi_map.Remove( ( i + 1 ) % 97 + 1, i + 1 );
+  }
+  EXPECT_INT( 0, set.GetCount() );
+  EXPECT_INT( 0, map.GetCount() );
+  EXPECT_INT( 0, multi_map.GetCount() );
+  
+  set.Destroy();
+  map.Destroy();
+  multi_map.Destroy();
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+// -------------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoSetTestIncremental, Container )
+{
+  for( int robin_hood = 0; robin_hood < 2; ++robin_hood )
+  {
+    MojoConfig config;
+    config.m_RobinHood = robin_hood != 0;
+    config.m_ResizeStepCount = 1;
+    config.m_AllocCountMin = 64;
+    
+    MojoSet< MojoHash< uint32_t > > set( __FUNCTION__, &config );
+    MojoMap< MojoHash< uint32_t >, MojoHash< uint32_t > > map( __FUNCTION__, 0, &config );
+    MojoMultiMap< MojoHash< uint32_t >, MojoHash< uint32_t > > multi_map( __FUNCTION__, 0, &config );
+    
+    const int key_range = 3000;
+    bool present[ key_range ] = { false };
+    int count = 0;
+    
+    for( int i = 0; i < 30000; ++i )
+    {
+      // Grow for a while, then shrink for a while
+      uint32_t key = 1 + Random() % key_range;
+      if( ( Random() % 100 ) < ( ( i / 10000 ) % 2 ? 20 : 70 ) )
+      {
+        EXPECT_INT( kMojoStatus_Ok, set.Insert( key ) );
+        EXPECT_INT( kMojoStatus_Ok, map.Insert( key, key ) );
+        EXPECT_INT( kMojoStatus_Ok, multi_map.Insert( ( key % 499 + 1 ) * 7919, key ) );
+        count += !present[ key - 1 ];
+        present[ key - 1 ] = true;
+      }
+      else
+      {
+        EXPECT_INT( present[ key - 1 ] ? kMojoStatus_Ok : kMojoStatus_NotFound, set.Remove( key ) );
+        EXPECT_INT( present[ key - 1 ] ? key : 0, map.Remove( key ) );
+        multi_map.Remove( ( key % 499 + 1 ) * 7919, key );
+        count -= present[ key - 1 ];
+        present[ key - 1 ] = false;
+      }
+      
+      if( i % 250 == 0 )
+      {
+        // Look-ups and iteration must see both tables while a resize is in progress
+        EXPECT_INT( count, set.GetCount() );
+        EXPECT_INT( count, map.GetCount() );
+        EXPECT_INT( count, multi_map.GetCount() );
+        
+        int iteration_count = 0;
+        MojoHash< uint32_t > k, v;
+        MojoForEachKey( map, k )
+        {
+          EXPECT_TRUE( present[ k - 1 ] );
+          EXPECT_INT( k, map.Find( k ) );
+          iteration_count += 1;
+        }
+        EXPECT_INT( count, iteration_count );
+        
+        iteration_count = 0;
+        MojoForEachKey( multi_map, k )
+        {
+          MojoForEachMultiValue( multi_map, k, v )
+          {
+            EXPECT_INT( k, ( v % 499 + 1 ) * 7919 );
+            EXPECT_TRUE( set.Contains( v ) );
+            iteration_count += 1;
+          }
+        }
+        EXPECT_INT( count, iteration_count );
+      }
+    }
+    
+    for( int i = 0; i < key_range; ++i )
+    {
+      EXPECT_TRUE( present[ i ] == set.Contains( i + 1 ) );
+      EXPECT_TRUE( present[ i ] == map.Contains( i + 1 ) );
+      EXPECT_TRUE( present[ i ] == multi_map.Contains( ( ( i + 1 ) % 499 + 1 ) * 7919, i + 1 ) );
+    }
+    
+    set.Destroy();
+    map.Destroy();
+    multi_map.Destroy();
+    EXPECT_INT( 0, GetActiveAlloc() );
+  }
+}
+
+// -------------------------------------------------------------------------------------------------------------------
+// Key that counts how many times it gets hashed.
+
+static int HashCallCount = 0;
+
+class CountedHashKey
+{
+public:
+  CountedHashKey() : m_Key( 0 ) {}
+  CountedHashKey( uint32_t key ) : m_Key( key ) {}
+  bool operator== ( const CountedHashKey& other ) const { return m_Key == other.m_Key; }
+  uint64_t GetHash() const { HashCallCount += 1; return ( m_Key / 2 ) * 2654435761ull; }
+  bool IsHashNull() const { return m_Key == 0; }
+  uint32_t m_Key;
+};
+
+REGISTER_UNIT_TEST( MojoSetTestCacheHash, Container )
+{
+  // Robin Hood mode caches hash codes by itself, for its probe distances
+  for( int variant = 0; variant < 4; ++variant )
+  {
+    MojoConfig config;
+    config.m_CacheHash = variant != 3;
+    config.m_RobinHood = variant == 1 || variant == 3;
+    config.m_ResizeStepCount = variant == 2 ? 1 : 0;
+    
+    MojoSet< CountedHashKey > set( __FUNCTION__, &config );
+    MojoMap< CountedHashKey, MojoHash< uint32_t > > map( __FUNCTION__, 0, &config );
+    MojoMultiMap< CountedHashKey, MojoHash< uint32_t > > multi_map( __FUNCTION__, 0, &config );
+    
+    // Keys 2n and 2n+1 share a hash code, so comparing the cached hash codes is not enough to tell keys apart
+    const int key_count = 5000;
+    HashCallCount = 0;
+    for( int i = 1; i <= key_count; ++i )
+    {
+      EXPECT_INT( kMojoStatus_Ok, set.Insert( i ) );
+      EXPECT_INT( kMojoStatus_Ok, map.Insert( i, i ) );
+      EXPECT_INT( kMojoStatus_Ok, multi_map.Insert( i, i ) );
+    }
+    
+    // Growing the tables never hashes the keys again
+    EXPECT_INT( 3 * key_count, HashCallCount );
+    
+    HashCallCount = 0;
+    for( int i = 1; i <= key_count; i += 2 )
+    {
+      EXPECT_INT( kMojoStatus_Ok, set.Remove( i ) );
+      EXPECT_INT( i, map.Remove( i ) );
+      multi_map.Remove( i );
+    }
+    
+    // Neither does removing keys and shrinking the tables
+    EXPECT_INT( 3 * ( key_count / 2 ), HashCallCount );
+    
+    for( int i = 1; i <= key_count; ++i )
+    {
+      bool present = ( i % 2 ) == 0;
+      EXPECT_TRUE( present == set.Contains( i ) );
+      EXPECT_INT( present ? i : 0, map.Find( i ) );
+      EXPECT_TRUE( present == multi_map.Contains( i, i ) );
+    }
+    EXPECT_INT( key_count / 2, set.GetCount() );
+    EXPECT_INT( key_count / 2, map.GetCount() );
+    EXPECT_INT( key_count / 2, multi_map.GetCount() );
+    
+    set.Destroy();
+    map.Destroy();
+    multi_map.Destroy();
+    EXPECT_INT( 0, GetActiveAlloc() );
+  }
+}
+
+// -------------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoSetTestReserve, Container )
+{
+  const int key_count = 10000;
+  static MojoHash< uint32_t > keys[ key_count ];
+  static MojoHash< uint32_t > values[ key_count ];
+  MojoArray< MojoHash< uint32_t > > key_array( __FUNCTION__ );
+  for( int i = 0; i < key_count; ++i )
+  {
+    keys[ i ] = 1 + Random() % 1000000;
+    values[ i ] = i;
+    key_array.Push( keys[ i ] );
+  }
+  
+  MojoSet< MojoHash< uint32_t > > set( __FUNCTION__ );
+  MojoMap< MojoHash< uint32_t >, MojoHash< uint32_t > > map( __FUNCTION__, 0 );
+  
+  // Inserting the range allocates the table once
+  int total_alloc = MyCountingAlloc.m_TotalAlloc;
+  EXPECT_INT( kMojoStatus_Ok, set.InsertRange( keys, key_count ) );
+  EXPECT_INT( kMojoStatus_Ok, map.InsertRange( keys, values, key_count ) );
+  EXPECT_INT( total_alloc + 2, MyCountingAlloc.m_TotalAlloc );
+  
+  // Inserting again what was reserved for does not allocate either
+  EXPECT_INT( kMojoStatus_Ok, map.Reserve( key_count ) );
+  EXPECT_INT( total_alloc + 2, MyCountingAlloc.m_TotalAlloc );
+  for( int i = 0; i < key_count; ++i )
+  {
+    EXPECT_TRUE( set.Contains( keys[ i ] ) );
+    EXPECT_INT( kMojoStatus_Ok, map.Insert( keys[ i ], values[ i ] ) );
+  }
+  EXPECT_INT( total_alloc + 2, MyCountingAlloc.m_TotalAlloc );
+  EXPECT_INT( set.GetCount(), map.GetCount() );
+  
+  // Copy a set expression, and an array. The array underestimates its enumeration cost.
+  MojoSet< MojoHash< uint32_t > > other( __FUNCTION__ );
+  for( int i = 0; i < 500; ++i )
+  {
+    other.Insert( 2000000 + i );
+  }
+  MojoUnion< MojoHash< uint32_t > > both( &set, &other );
+  MojoSet< MojoHash< uint32_t > > copy( __FUNCTION__ );
+  EXPECT_INT( kMojoStatus_Ok, copy.InsertFrom( both ) );
+  EXPECT_INT( set.GetCount() + other.GetCount(), copy.GetCount() );
+  
+  MojoSet< MojoHash< uint32_t > > from_array( __FUNCTION__ );
+  EXPECT_INT( kMojoStatus_Ok, from_array.InsertFrom( key_array ) );
+  EXPECT_INT( set.GetCount(), from_array.GetCount() );
+  
+  {
+    MojoCacheSet< MojoHash< uint32_t > > cache( __FUNCTION__, &both );
+    cache.Update();
+    for( int i = 0; i < key_count; ++i )
+    {
+      EXPECT_TRUE( cache.Contains( keys[ i ] ) );
+      EXPECT_TRUE( from_array.Contains( keys[ i ] ) );
+    }
+    EXPECT_TRUE( cache.Contains( 2000000 ) );
+    EXPECT_FALSE( cache.Contains( 1000001 ) );
+  }
+  
+  // A fixed capacity table takes what fits
+  MojoConfig config;
+  config.m_DynamicAlloc = false;
+  config.m_AllocCountMin = 64;
+  MojoSet< MojoHash< uint32_t > > small( __FUNCTION__, &config );
+  EXPECT_INT( kMojoStatus_CouldNotAlloc, small.Reserve( 1000 ) );
+  EXPECT_INT( kMojoStatus_CouldNotAlloc, small.InsertRange( keys, 1000 ) );
+  EXPECT_INT( 64, small.GetCount() );
+  
+  set.Destroy();
+  map.Destroy();
+  other.Destroy();
+  copy.Destroy();
+  from_array.Destroy();
+  small.Destroy();
+  key_array.Destroy();
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+// -------------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoPooledMultiMapTest, Container )
+{
+  // Same operations on both multi-map layouts must give the same contents
+  MojoMultiMap< MojoHash< uint32_t >, MojoHash< uint32_t > > multi_map( __FUNCTION__, 0 );
+  MojoPooledMultiMap< MojoHash< uint32_t >, MojoHash< uint32_t > > pooled( __FUNCTION__, 0 );
+  
+  const int key_range = 500;
+  for( int i = 0; i < 20000; ++i )
+  {
+    uint32_t key = ( 1 + Random() % key_range ) * 7919;
+    uint32_t value = 1 + Random() % 20;
+    int op = Random() % 100;
+    if( op < 60 )
+    {
+      EXPECT_INT( kMojoStatus_Ok, multi_map.Insert( key, value ) );
+      EXPECT_INT( kMojoStatus_Ok, pooled.Insert( key, value ) );
+    }
+    else if( op < 97 )
+    {
+      EXPECT_INT( multi_map.Remove( key, value ), pooled.Remove( key, value ) );
+    }
+    else
+    {
+      EXPECT_INT( multi_map.Remove( key ), pooled.Remove( key ) );
+    }
+    
+    if( i % 1000 == 0 )
+    {
+      EXPECT_INT( multi_map.GetCount(), pooled.GetCount() );
+      for( uint32_t k = 7919; k <= key_range * 7919; k += 7919 )
+      {
+        EXPECT_INT( multi_map.GetValueCount( k ), pooled.GetValueCount( k ) );
+        EXPECT_TRUE( multi_map.Contains( k ) == pooled.Contains( k ) );
+        
+        MojoHash< uint32_t > v;
+        int value_count = 0;
+        MojoForEachMultiValue( pooled, k, v )
+        {
+          EXPECT_TRUE( multi_map.Contains( k, v ) );
+          value_count += 1;
+        }
+        EXPECT_INT( pooled.GetValueCount( k ), value_count );
+      }
+      
+      int pair_count = 0;
+      MojoHash< uint32_t > k, v;
+      MojoForEachKey( pooled, k )
+      {
+        EXPECT_TRUE( multi_map.Contains( k, pooled.Find( k ) ) );
+        MojoForEachMultiValue( pooled, k, v )
+        {
+          pair_count += 1;
+        }
+      }
+      EXPECT_INT( pooled.GetCount(), pair_count );
+    }
+  }
+  
+  pooled.Reset();
+  EXPECT_INT( 0, pooled.GetCount() );
+  EXPECT_FALSE( pooled.Contains( 1 ) );
+  EXPECT_INT( kMojoStatus_NotFound, pooled.Remove( 1 ) );
+  
+  // A fixed size pool compacts itself to make room
+  MojoConfig config;
+  config.m_DynamicAlloc = false;
+  config.m_AllocCountMin = 64;
+  MojoPooledMultiMap< MojoHash< uint32_t >, MojoHash< uint32_t > > small( __FUNCTION__, 0, &config );
+  for( uint32_t i = 1; i <= 32; ++i )
+  {
+    EXPECT_INT( kMojoStatus_Ok, small.Insert( i, i ) );
+    EXPECT_INT( kMojoStatus_Ok, small.Insert( i, i + 1 ) );
+  }
+  EXPECT_INT( kMojoStatus_CouldNotAlloc, small.Insert( 1, 3 ) );
+  EXPECT_INT( kMojoStatus_Ok, small.Remove( 2 ) );
+  EXPECT_INT( kMojoStatus_Ok, small.Remove( 3 ) );
+  EXPECT_INT( kMojoStatus_Ok, small.Insert( 1, 3 ) );
+  EXPECT_INT( 3, small.GetValueCount( 1 ) );
+  EXPECT_INT( 2, small.GetValueCount( 32 ) );
+  EXPECT_TRUE( small.Contains( 32, 33 ) );
+  
+  multi_map.Destroy();
+  pooled.Destroy();
+  small.Destroy();
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+// -------------------------------------------------------------------------------------------------------------------
+// CountingAlloc is not safe to call from several threads at once. This one is.
+
+class AtomicCountingAlloc final : public MojoAlloc
+{
+public:
+  AtomicCountingAlloc()
+  : m_ActiveAlloc( 0 )
+  {}
+  virtual void* Allocate( size_t byte_count, const char* ) override
+  {
+    m_ActiveAlloc += 1;
+    return malloc( byte_count );
+  }
+  virtual void Free( void* p ) override
+  {
+    m_ActiveAlloc -= 1;
+    free( p );
+  }
+  std::atomic< int > m_ActiveAlloc;
+};
+
+REGISTER_UNIT_TEST( MojoConcurrentMapTest, Container )
+{
+  AtomicCountingAlloc alloc;
+  MojoConcurrentMap< MojoHash< uint32_t >, MojoHash< uint32_t > > map( __FUNCTION__, 0, NULL, &alloc );
+  
+  // Each thread inserts its own range of keys, and removes every third one again
+  const int thread_count = 4;
+  const int key_count = 20000;
+  std::thread threads[ thread_count ];
+  for( int t = 0; t < thread_count; ++t )
+  {
+    threads[ t ] = std::thread( [ &map, t ]()
+    {
+      for( uint32_t i = 1; i <= key_count; ++i )
+      {
+        uint32_t key = t * key_count + i;
+        map.Insert( key, key * 2 );
+        if( i % 3 == 0 )
+        {
+          map.Remove( key - 1 );
+        }
+      }
+    } );
+  }
+  for( int t = 0; t < thread_count; ++t )
+  {
+    threads[ t ].join();
+  }
+  
+  int count = 0;
+  for( uint32_t key = 1; key <= thread_count * key_count; ++key )
+  {
+    bool present = ( key % key_count ) % 3 != 2;
+    EXPECT_TRUE( present == map.Contains( key ) );
+    EXPECT_INT( present ? key * 2 : 0, map.Find( key ) );
+    count += present;
+  }
+  EXPECT_INT( count, map.GetCount() );
+  
+  MojoSet< MojoHash< uint32_t > > keys( __FUNCTION__ );
+  map.Enumerate( MojoSetCollector< MojoHash< uint32_t > >( &keys ) );
+  EXPECT_INT( count, keys.GetCount() );
+  
+  // The limit may be the map itself, as in a set expression that refers to it twice
+  MojoSet< MojoHash< uint32_t > > limited_keys( __FUNCTION__ );
+  map.Enumerate( MojoSetCollector< MojoHash< uint32_t > >( &limited_keys ), &map );
+  EXPECT_INT( count, limited_keys.GetCount() );
+  limited_keys.Destroy();
+  
+  // Single keys
+  EXPECT_INT( 0, map.Remove( 2 ) );
+  EXPECT_INT( 2, map.Remove( 1 ) );
+  EXPECT_INT( kMojoStatus_InvalidArguments, map.Insert( 0, 1 ) );
+  
+  keys.Destroy();
+  map.Destroy();
+  EXPECT_INT( 0, alloc.m_ActiveAlloc );
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+REGISTER_UNIT_TEST( MojoSnapshotTest, Container )
+{
+  // Only the writer allocates, so the plain counting allocator will do
+  MojoQsbr qsbr;
+  MojoSnapshotSet< MojoHash< uint32_t > > set( __FUNCTION__, NULL, &MyCountingAlloc, &qsbr );
+  MojoSnapshotMap< MojoHash< uint32_t >, MojoHash< uint32_t > > map( __FUNCTION__, 0, NULL, &MyCountingAlloc, &qsbr );
+  EXPECT_INT( 0, set.GetCount() );
+  EXPECT_FALSE( map.Contains( 1 ) );
+  
+  // Version n of the set holds keys 1 to n * 10, and the map maps key 1 to n. Readers must never see a partial version.
+  const int version_count = 300;
+  const int reader_count = 3;
+  std::atomic< bool > done( false );
+  std::atomic< int > error_count( 0 );
+  std::thread readers[ reader_count ];
+  for( int r = 0; r < reader_count; ++r )
+  {
+    readers[ r ] = std::thread( [ & ]()
+    {
+      int reader = qsbr.RegisterReader();
+      uint32_t last_version = 0;
+      while( !done.load() )
+      {
+        const MojoSet< MojoHash< uint32_t > >* snapshot = set.GetSnapshot();
+        int count = snapshot->GetCount();
+        if( count % 10 != 0 || ( count && !snapshot->Contains( count ) ) || snapshot->Contains( count + 1 ) )
+        {
+          error_count += 1;
+        }
+        uint32_t version = map.Find( 1 );
+        if( version < last_version )
+        {
+          error_count += 1;
+        }
+        last_version = version;
+        qsbr.Quiescent( reader );
+      }
+      qsbr.UnregisterReader( reader );
+    } );
+  }
+  
+  for( uint32_t n = 1; n <= version_count; ++n )
+  {
+    for( uint32_t key = ( n - 1 ) * 10 + 1; key <= n * 10; ++key )
+    {
+      EXPECT_INT( kMojoStatus_Ok, set.Insert( key ) );
+    }
+    EXPECT_INT( kMojoStatus_Ok, map.Insert( 1, n ) );
+    EXPECT_FALSE( set.Contains( n * 10 ) );
+    EXPECT_INT( kMojoStatus_Ok, set.Publish() );
+    EXPECT_INT( kMojoStatus_Ok, map.Publish() );
+    EXPECT_TRUE( set.Contains( n * 10 ) );
+  }
+  done.store( true );
+  for( int r = 0; r < reader_count; ++r )
+  {
+    readers[ r ].join();
+  }
+  EXPECT_INT( 0, error_count.load() );
+  
+  EXPECT_INT( version_count * 10, set.GetCount() );
+  EXPECT_INT( version_count, map.Find( 1 ) );
+  EXPECT_INT( 0, map.Find( 2 ) );
+  
+  // With all readers gone, every old version can go
+  set.Reclaim();
+  map.Reclaim();
+  EXPECT_INT( version_count, map.Remove( 1 ) );
+  map.Publish();
+  EXPECT_FALSE( map.Contains( 1 ) );
+  
+  MojoSet< MojoHash< uint32_t > > keys( __FUNCTION__ );
+  set.Enumerate( MojoSetCollector< MojoHash< uint32_t > >( &keys ) );
+  EXPECT_INT( version_count * 10, keys.GetCount() );
+  
+  keys.Destroy();
+  set.Destroy();
+  map.Destroy();
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+// -------------------------------------------------------------------------------------------------------------------
+
+REGISTER_UNIT_TEST( MojoArenaAllocTest, Container )
+{
+  {
+    MojoArenaAlloc arena( 1024, true, &MyCountingAlloc );
+    int start_alloc = MyCountingAlloc.m_ActiveAlloc;
+    
+    // Containers allocate from the arena, and freeing does nothing
+    MojoSet< MojoHash< uint32_t > > set( __FUNCTION__, NULL, &arena );
+    MojoArray< int > array( __FUNCTION__, 0, NULL, &arena );
+    for( uint32_t i = 1; i <= 1000; ++i )
+    {
+      set.Insert( i );
+      array.Push( ( int )i );
+    }
+    EXPECT_INT( 1000, set.GetCount() );
+    EXPECT_INT( 500, array[ 499 ] );
+    EXPECT_TRUE( set.Contains( 777 ) );
+    EXPECT_TRUE( arena.GetUsedSize() > 1024 );
+    EXPECT_TRUE( MyCountingAlloc.m_ActiveAlloc - start_alloc > 1 );
+    set.Destroy();
+    array.Destroy();
+    
+    // Reset keeps only the newest block, which is big enough for the next round
+    size_t used_size = arena.GetUsedSize();
+    arena.Reset();
+    EXPECT_INT( 0, ( int )arena.GetUsedSize() );
+    EXPECT_INT( start_alloc + 1, MyCountingAlloc.m_ActiveAlloc );
+    EXPECT_TRUE( arena.GetCapacity() >= used_size / 2 );
+    void* p1 = arena.Allocate( 3, "test" );
+    void* p2 = arena.Allocate( 3, "test" );
+    EXPECT_INT( 0, ( int )( ( uintptr_t )p2 % 16 ) );
+    EXPECT_INT( 16, ( int )( ( char* )p2 - ( char* )p1 ) );
+    EXPECT_INT( start_alloc + 1, MyCountingAlloc.m_ActiveAlloc );
+    
+    // A fixed arena fails when full
+    MojoArenaAlloc fixed( 64, false, &MyCountingAlloc );
+    EXPECT_TRUE( fixed.Allocate( 48, "test" ) != NULL );
+    EXPECT_TRUE( fixed.Allocate( 32, "test" ) == NULL );
+  }
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+REGISTER_UNIT_TEST( MojoPoolAllocTest, Container )
+{
+  AtomicCountingAlloc backing;
+  {
+    MojoPoolAlloc pool( &backing );
+    
+    // Blocks of a size class are reused, and big requests go to the backing allocator
+    void* p1 = pool.Allocate( 100, "test" );
+    pool.Free( p1 );
+    void* p2 = pool.Allocate( 128, "test" );
+    EXPECT_TRUE( p1 == p2 );
+    EXPECT_INT( 0, ( int )( ( uintptr_t )p2 % 16 ) );
+    int chunk_alloc = backing.m_ActiveAlloc;
+    void* big = pool.Allocate( ( ( size_t )1 << kMojoPoolClassShiftMax ) + 1, "test" );
+    EXPECT_INT( chunk_alloc + 1, backing.m_ActiveAlloc );
+    pool.Free( big );
+    pool.Free( p2 );
+    EXPECT_INT( chunk_alloc, backing.m_ActiveAlloc );
+    
+    // A set that grows and shrinks over and over stops needing new chunks
+    MojoSet< MojoHash< uint32_t > > set( __FUNCTION__, NULL, &pool );
+    for( int round = 0; round < 3; ++round )
+    {
+      for( uint32_t i = 1; i <= 5000; ++i )
+      {
+        set.Insert( i );
+      }
+      for( uint32_t i = 1; i <= 5000; ++i )
+      {
+        set.Remove( i );
+      }
+      chunk_alloc = round == 0 ? backing.m_ActiveAlloc.load() : chunk_alloc;
+    }
+    EXPECT_INT( chunk_alloc, backing.m_ActiveAlloc );
+    set.Destroy();
+    
+    // Threads allocate, fill and free blocks of all sizes, and free blocks that other threads allocated
+    const int thread_count = 4;
+    std::atomic< int > error_count( 0 );
+    std::thread threads[ thread_count ];
+    void* shared_blocks[ thread_count ] = { NULL };
+    for( int t = 0; t < thread_count; ++t )
+    {
+      threads[ t ] = std::thread( [ &pool, &error_count, &shared_blocks, t ]()
+      {
+        void* held[ 32 ] = { NULL };
+        for( int i = 0; i < 20000; ++i )
+        {
+          int k = ( i * 7 + t ) % 32;
+          size_t size = ( size_t )16 << ( ( i + t ) % 12 );
+          pool.Free( held[ k ] );
+          held[ k ] = pool.Allocate( size, "test" );
+          memset( held[ k ], k, size );
+          unsigned char* other = ( unsigned char* )held[ ( k + 1 ) % 32 ];
+          if( other && other[ 0 ] != ( k + 1 ) % 32 )
+          {
+            error_count += 1;
+          }
+        }
+        shared_blocks[ t ] = held[ 0 ];
+        held[ 0 ] = NULL;
+        for( int k = 0; k < 32; ++k )
+        {
+          pool.Free( held[ k ] );
+        }
+      } );
+    }
+    for( int t = 0; t < thread_count; ++t )
+    {
+      threads[ t ].join();
+      pool.Free( shared_blocks[ t ] );
+    }
+    EXPECT_INT( 0, error_count.load() );
+    EXPECT_TRUE( pool.GetChunkSize() > 0 );
+  }
+  EXPECT_INT( 0, backing.m_ActiveAlloc.load() );
+}
+
+REGISTER_UNIT_TEST( MojoAllocTestReallocate, Container )
+{
+  {
+    // An allocator that only implements Allocate() and Free() gets copying Reallocate() and FreeSized()
+    int start_alloc = MyCountingAlloc.m_ActiveAlloc;
+    char* p = ( char* )MyCountingAlloc.Reallocate( NULL, 0, 10, "test" );
+    memcpy( p, "012345678", 10 );
+    p = ( char* )MyCountingAlloc.Reallocate( p, 10, 1000, "test" );
+    EXPECT_TRUE( strcmp( p, "012345678" ) == 0 );
+    EXPECT_INT( start_alloc + 1, MyCountingAlloc.m_ActiveAlloc );
+    MyCountingAlloc.FreeSized( p, 1000 );
+    EXPECT_INT( start_alloc, MyCountingAlloc.m_ActiveAlloc );
+    
+    p = ( char* )MojoAlloc::GetDefault()->Reallocate( NULL, 0, 10, "test" );
+    memcpy( p, "012345678", 10 );
+    p = ( char* )MojoAlloc::GetDefault()->Reallocate( p, 10, 100000, "test" );
+    EXPECT_TRUE( strcmp( p, "012345678" ) == 0 );
+    MojoAlloc::GetDefault()->FreeSized( p, 100000 );
+  }
+  {
+    // The arena resizes and gives back its most recent allocation in place
+    MojoArenaAlloc arena( 64 * 1024, true, &MyCountingAlloc );
+    void* p1 = arena.Allocate( 40, "test" );
+    void* p2 = arena.Allocate( 40, "test" );
+    EXPECT_TRUE( arena.Reallocate( p2, 40, 1000, "test" ) == p2 );
+    EXPECT_INT( 48 + 1008, ( int )arena.GetUsedSize() );
+    void* p3 = arena.Reallocate( p1, 40, 100, "test" );
+    EXPECT_TRUE( p3 != p1 );
+    arena.FreeSized( p3, 100 );
+    arena.FreeSized( p1, 40 );
+    EXPECT_INT( 48 + 1008, ( int )arena.GetUsedSize() );
+    arena.FreeSized( p2, 1000 );
+    EXPECT_INT( 48, ( int )arena.GetUsedSize() );
+    arena.Reset();
+    
+    // So an array that is alone in an arena never copies when it grows
+    MojoArray< int > array( __FUNCTION__, 0, NULL, &arena );
+    for( int i = 0; i < 1000; ++i )
+    {
+      array.Push( i );
+    }
+    EXPECT_INT( 999, array[ 999 ] );
+    EXPECT_TRUE( arena.GetUsedSize() < 1024 * sizeof( int ) + kMojoCacheLineSize );
+    array.Destroy();
+    EXPECT_TRUE( arena.GetUsedSize() < kMojoCacheLineSize );
+  }
+  {
+    // The pool keeps a block that still fits its size class, and FreeSized() skips the block header
+    AtomicCountingAlloc backing;
+    MojoPoolAlloc pool( &backing );
+    void* p = pool.Allocate( 100, "test" );
+    EXPECT_TRUE( pool.Reallocate( p, 100, 128, "test" ) == p );
+    void* big = pool.Reallocate( p, 128, ( ( size_t )1 << kMojoPoolClassShiftMax ) + 1, "test" );
+    EXPECT_TRUE( big != p );
+    big = pool.Reallocate( big, ( ( size_t )1 << kMojoPoolClassShiftMax ) + 1, ( ( size_t )1 << kMojoPoolClassShiftMax ) + 2, "test" );
+    pool.FreeSized( big, ( ( size_t )1 << kMojoPoolClassShiftMax ) + 2 );
+    EXPECT_TRUE( pool.Allocate( 120, "test" ) == p );
+    pool.FreeSized( p, 120 );
+  }
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+REGISTER_UNIT_TEST( MojoAllocTestAligned, Container )
+{
+  // Records the alignment that containers ask for, and leaves the aligning to the default implementation
+  class AlignCheckAlloc final : public MojoAlloc
+  {
+  public:
+    AlignCheckAlloc() : m_AlignedCount( 0 ), m_UnalignedCount( 0 ) {}
+    virtual void* Allocate( size_t byte_count, const char* name ) override
+    {
+      return MyCountingAlloc.Allocate( byte_count, name );
+    }
+    virtual void Free( void* p ) override
+    {
+      MyCountingAlloc.Free( p );
+    }
+    virtual void* AllocateAligned( size_t byte_count, size_t alignment, const char* name ) override
+    {
+      void* p = MojoAlloc::AllocateAligned( byte_count, alignment, name );
+      m_AlignedCount += 1;
+      m_UnalignedCount += ( alignment < kMojoCacheLineSize || ( uintptr_t )p % alignment ) ? 1 : 0;
+      return p;
+    }
+    int m_AlignedCount;
+    int m_UnalignedCount;
+  };
+  
+  {
+    AlignCheckAlloc alloc;
+    MojoArray< int > array( __FUNCTION__, 0, NULL, &alloc );
+    MojoSet< MojoHash< uint32_t > > set( __FUNCTION__, NULL, &alloc );
+    MojoMap< MojoHash< uint32_t >, int > map( __FUNCTION__, 0, NULL, &alloc );
+    MojoMultiMap< MojoHash< uint32_t >, int > multi_map( __FUNCTION__, 0, NULL, &alloc );
+    for( uint32_t i = 1; i <= 1000; ++i )
+    {
+      array.Push( ( int )i );
+      set.Insert( i );
+      map.Insert( i, ( int )i );
+      multi_map.Insert( i, ( int )i );
+    }
+    EXPECT_TRUE( alloc.m_AlignedCount >= 4 );
+    EXPECT_INT( 0, alloc.m_UnalignedCount );
+    EXPECT_INT( 1000, array[ 999 ] );
+    EXPECT_TRUE( set.Contains( 1000 ) );
+    EXPECT_INT( 1000, map.Find( 1000 ) );
+    array.Destroy();
+    set.Destroy();
+    map.Destroy();
+    multi_map.Destroy();
+    EXPECT_INT( 0, GetActiveAlloc() );
+  }
+  
+  // The default allocator and the arena align blocks directly, including when they grow
+  for( size_t alignment = 16; alignment <= 4096; alignment *= 4 )
+  {
+    MojoAlloc* alloc = MojoAlloc::GetDefault();
+    char* p = ( char* )alloc->AllocateAligned( 10, alignment, "test" );
+    EXPECT_INT( 0, ( int )( ( uintptr_t )p % alignment ) );
+    memcpy( p, "012345678", 10 );
+    p = ( char* )alloc->ReallocateAligned( p, 10, 100000, alignment, "test" );
+    EXPECT_INT( 0, ( int )( ( uintptr_t )p % alignment ) );
+    EXPECT_TRUE( strcmp( p, "012345678" ) == 0 );
+    alloc->FreeAligned( p, 100000, alignment );
+    
+    MojoArenaAlloc arena( 1024, true, &MyCountingAlloc );
+    arena.Allocate( 3, "test" );
+    p = ( char* )arena.AllocateAligned( 10, alignment, "test" );
+    EXPECT_INT( 0, ( int )( ( uintptr_t )p % alignment ) );
+    EXPECT_TRUE( arena.ReallocateAligned( p, 10, 20, alignment, "test" ) == p );
+  }
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+REGISTER_UNIT_TEST( MojoHugePageAllocTest, Container )
+{
+  for( int use_hugetlb = 0; use_hugetlb < 2; ++use_hugetlb )
+  {
+    MojoHugePageAlloc alloc( use_hugetlb != 0, &MyCountingAlloc );
+    
+    // Small requests go to the other allocator
+    void* small = alloc.Allocate( 100, "test" );
+    EXPECT_INT( 1, MyCountingAlloc.m_ActiveAlloc );
+    EXPECT_INT( 0, ( int )alloc.GetMappedSize() );
+    alloc.Free( small );
+    
+    // Large requests are mapped in whole huge pages, except where mmap() is not available
+    size_t size = ( size_t )kMojoHugePageThreshold * 3;
+    char* p = ( char* )alloc.AllocateAligned( size, kMojoCacheLineSize, "test" );
+    EXPECT_TRUE( p != NULL );
+    EXPECT_INT( 0, ( int )( ( uintptr_t )p % kMojoCacheLineSize ) );
+    memset( p, 1, size );
+    EXPECT_INT( 1, p[ size - 1 ] );
+#if defined( __linux__ )
+    EXPECT_INT( 0, GetActiveAlloc() );
+    EXPECT_INT( 0, ( int )( alloc.GetMappedSize() % kMojoHugePageSize ) );
+    EXPECT_TRUE( alloc.GetMappedSize() >= size );
+    EXPECT_TRUE( alloc.GetHugeTlbSize() <= alloc.GetMappedSize() );
+#endif
+    alloc.FreeAligned( p, size, kMojoCacheLineSize );
+    EXPECT_INT( 0, ( int )alloc.GetMappedSize() );
+    EXPECT_INT( 0, ( int )alloc.GetHugeTlbSize() );
+    
+    // Blocks that are not mapped keep their alignment too
+    for( size_t alignment = 16; alignment <= 4096; alignment *= 2 )
+    {
+      char* aligned = ( char* )alloc.AllocateAligned( alignment == 4096 ? size : 100, alignment, "test" );
+      EXPECT_INT( 0, ( int )( ( uintptr_t )aligned % alignment ) );
+      alloc.FreeAligned( aligned, alignment == 4096 ? size : 100, alignment );
+    }
+    EXPECT_INT( 0, GetActiveAlloc() );
+    
+    // A map grows from small tables into mapped ones, and gives everything back
+    MojoMap< MojoHash< uint32_t >, uint32_t > map( __FUNCTION__, 0, NULL, &alloc );
+    for( uint32_t i = 1; i <= 200000; ++i )
+    {
+      map.Insert( i, i * 3 );
+    }
+    EXPECT_INT( 600000, map.Find( 200000 ) );
+    EXPECT_INT( 3, map.Find( 1 ) );
+    map.Destroy();
+    EXPECT_INT( 0, ( int )alloc.GetMappedSize() );
+    EXPECT_INT( 0, GetActiveAlloc() );
+  }
+}
+
+REGISTER_UNIT_TEST( MojoSetTestMany, Container )
+{
+  MojoSet< MojoHash< uint32_t > > set( __FUNCTION__ );
+  MojoMap< MojoHash< uint32_t >, MojoHash< uint32_t > > map( __FUNCTION__, 0 );
+  MojoMultiMap< MojoHash< uint32_t >, MojoHash< uint32_t > > multi_map( __FUNCTION__, 0 );
+  
+  const int key_count = 1000;
+  MojoHash< uint32_t > keys[ key_count ];
+  for( int i = 0; i < key_count; ++i )
+  {
+    keys[ i ] = Random();
+    if( i % 3 )
+    {
+      set.Insert( keys[ i ] );
+      map.Insert( keys[ i ], i + 1 );
+      multi_map.Insert( keys[ i ], i + 1 );
+    }
+  }
+  keys[ 10 ] = MojoHash< uint32_t >();
+  
+  // Use a count that is not a multiple of the batch size
+  bool set_found[ key_count ];
+  bool map_found[ key_count ];
+  bool multi_map_found[ key_count ];
+  MojoHash< uint32_t > values[ key_count ];
+  const int count = key_count - 3;
+  set.ContainsMany( keys, count, set_found );
+  map.ContainsMany( keys, count, map_found );
+  map.FindMany( keys, count, values );
+  ( ( const MojoAbstractSet< MojoHash< uint32_t > >& )multi_map ).ContainsMany( keys, count, multi_map_found );
+  
+  for( int i = 0; i < count; ++i )
+  {
+    EXPECT_TRUE( set_found[ i ] == set.Contains( keys[ i ] ) );
+    EXPECT_TRUE( map_found[ i ] == set_found[ i ] );
+    EXPECT_TRUE( multi_map_found[ i ] == set_found[ i ] );
+    EXPECT_INT( map.Find( keys[ i ] ), values[ i ] );
+  }
+  EXPECT_FALSE( set_found[ 10 ] );
+  
+  set.Destroy();
+  map.Destroy();
+  multi_map.Destroy();
+  EXPECT_INT( 0, GetActiveAlloc() );
 }
 
 // -------------------------------------------------------------------------------------------------------------------
@@ -525,7 +1541,7 @@ REGISTER_UNIT_TEST( MojoSetTestString, Container )
   EXPECT_FALSE( set.Contains( "Kiwi" ) );
   
   set.Destroy();
-  EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+  EXPECT_INT( 0, GetActiveAlloc() );
 }
 
 // -------------------------------------------------------------------------------------------------------------------
@@ -574,6 +1590,7 @@ REGISTER_UNIT_TEST( MojoRelationTest, Container )
     char group[ 20 ];
     snprintf( group, sizeof group, "%c", c );
     MojoId parent = group;
+    ( void )parent;
     for( int i = 0; i < 100; i += 2 )
     {
       MojoId child = MakeId( group, i );
@@ -587,6 +1604,7 @@ REGISTER_UNIT_TEST( MojoRelationTest, Container )
     char group[ 20 ];
     snprintf( group, sizeof group, "%c", c );
     MojoId parent = group;
+    ( void )parent;
     for( int i = 1; i < 100; i += 2 )
     {
       MojoId child = MakeId( group, i );
@@ -617,6 +1635,7 @@ REGISTER_UNIT_TEST( MojoRelationTest, Container )
     char group[ 20 ];
     snprintf( group, sizeof group, "%c", c );
     MojoId parent = group;
+    ( void )parent;
     for( int i = 0; i < 100; i += 2 )
     {
       MojoId child = MakeId( group, i );
@@ -631,6 +1650,7 @@ REGISTER_UNIT_TEST( MojoRelationTest, Container )
     char group[ 20 ];
     snprintf( group, sizeof group, "%c", c );
     MojoId parent = group;
+    ( void )parent;
     for( int i = 0; i < 100; i += 1 )
     {
       MojoId child = MakeId( group, i );
@@ -671,7 +1691,7 @@ REGISTER_UNIT_TEST( MojoSetTestStatus, Config )
     EXPECT_INT( kMojoStatus_InvalidArguments, status );
     
     set.Destroy();
-    EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+    EXPECT_INT( 0, GetActiveAlloc() );
   }
 
   // Test overfilling the set
@@ -715,7 +1735,7 @@ REGISTER_UNIT_TEST( MojoSetTestStatus, Config )
     }
     
     set.Destroy();
-    EXPECT_INT( 0, MyCountingAlloc.m_ActiveAlloc );
+    EXPECT_INT( 0, GetActiveAlloc() );
   }
 }
 
@@ -734,7 +1754,7 @@ REGISTER_UNIT_TEST( MojoIdTest, Id )
     EXPECT_STRING( "s1", s3.AsCString() );
     EXPECT_INT( 2, g_MojoIdManager.GetCount() );
   }
-  EXPECT_INT( 0, g_MojoIdManager.GetCount() );
+  EXPECT_INT( 0, GetIdCount() );
   
   // Test direct reference counting
   uint64_t hash1 = 0;
@@ -747,10 +1767,628 @@ REGISTER_UNIT_TEST( MojoIdTest, Id )
   }
   EXPECT_INT( 1, g_MojoIdManager.GetCount() );
   MojoId::DecRefCount( hash1 );
-  EXPECT_INT( 0, g_MojoIdManager.GetCount() );
+  EXPECT_INT( 0, GetIdCount() );
   EXPECT_STRING( NULL, MojoId::FindCString( hash1 ) );
 }
 
+REGISTER_UNIT_TEST( MojoWideHashTest, Id )
+{
+  static_assert( MojoConstWideHash64( "" ) == 0, "Empty string hash" );
+  EXPECT_TRUE( MojoWideHash64( "" ) == 0 );
+  EXPECT_TRUE( MojoWideHash64( NULL ) == 0 );
+  
+  // Run time and compile time versions agree at every length, and lengths that are a multiple of 8 are not special
+  MojoSet< MojoHash< uint64_t > > hashes( __FUNCTION__ );
+  char buffer[ 64 ];
+  for( int length = 1; length < ( int )sizeof( buffer ); ++length )
+  {
+    for( int i = 0; i < length; ++i )
+    {
+      buffer[ i ] = ( char )( 'a' + ( i * 7 + length ) % 26 );
+    }
+    buffer[ length ] = 0;
+    uint64_t hash = MojoWideHash64( buffer );
+    EXPECT_TRUE( hash == MojoConstWideHash64( buffer ) );
+    EXPECT_TRUE( hash == MojoWideHash64( buffer, length ) );
+    hashes.Insert( hash );
+  }
+  
+  // Strings that differ in one character or only in length
+  for( int i = 0; i < 2000; ++i )
+  {
+    snprintf( buffer, sizeof( buffer ), "assets/textures/environment/rock_%d.tga", i );
+    hashes.Insert( MojoWideHash64( buffer ) );
+  }
+  memset( buffer, 0, sizeof( buffer ) );
+  for( int length = 1; length < ( int )sizeof( buffer ); ++length )
+  {
+    hashes.Insert( MojoWideHash64( buffer, length ) );
+  }
+  EXPECT_INT( 63 + 2000 + 63, hashes.GetCount() );
+  
+  // Four at a time gives the same hashes as one at a time, whatever the lengths
+  const char* texts[ 4 ] = { "assets/textures/environment/rock.tga", "rock", "", NULL };
+  int lengths[ 4 ] = { 36, 4, 0, 0 };
+  uint64_t hashes4[ 4 ];
+  MojoStringHash64x4( texts, lengths, hashes4 );
+  for( int k = 0; k < 4; ++k )
+  {
+    EXPECT_TRUE( hashes4[ k ] == MojoStringHash64( texts[ k ], lengths[ k ] ) );
+  }
+  texts[ 2 ] = texts[ 3 ] = texts[ 0 ];
+  lengths[ 2 ] = 17;
+  lengths[ 3 ] = 33;
+  MojoStringHash64x4( texts, lengths, hashes4 );
+  for( int k = 0; k < 4; ++k )
+  {
+    EXPECT_TRUE( hashes4[ k ] == MojoStringHash64( texts[ k ], lengths[ k ] ) );
+  }
+  
+  hashes.Destroy();
+  EXPECT_INT( 0, GetActiveAlloc() );
+}
+
+REGISTER_UNIT_TEST( MojoIdTestStatic, Id )
+{
+  // Hash codes of literals are known at compile time, and match the run time ones
+  constexpr MojoStaticId transform = "Transform"_id;
+  static_assert( transform.AsUint64() == MojoConstStringHash64( "Transform" ), "MojoStaticId hash" );
+  static_assert( MojoConstFnv64( "" ) == 0, "Empty string hash" );
+  EXPECT_TRUE( MojoStringHash64( "Transform" ) == transform.AsUint64() );
+  EXPECT_TRUE( MojoFnv64( "\xe9t\xe9" ) == MojoConstFnv64( "\xe9t\xe9" ) );
+  
+  // Comparing does not register anything
+  MojoId id = "Transform";
+  EXPECT_TRUE( id == "Transform"_id );
+  EXPECT_TRUE( id != "Rotate"_id );
+  EXPECT_FALSE( id == "Rotate"_id );
+  EXPECT_INT( 1, g_MojoIdManager.GetCount() );
+  
+  MojoMap< MojoId, int > map( __FUNCTION__, 0 );
+  map.Insert( id, 5 );
+  EXPECT_INT( 5, map.Find( "Transform"_id ) );
+  EXPECT_INT( 0, map.Find( "Rotate"_id ) );
+  
+  MojoId rotate = "Rotate"_id;
+  EXPECT_STRING( "Rotate", rotate.AsCString() );
+  EXPECT_TRUE( rotate == "Rotate" );
+  EXPECT_INT( 2, g_MojoIdManager.GetCount() );
+  
+  map.Destroy();
+  id.SetNull();
+  rotate.SetNull();
+  EXPECT_INT( 0, GetIdCount() );
+}
+
+REGISTER_UNIT_TEST( MojoIdTestCollision, Id )
+{
+  MojoId beta = "beta";
+  int collision_count = g_MojoIdManager.GetCollisionCount();
+  
+  // A different string with the hash code of "beta" is refused, not aliased
+  MojoId alpha = MojoStaticId( "alpha", beta.AsUint64() );
+  EXPECT_TRUE( alpha.IsNull() );
+  EXPECT_INT( collision_count + 1, g_MojoIdManager.GetCollisionCount() );
+  EXPECT_STRING( "beta", beta.AsCString() );
+  EXPECT_INT( 1, g_MojoIdManager.GetCount() );
+  
+  // The same string is fine
+  MojoId beta2;
+  EXPECT_INT( kMojoStatus_Ok, beta2.Set( "beta" ) );
+  EXPECT_TRUE( beta2 == beta );
+  EXPECT_INT( collision_count + 1, g_MojoIdManager.GetCollisionCount() );
+  
+  beta.SetNull();
+  beta2.SetNull();
+  EXPECT_INT( 0, GetIdCount() );
+}
+
+REGISTER_UNIT_TEST( MojoIdTestSnapshot, Id )
+{
+  const char* path = "MojoIdTestSnapshot.bin";
+  const int id_count = 1000;
+  MojoId* ids = new MojoId[ id_count ];
+  char buffer[ 32 ];
+  for( int i = 0; i < id_count; ++i )
+  {
+    snprintf( buffer, sizeof( buffer ), "Snapshot %d", i );
+    ids[ i ] = buffer;
+  }
+  EXPECT_INT( kMojoStatus_Ok, g_MojoIdManager.SaveSnapshot( path ) );
+  EXPECT_INT( kMojoStatus_InvalidArguments, g_MojoIdManager.LoadSnapshot( path ) );
+  delete[] ids;
+  EXPECT_INT( 0, GetIdCount() );
+  
+  // Strings in the snapshot are served from the file, and take no memory
+  int start_alloc = MyCountingAlloc.m_ActiveAlloc;
+  EXPECT_INT( kMojoStatus_Ok, g_MojoIdManager.LoadSnapshot( path ) );
+  EXPECT_INT( id_count, g_MojoIdManager.GetCount() );
+  {
+    MojoId id = "Snapshot 17";
+    MojoId copy = id;
+    EXPECT_STRING( "Snapshot 17", copy.AsCString() );
+    EXPECT_STRING( "Snapshot 999", MojoId::FindCString( MojoStringHash64( "Snapshot 999" ) ) );
+    EXPECT_INT( start_alloc, MyCountingAlloc.m_ActiveAlloc );
+    
+    // New strings go into the regular tables
+    MojoId fresh = "Not in snapshot";
+    EXPECT_STRING( "Not in snapshot", fresh.AsCString() );
+    EXPECT_INT( id_count + 1, g_MojoIdManager.GetCount() );
+    
+    // Saving again includes both
+    EXPECT_INT( kMojoStatus_Ok, g_MojoIdManager.SaveSnapshot( path ) );
+  }
+  EXPECT_INT( id_count, GetIdCount() );
+  EXPECT_INT( start_alloc, GetActiveAlloc() );
+  
+  // Snapshot strings get dense indices too
+  MojoIndexId snapshot_index( MojoId( "Snapshot 3" ) );
+  EXPECT_FALSE( snapshot_index.IsNull() );
+  EXPECT_STRING( "Snapshot 3", snapshot_index.AsId().AsCString() );
+  EXPECT_TRUE( MojoIndexId( MojoId( "Snapshot 3" ) ) == snapshot_index );
+  
+  g_MojoIdManager.Destroy();
+  g_MojoIdManager.Create();
+  EXPECT_INT( kMojoStatus_Ok, g_MojoIdManager.LoadSnapshot( path ) );
+  EXPECT_INT( id_count + 1, g_MojoIdManager.GetCount() );
+  EXPECT_STRING( "Not in snapshot", MojoId::FindCString( MojoStringHash64( "Not in snapshot" ) ) );
+  
+  // A file that is not a snapshot
+  g_MojoIdManager.Destroy();
+  g_MojoIdManager.Create();
+  FILE* file = fopen( path, "wb" );
+  fputs( "Not a snapshot", file );
+  fclose( file );
+  EXPECT_INT( kMojoStatus_InvalidFile, g_MojoIdManager.LoadSnapshot( path ) );
+  EXPECT_INT( kMojoStatus_InvalidFile, g_MojoIdManager.LoadSnapshot( "MojoIdTestSnapshot.missing" ) );
+  
+  // A damaged file without an empty slot would make lookups of missing strings probe forever
+  MojoId only = "Only";
+  EXPECT_INT( kMojoStatus_Ok, g_MojoIdManager.SaveSnapshot( path ) );
+  only.SetNull();
+  EXPECT_INT( 0, GetIdCount() );
+  char data[ 4096 ];
+  file = fopen( path, "rb" );
+  size_t size = fread( data, 1, sizeof( data ), file );
+  fclose( file );
+  // A 32 byte header with the slot count at 20, then 16 byte slots that start with the hash code
+  uint32_t slot_count;
+  memcpy( &slot_count, data + 20, sizeof( slot_count ) );
+  EXPECT_TRUE( 32 + slot_count * 16 < size );
+  char* used_slot = NULL;
+  for( uint32_t i = 0; i < slot_count; ++i )
+  {
+    used_slot = *( uint64_t* )( data + 32 + i * 16 ) ? data + 32 + i * 16 : used_slot;
+  }
+  for( uint32_t i = 0; used_slot && i < slot_count; ++i )
+  {
+    char* slot = data + 32 + i * 16;
+    if( !*( uint64_t* )slot )
+    {
+      memcpy( slot, used_slot, 16 );
+      *( uint64_t* )slot = i + 1;
+    }
+  }
+  file = fopen( path, "wb" );
+  fwrite( data, 1, size, file );
+  fclose( file );
+  EXPECT_INT( kMojoStatus_InvalidFile, g_MojoIdManager.LoadSnapshot( path ) );
+  EXPECT_INT( 0, GetIdCount() );
+  remove( path );
+}
+
+REGISTER_UNIT_TEST( MojoIdTestSweep, Id )
+{
+  EXPECT_BOOL( !MOJO_ID_REFCOUNT, std::is_trivially_copyable< MojoId >::value );
+  g_MojoIdManager.Sweep( g_MojoIdManager.AdvanceEpoch() );
+  
+  MojoId old_id = "old";
+  MojoId marked_id = "marked";
+  uint32_t epoch = g_MojoIdManager.AdvanceEpoch();
+  MojoId new_id = "new";
+  marked_id.Mark();
+#if MOJO_ID_REFCOUNT
+  // Strings that are referenced are never swept
+  EXPECT_INT( 0, g_MojoIdManager.Sweep( epoch ) );
+  EXPECT_STRING( "old", old_id.AsCString() );
+#else
+  EXPECT_INT( 1, g_MojoIdManager.Sweep( epoch ) );
+  EXPECT_STRING( NULL, old_id.AsCString() );
+#endif
+  EXPECT_STRING( "marked", marked_id.AsCString() );
+  EXPECT_STRING( "new", new_id.AsCString() );
+  
+  old_id.SetNull();
+  marked_id.SetNull();
+  new_id.SetNull();
+  g_MojoIdManager.Sweep( g_MojoIdManager.AdvanceEpoch() );
+  EXPECT_INT( 0, GetIdCount() );
+}
+
+REGISTER_UNIT_TEST( MojoIdTestStrings, Id )
+{
+  int start_alloc = MyCountingAlloc.m_ActiveAlloc;
+  
+  // Strings are packed into blocks, not allocated one by one
+  const int id_count = 2000;
+  MojoId* ids = new MojoId[ id_count ];
+  char buffer[ 32 ];
+  for( int i = 0; i < id_count; ++i )
+  {
+    snprintf( buffer, sizeof( buffer ), "String %d", i );
+    ids[ i ] = buffer;
+  }
+  EXPECT_INT( id_count, g_MojoIdManager.GetCount() );
+  EXPECT_TRUE( MyCountingAlloc.m_ActiveAlloc - start_alloc < id_count / 10 );
+  
+  // A string that is bigger than a block
+  char* long_string = new char[ kMojoIdStringBlockSize * 2 ];
+  memset( long_string, 'x', kMojoIdStringBlockSize * 2 - 1 );
+  long_string[ kMojoIdStringBlockSize * 2 - 1 ] = 0;
+  MojoId long_id = long_string;
+  EXPECT_STRING( long_string, long_id.AsCString() );
+  
+  // Free and recreate half of them
+  for( int i = 0; i < id_count; i += 2 )
+  {
+    ids[ i ].SetNull();
+  }
+#if !MOJO_ID_REFCOUNT
+  // Without reference counts, dropped strings go when they are swept
+  uint32_t epoch = g_MojoIdManager.AdvanceEpoch();
+  for( int i = 1; i < id_count; i += 2 )
+  {
+    ids[ i ].Mark();
+  }
+  long_id.Mark();
+  EXPECT_INT( id_count / 2, g_MojoIdManager.Sweep( epoch ) );
+#endif
+  EXPECT_INT( id_count / 2 + 1, g_MojoIdManager.GetCount() );
+  for( int i = 0; i < id_count; i += 2 )
+  {
+    snprintf( buffer, sizeof( buffer ), "String %d", i );
+    ids[ i ] = buffer;
+  }
+  for( int i = 0; i < id_count; ++i )
+  {
+    snprintf( buffer, sizeof( buffer ), "String %d", i );
+    EXPECT_STRING( buffer, ids[ i ].AsCString() );
+  }
+  
+  delete[] ids;
+  long_id.SetNull();
+  delete[] long_string;
+  EXPECT_INT( 0, GetIdCount() );
+  EXPECT_INT( start_alloc, MyCountingAlloc.m_ActiveAlloc );
+}
+
+REGISTER_UNIT_TEST( MojoIdTestIntern, Id )
+{
+  // Tokens point into a larger buffer, and are not zero terminated
+  const char* text = "alpha beta gamma beta";
+  MojoId alpha( text, 5 );
+  MojoId beta( text + 6, 4 );
+  EXPECT_STRING( "alpha", alpha.AsCString() );
+  EXPECT_TRUE( beta == "beta" );
+  EXPECT_TRUE( MojoId( text + 17, 4 ) == beta );
+  EXPECT_TRUE( MojoId( text, 0 ).IsNull() );
+  EXPECT_INT( kMojoStatus_Ok, alpha.Set( text + 11, 5 ) );
+  EXPECT_STRING( "gamma", alpha.AsCString() );
+  // Without reference counts, "alpha" stays until it is swept
+  const int kept_count = MOJO_ID_REFCOUNT ? 0 : 1;
+  EXPECT_INT( 2 + kept_count, g_MojoIdManager.GetCount() );
+  
+  // A prefix of an interned string is a different string
+  MojoId bet( text + 6, 3 );
+  EXPECT_STRING( "bet", bet.AsCString() );
+  EXPECT_INT( 3 + kept_count, g_MojoIdManager.GetCount() );
+  
+  // Bulk form. Enough strings to grow every shard table, with duplicates and an empty one.
+  const int id_count = 16384 + 10;
+  char* buffer = new char[ id_count * 16 ];
+  MojoStringView* strings = new MojoStringView[ id_count ];
+  MojoId* ids = new MojoId[ id_count ];
+  for( int i = 0; i < id_count; ++i )
+  {
+    strings[ i ].m_Chars = buffer + i * 16;
+    strings[ i ].m_Length = snprintf( buffer + i * 16, 16, "Token %d", i % ( id_count - 10 ) );
+  }
+  strings[ 3 ].m_Length = 0;
+  ids[ 3 ] = "replaced";
+  EXPECT_INT( kMojoStatus_Ok, MojoId::InternMany( strings, id_count, ids ) );
+  EXPECT_TRUE( ids[ 3 ].IsNull() );
+  EXPECT_STRING( "Token 4", ids[ 4 ].AsCString() );
+  EXPECT_TRUE( ids[ id_count - 1 ] == ids[ 9 ] );
+  EXPECT_INT( id_count - 10 + 3 + kept_count * 2, g_MojoIdManager.GetCount() );
+  bool all_match = true;
+  for( int i = 0; i < id_count; ++i )
+  {
+    all_match &= i == 3 || MojoId( strings[ i ].m_Chars, strings[ i ].m_Length ) == ids[ i ];
+  }
+  EXPECT_TRUE( all_match );
+  
+  delete[] ids;
+  delete[] strings;
+  delete[] buffer;
+  alpha.SetNull();
+  beta.SetNull();
+  bet.SetNull();
+  EXPECT_INT( 0, GetIdCount() );
+}
+
+REGISTER_UNIT_TEST( MojoIdTestIndex, Id )
+{
+  MojoId early = "char/zed";
+  MojoArray< MojoId > listing( __FUNCTION__ );
+  MojoIdPrefixSet characters( "char/" );
+  MojoArrayCollector< MojoId > collector( &listing );
+  EXPECT_INT( kMojoStatus_NotInitialized, g_MojoIdManager.EnumeratePrefix( "char/", collector ) );
+  EXPECT_INT( kMojoStatus_Ok, g_MojoIdManager.CreateIndex() );
+  EXPECT_INT( kMojoStatus_DoubleInitialized, g_MojoIdManager.CreateIndex() );
+  
+  // Strings that come and go after the index was created are merged in by the next query
+  MojoId bob = "char/bob";
+  MojoId prop = "prop/lamp";
+  MojoId alice = "char/alice";
+  MojoId chart = "chart";
+  {
+    MojoId dropped = "char/dropped";
+    EXPECT_INT( 4, g_MojoIdManager.CountPrefix( "char/" ) );
+    ( void )dropped;
+    SweepIdsExcept( { early, bob, prop, alice, chart } );
+  }
+  EXPECT_INT( 3, characters._GetEnumerationCost() );
+  EXPECT_INT( 5, g_MojoIdManager.CountPrefix( "" ) );
+  characters.Enumerate( MojoArrayCollector< MojoId >( &listing ) );
+  EXPECT_INT( 3, listing.GetCount() );
+  EXPECT_STRING( "char/alice", listing[ 0 ].AsCString() );
+  EXPECT_STRING( "char/bob", listing[ 1 ].AsCString() );
+  EXPECT_STRING( "char/zed", listing[ 2 ].AsCString() );
+  EXPECT_TRUE( characters.Contains( bob ) );
+  EXPECT_FALSE( characters.Contains( chart ) );
+  
+  // Removed and added again, with a different string at the same place in memory
+  int change_count = characters._GetChangeCount();
+  bob.SetNull();
+  SweepIdsExcept( { early, prop, alice, chart } );
+  bob = "char/bobby";
+  EXPECT_TRUE( change_count != characters._GetChangeCount() );
+  
+  // Part of a set expression
+  MojoSet< MojoId > favorites( __FUNCTION__ );
+  favorites.Insert( "char/bobby" );
+  favorites.Insert( "prop/lamp" );
+  MojoIntersection< MojoId > favorite_characters( &characters, &favorites );
+  listing.Reset();
+  favorite_characters.Enumerate( MojoArrayCollector< MojoId >( &listing ) );
+  EXPECT_INT( 1, listing.GetCount() );
+  EXPECT_STRING( "char/bobby", listing[ 0 ].AsCString() );
+  
+  favorites.Destroy();
+  listing.Destroy();
+  g_MojoIdManager.DestroyIndex();
+  EXPECT_INT( 0, g_MojoIdManager.CountPrefix( "" ) );
+  early.SetNull();
+  bob.SetNull();
+  prop.SetNull();
+  alice.SetNull();
+  chart.SetNull();
+  EXPECT_INT( 0, GetIdCount() );
+}
+
+REGISTER_UNIT_TEST( MojoIdTestIndexId, Id )
+{
+  int start_alloc = MyCountingAlloc.m_ActiveAlloc;
+  EXPECT_TRUE( MojoIndexId( MojoId() ).IsNull() );
+  EXPECT_TRUE( MojoIndexId().AsId().IsNull() );
+  
+  // Indices are handed out in order, the first time they are asked for
+  MojoId unused = "unused";
+  const int id_count = 3000;
+  MojoId* ids = new MojoId[ id_count ];
+  char buffer[ 32 ];
+  for( int i = 0; i < id_count; ++i )
+  {
+    snprintf( buffer, sizeof( buffer ), "Dense %d", i );
+    ids[ i ] = buffer;
+    EXPECT_INT( i + 1, ( int )MojoIndexId( ids[ i ] ).AsUint32() );
+  }
+  EXPECT_INT( id_count + 1, ( int )g_MojoIdManager.GetIndexIdLimit() );
+  EXPECT_TRUE( MojoIndexId( ids[ 5 ] ) == MojoIndexId( MojoId( "Dense 5" ) ) );
+  EXPECT_TRUE( MojoIndexId( ids[ 5 ] ) != MojoIndexId( ids[ 6 ] ) );
+  EXPECT_STRING( "Dense 2999", MojoIndexId( ids[ 2999 ] ).AsId().AsCString() );
+  
+  // A flat array of per-id data
+  int* data = new int[ g_MojoIdManager.GetIndexIdLimit() ];
+  for( int i = 0; i < id_count; ++i )
+  {
+    data[ MojoIndexId( ids[ i ] ).AsUint32() ] = i * 10;
+  }
+  EXPECT_INT( 170, data[ MojoIndexId( MojoId( "Dense 17" ) ).AsUint32() ] );
+  delete[] data;
+  
+  // Indices of removed strings are reused
+  uint32_t index_10 = MojoIndexId( ids[ 10 ] ).AsUint32();
+  ids[ 10 ].SetNull();
+#if !MOJO_ID_REFCOUNT
+  // Without reference counts, the string goes when it is swept
+  uint32_t epoch = g_MojoIdManager.AdvanceEpoch();
+  for( int i = 0; i < id_count; ++i )
+  {
+    ids[ i ].Mark();
+  }
+  unused.Mark();
+  EXPECT_INT( 1, g_MojoIdManager.Sweep( epoch ) );
+#endif
+  MojoId other = "Other";
+  EXPECT_INT( ( int )index_10, ( int )MojoIndexId( other ).AsUint32() );
+  EXPECT_TRUE( MojoIndexId( other ).AsId() == other );
+  EXPECT_INT( id_count + 1, ( int )g_MojoIdManager.GetIndexIdLimit() );
+  
+  // Everything is released with the last string that has an index
+  delete[] ids;
+  other.SetNull();
+  SweepIdsExcept( { unused } );
+  EXPECT_INT( 1, ( int )g_MojoIdManager.GetIndexIdLimit() );
+  unused.SetNull();
+  EXPECT_INT( 0, GetIdCount() );
+  EXPECT_INT( start_alloc, MyCountingAlloc.m_ActiveAlloc );
+}
+
+REGISTER_UNIT_TEST( MojoIdTestStats, Id )
+{
+  g_MojoIdManager.ResetCounters();
+  MojoIdStats stats;
+  g_MojoIdManager.GetStats( &stats );
+  EXPECT_INT( 0, stats.m_LiveCount );
+  EXPECT_INT( 0, ( int )stats.m_StringBytes );
+  EXPECT_INT( 0, ( int )stats.m_NewCount );
+  
+  MojoId kept = "kept";
+  MojoId copy = kept;
+  g_MojoIdManager.SetHotSampleRate( 1 );
+  
+  // A temporary id made from a C-string in a loop is added and removed every time
+  for( int i = 0; i < 50; ++i )
+  {
+    EXPECT_TRUE( MojoId( "temporary" ) != kept );
+    if( i % 5 == 0 )
+    {
+      EXPECT_TRUE( MojoId( "occasional" ) != kept );
+    }
+  }
+  g_MojoIdManager.GetStats( &stats );
+#if MOJO_ID_REFCOUNT
+  EXPECT_INT( 1, stats.m_LiveCount );
+  EXPECT_INT( 5, ( int )stats.m_StringBytes );
+  EXPECT_INT( 61, ( int )stats.m_NewCount );
+  EXPECT_INT( 60, ( int )stats.m_FreeCount );
+#else
+  // Without reference counts, temporary ids are added once and stay until they are swept
+  EXPECT_INT( 3, stats.m_LiveCount );
+  EXPECT_INT( 5 + 10 + 11, ( int )stats.m_StringBytes );
+  EXPECT_INT( 3, ( int )stats.m_NewCount );
+  EXPECT_INT( 0, ( int )stats.m_FreeCount );
+#endif
+  EXPECT_TRUE( stats.m_BlockBytes >= stats.m_StringBytes );
+  EXPECT_INT( 61, ( int )stats.m_InsertCount );
+  EXPECT_TRUE( stats.m_TableLoad > 0.0f && stats.m_TableLoad < 1.0f );
+#if MOJO_ID_STATS
+  EXPECT_INT( 1, ( int )stats.m_IncRefCount );
+#endif
+  
+  // The report samples strings as they are removed, so it only sees churn when ids are counted
+  MojoIdHotEntry hot[ 4 ];
+#if MOJO_ID_REFCOUNT
+  EXPECT_INT( 2, g_MojoIdManager.GetHotIds( hot, 4 ) );
+  EXPECT_STRING( "temporary", hot[ 0 ].m_CString );
+  EXPECT_INT( 50, hot[ 0 ].m_Count );
+  EXPECT_STRING( "occasional", hot[ 1 ].m_CString );
+  EXPECT_TRUE( hot[ 0 ].m_Hash == MojoStringHash64( "temporary" ) );
+#else
+  EXPECT_INT( 0, g_MojoIdManager.GetHotIds( hot, 4 ) );
+#endif
+  
+  g_MojoIdManager.SetHotSampleRate( 0 );
+  g_MojoIdManager.ResetCounters();
+  EXPECT_INT( 0, g_MojoIdManager.GetHotIds( hot, 4 ) );
+  kept.SetNull();
+  copy.SetNull();
+  EXPECT_INT( 0, GetIdCount() );
+}
+
+REGISTER_UNIT_TEST( MojoIdTestReclaim, Id )
+{
+  // Deferred reclamation is for strings whose reference count drops to zero. Without counts, Sweep() does the work.
+#if MOJO_ID_REFCOUNT
+  int start_alloc = MyCountingAlloc.m_ActiveAlloc;
+  g_MojoIdManager.ResetCounters();
+  g_MojoIdManager.SetReclaimBatch( 4 );
+  
+  // A temporary id is retired when dropped, and revived when made again
+  for( int i = 0; i < 100; ++i )
+  {
+    MojoId temporary = "temporary";
+    EXPECT_STRING( "temporary", temporary.AsCString() );
+  }
+  MojoIdStats stats;
+  g_MojoIdManager.GetStats( &stats );
+  EXPECT_INT( 1, ( int )stats.m_NewCount );
+  EXPECT_INT( 99, ( int )stats.m_ReviveCount );
+  EXPECT_INT( 0, ( int )stats.m_FreeCount );
+  EXPECT_INT( 1, stats.m_RetiredCount );
+  EXPECT_INT( 1, g_MojoIdManager.GetCount() );
+  
+  // Strings are removed in batches, and only after a batch of grace
+  char buffer[ 32 ];
+  const int id_count = 1000;
+  for( int i = 0; i < id_count; ++i )
+  {
+    snprintf( buffer, sizeof( buffer ), "Retired %d", i );
+    MojoId id = buffer;
+  }
+  g_MojoIdManager.GetStats( &stats );
+  EXPECT_TRUE( stats.m_FreeCount > 0 );
+  EXPECT_TRUE( stats.m_LiveCount > 1 );
+  EXPECT_INT( stats.m_LiveCount, stats.m_RetiredCount );
+  
+  // Reclaim() removes the rest, but keeps strings that were revived
+  MojoId revived = "Retired 999";
+  EXPECT_INT( stats.m_LiveCount - 1, g_MojoIdManager.Reclaim() );
+  EXPECT_INT( 1, g_MojoIdManager.GetCount() );
+  EXPECT_STRING( "Retired 999", revived.AsCString() );
+  
+  g_MojoIdManager.SetReclaimBatch( 0 );
+  revived.SetNull();
+  EXPECT_INT( 0, GetIdCount() );
+  EXPECT_INT( start_alloc, MyCountingAlloc.m_ActiveAlloc );
+#endif
+}
+
+REGISTER_UNIT_TEST( MojoIdTestThreads, Id )
+{
+  // MyCountingAlloc is not thread safe, so give the manager an allocator that is
+  AtomicCountingAlloc alloc;
+  g_MojoIdManager.Destroy();
+  g_MojoIdManager.Create( NULL, &alloc );
+  
+  // All threads create, copy and drop ids from the same pool of strings
+  const int thread_count = 4;
+  const int string_count = 500;
+  std::atomic< int > error_count( 0 );
+  std::thread threads[ thread_count ];
+  for( int t = 0; t < thread_count; ++t )
+  {
+    threads[ t ] = std::thread( [ &error_count, t ]()
+    {
+      MojoId held[ 16 ];
+      char buffer[ 32 ];
+      for( int i = 0; i < 20000; ++i )
+      {
+        int number = ( i * 7 + t * 13 ) % string_count;
+        snprintf( buffer, sizeof( buffer ), "Id %d", number );
+        MojoId id = buffer;
+        MojoId copy = id;
+        held[ i % 16 ] = copy;
+        if( strcmp( MojoId::FindCString( copy.AsUint64() ), buffer ) != 0 || !( copy == buffer ) )
+        {
+          error_count += 1;
+        }
+      }
+    } );
+  }
+  for( int t = 0; t < thread_count; ++t )
+  {
+    threads[ t ].join();
+  }
+  EXPECT_INT( 0, error_count.load() );
+  EXPECT_INT( 0, GetIdCount() );
+  
+  g_MojoIdManager.Destroy();
+  EXPECT_INT( 0, alloc.m_ActiveAlloc );
+  g_MojoIdManager.Create();
+}
+
 // -------------------------------------------------------------------------------------------------------------------
 
 REGISTER_UNIT_TEST( MojoIdMapTest, Id )
@@ -795,7 +2433,7 @@ REGISTER_UNIT_TEST( MojoIdMapTest, Id )
   map.Destroy();
   
   // Verify that the map has correctly decremented the string ref count
-  EXPECT_INT( 0, g_MojoIdManager.GetCount() );
+  EXPECT_INT( 0, GetIdCount() );
 }
 
 // -------------------------------------------------------------------------------------------------------------------